@@ -0,0 +1,277 @@
+#pragma once
+
+// Batched execution of qubit operations.
+//
+// A Circuit records setState/gate/entangle/measure calls against one or more
+// Qubits and replays them in order under a single acquisition of each
+// qubit's lock, publishing each touched qubit's timestamp once at the end.
+// optimize() rewrites the recorded ops with a peephole pass before replay.
+
+#include "qubit.h"
+
+#include <algorithm>
+#include <functional>
+
+struct OptimizeReport {
+    size_t ops_before = 0;
+    size_t ops_after = 0;
+    size_t gates_before = 0;
+    size_t gates_after = 0;
+};
+
+class Circuit {
+public:
+    enum OpKind : uint8_t { SET_STATE, GATE, ENTANGLE, MEASURE };
+
+    struct Op {
+        OpKind   kind;
+        uint32_t qubit;      // index into qubits()
+        char     gate;
+        double   amps[4];
+        std::vector<std::string> peers;
+    };
+
+    Circuit& setState(Qubit& q, double ar, double ai, double br, double bi) {
+        Op op = makeOp(SET_STATE, q);
+        op.amps[0] = ar; op.amps[1] = ai; op.amps[2] = br; op.amps[3] = bi;
+        op_list.push_back(op);
+        return *this;
+    }
+
+    Circuit& gate(Qubit& q, char g) {
+        Op op = makeOp(GATE, q);
+        op.gate = g;
+        op_list.push_back(op);
+        return *this;
+    }
+
+    Circuit& entangle(Qubit& q, const std::vector<std::string>& peers) {
+        Op op = makeOp(ENTANGLE, q);
+        op.peers = peers;
+        op_list.push_back(op);
+        return *this;
+    }
+
+    Circuit& measure(Qubit& q) {
+        op_list.push_back(makeOp(MEASURE, q));
+        return *this;
+    }
+
+    // Run all ops in recorded order. Measurement results are written to
+    // `results` in the order the measure ops were recorded.
+    void execute(std::vector<uint8_t>& results) {
+        results.clear();
+        std::vector<Qubit*> order(qubit_refs);
+        std::sort(order.begin(), order.end(), std::less<Qubit*>());  // fixed lock order
+        for (Qubit* q : order) q->mtx.lock();
+
+        dirty.assign(qubit_refs.size(), 0);
+        for (const Op& op : op_list) {
+            Qubit& q = *qubit_refs[op.qubit];
+            switch (op.kind) {
+                case SET_STATE:
+                    q.setStateLocked(op.amps[0], op.amps[1], op.amps[2], op.amps[3]);
+                    dirty[op.qubit] = 1;
+                    break;
+                case GATE: {
+                    OpTimer timer(OP_APPLY_GATE);
+                    if (q.applyGateLocked(op.gate, timer)) dirty[op.qubit] = 1;
+                    break;
+                }
+                case ENTANGLE:
+                    q.entangleLocked(op.peers);
+                    break;
+                case MEASURE: {
+                    OpTimer timer(OP_MEASURE);
+                    uint8_t result;
+                    if (q.measureLocked(result, timer)) dirty[op.qubit] = 1;
+                    results.push_back(result);
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < qubit_refs.size(); ++i)
+            if (dirty[i]) qubit_refs[i]->updateTimestamp();
+
+        for (Qubit* q : order) q->mtx.unlock();
+    }
+
+    std::vector<uint8_t> execute() {
+        std::vector<uint8_t> results;
+        execute(results);
+        return results;
+    }
+
+    // Peephole-optimize the recorded ops until nothing changes:
+    //  - cancel adjacent H·H and X·X
+    //  - merge runs of Z-axis rotations (Z, S, T) into at most Z·S·T
+    //  - drop Z/S/T directly before a computational-basis measure
+    //  - drop gates and setStates overwritten by a later setState
+    //  - drop gates on a qubit this circuit already measured (they are no-ops)
+    // Every measure is a barrier for all qubits, since its propagation can
+    // collapse any linked qubit; entangle only touches links and is skipped.
+    OptimizeReport optimize() {
+        OptimizeReport report;
+        report.ops_before = op_list.size();
+        report.gates_before = gateCount();
+        std::vector<uint8_t> alive(op_list.size(), 1);
+        while (peepholePass(alive)) {}
+        size_t out = 0;
+        for (size_t i = 0; i < op_list.size(); ++i)
+            if (alive[i]) op_list[out++] = std::move(op_list[i]);
+        op_list.resize(out);
+        report.ops_after = op_list.size();
+        report.gates_after = gateCount();
+        return report;
+    }
+
+    size_t gateCount() const {
+        size_t n = 0;
+        for (const Op& op : op_list) n += op.kind == GATE;
+        return n;
+    }
+
+    const std::vector<Op>& ops() const { return op_list; }
+    const std::vector<Qubit*>& qubits() const { return qubit_refs; }
+    size_t size() const { return op_list.size(); }
+    void clear() { op_list.clear(); qubit_refs.clear(); }
+
+private:
+    std::vector<Qubit*>  qubit_refs;
+    std::vector<Op>      op_list;
+    std::vector<uint8_t> dirty;
+
+    // Quarter-turn count of a Z-axis rotation, or -1 for other gates
+    static int zPhase(char gate) {
+        switch (gate) {
+            case 'Z': return 4;
+            case 'S': return 2;
+            case 'T': return 1;
+            default:  return -1;
+        }
+    }
+
+    // One sweep over the live ops; returns true if any op was removed
+    bool peepholePass(std::vector<uint8_t>& alive) {
+        // Per qubit: live setState/gate ops since the last measure barrier
+        std::vector<std::vector<size_t>> window(qubit_refs.size());
+        std::vector<uint8_t> collapsed(qubit_refs.size(), 0);
+        bool changed = false;
+        for (size_t i = 0; i < op_list.size(); ++i) {
+            if (!alive[i]) continue;
+            Op& op = op_list[i];
+            std::vector<size_t>& w = window[op.qubit];
+            switch (op.kind) {
+                case ENTANGLE:
+                    break;
+                case SET_STATE:
+                    for (size_t j : w) { alive[j] = 0; changed = true; }
+                    w.assign(1, i);
+                    collapsed[op.qubit] = 0;
+                    break;
+                case MEASURE:
+                    while (!w.empty() && op_list[w.back()].kind == GATE &&
+                           zPhase(op_list[w.back()].gate) > 0) {
+                        alive[w.back()] = 0;
+                        w.pop_back();
+                        changed = true;
+                    }
+                    for (auto& other : window) other.clear();
+                    collapsed[op.qubit] = 1;
+                    break;
+                case GATE: {
+                    if (collapsed[op.qubit]) {
+                        alive[i] = 0;
+                        changed = true;
+                        break;
+                    }
+                    if (zPhase(op.gate) > 0) {
+                        changed |= mergeZRun(w, i, alive);
+                        break;
+                    }
+                    if ((op.gate == 'H' || op.gate == 'X') && !w.empty() &&
+                        op_list[w.back()].kind == GATE && op_list[w.back()].gate == op.gate) {
+                        alive[w.back()] = 0;
+                        alive[i] = 0;
+                        w.pop_back();
+                        changed = true;
+                        break;
+                    }
+                    w.push_back(i);
+                    break;
+                }
+            }
+        }
+        return changed;
+    }
+
+    // Fold gate `i` into the trailing Z-rotation run of window `w`, rewriting
+    // the run as the fewest of Z (4), S (2), T (1) with the same total phase
+    bool mergeZRun(std::vector<size_t>& w, size_t i, std::vector<uint8_t>& alive) {
+        size_t start = w.size();
+        while (start > 0 && op_list[w[start - 1]].kind == GATE && zPhase(op_list[w[start - 1]].gate) > 0)
+            --start;
+        std::vector<size_t> run(w.begin() + start, w.end());
+        run.push_back(i);
+        w.resize(start);
+        int phase = 0;
+        for (size_t j : run) phase += zPhase(op_list[j].gate);
+        phase &= 7;
+        size_t used = 0;
+        const char gates[3] = {'Z', 'S', 'T'};
+        const int bits[3] = {4, 2, 1};
+        for (int b = 0; b < 3; ++b) {
+            if (!(phase & bits[b])) continue;
+            op_list[run[used]].gate = gates[b];
+            w.push_back(run[used++]);
+        }
+        for (size_t j = used; j < run.size(); ++j) alive[run[j]] = 0;
+        return used < run.size();
+    }
+
+    Op makeOp(OpKind kind, Qubit& q) {
+        Op op;
+        op.kind = kind;
+        op.qubit = indexOf(q);
+        op.gate = 0;
+        op.amps[0] = op.amps[1] = op.amps[2] = op.amps[3] = 0.0;
+        return op;
+    }
+
+    uint32_t indexOf(Qubit& q) {
+        for (size_t i = 0; i < qubit_refs.size(); ++i)
+            if (qubit_refs[i] == &q) return uint32_t(i);
+        qubit_refs.push_back(&q);
+        return uint32_t(qubit_refs.size() - 1);
+    }
+};
+
+// Bell pair preparation: a = H|0>, b = |0>, linked to each other
+inline Circuit bellCircuit(Qubit& a, Qubit& b) {
+    Circuit c;
+    c.setState(a, 1.0, 0.0, 0.0, 0.0).gate(a, 'H')
+     .setState(b, 1.0, 0.0, 0.0, 0.0)
+     .entangle(a, {b.name()})
+     .entangle(b, {a.name()});
+    return c;
+}
+
+// Circuit equivalent of formGHZGroup() for 2-5 qubits
+inline Circuit ghzCircuit(const std::vector<Qubit*>& qubits) {
+    Circuit c;
+    size_t n = qubits.size();
+    if (n < 2 || n > 5) {
+        std::cerr << "GHZ group size must be between 2 and 5" << std::endl;
+        return c;
+    }
+    for (size_t i = 0; i < n; i++) {
+        std::vector<std::string> peers;
+        for (size_t j = 0; j < n; j++) {
+            if (i == j) continue;
+            peers.push_back(qubits[j]->name());
+        }
+        c.entangle(*qubits[i], peers);
+        c.setState(*qubits[i], 1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+    }
+    return c;
+}
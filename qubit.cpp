@@ -1,539 +1,2150 @@
-#include <iostream>
-#include <cstring>
-#include <cmath>
-#include <random>
-#include <chrono>
-#include <thread>
-#include <atomic>
-#include <vector>
-#include <mutex>
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
-#include <iomanip>
-
-struct QubitState {
-    double alpha_real;
-    double alpha_imag;
-    double beta_real;
-    double beta_imag;
-    uint8_t measured;
-    char links[4][64];       // names of up to 4 shared-memory peers
-    uint32_t link_count;
-    uint32_t task_id;
-    uint64_t created_at;
-    uint64_t decohere_timeout_ms;
-};
-
-class Qubit {
-public:
-    Qubit(const std::string &name, uint32_t taskId, uint64_t decohereTimeoutMs = 5000)
-        : shm_name(name), task_id(taskId), decohere_timeout(decohereTimeoutMs) {
-        openOrCreate();
-        initHeader();
-        startDecoherenceThread();
-    }
-
-    ~Qubit() {
-        decohere_thread_running = false;
-        if (decohere_thread.joinable()) decohere_thread.join();
-        munmap(ptr, sizeof(QubitState));
-        close(shm_fd);
-    }
-
-    // Initialize equal superposition state
-    void initSuperposition() {
-        std::lock_guard<std::mutex> lock(mtx);
-        state->alpha_real = 1.0 / M_SQRT2;
-        state->alpha_imag = 0.0;
-        state->beta_real  = 1.0 / M_SQRT2;
-        state->beta_imag  = 0.0;
-        state->measured   = 2;
-        resetLinks();
-        updateTimestamp();
-    }
-
-    // Measure qubit: collapse probabilistically
-    uint8_t measure() {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (state->measured != 2) return state->measured;
-        double p0 = norm(state->alpha_real, state->alpha_imag);
-        double p1 = norm(state->beta_real, state->beta_imag);
-        std::bernoulli_distribution dist(p1);
-        uint8_t result = dist(rng);
-        state->measured = result;
-        // collapse amplitudes
-        if (result == 0) {
-            state->alpha_real = 1.0; state->alpha_imag = 0.0;
-            state->beta_real  = 0.0; state->beta_imag  = 0.0;
-        } else {
-            state->alpha_real = 0.0; state->alpha_imag = 0.0;
-            state->beta_real  = 1.0; state->beta_imag  = 0.0;
-        }
-        propagateToLinks(result);
-        updateTimestamp();
-        return result;
-    }
-
-    // Apply basic gate: H, X, Z
-    void applyGate(char gate) {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (state->measured != 2) return;
-        double ar = state->alpha_real, ai = state->alpha_imag;
-        double br = state->beta_real,  bi = state->beta_imag;
-        switch (gate) {
-            case 'H': // Hadamard
-                state->alpha_real = (ar + br) / M_SQRT2;
-                state->alpha_imag = (ai + bi) / M_SQRT2;
-                state->beta_real  = (ar - br) / M_SQRT2;
-                state->beta_imag  = (ai - bi) / M_SQRT2;
-                break;
-            case 'X': // Pauli-X
-                state->alpha_real = br;
-                state->alpha_imag = bi;
-                state->beta_real  = ar;
-                state->beta_imag  = ai;
-                break;
-            case 'Z': // Pauli-Z
-                state->beta_real  = -br;
-                state->beta_imag  = -bi;
-                break;
-            default:
-                std::cerr << "Unknown gate: " << gate << std::endl;
-        }
-        updateTimestamp();
-    }
-
-    // Entangle with up to 4 other qubits by name
-    void entangle(const std::vector<std::string>& peers) {
-        std::lock_guard<std::mutex> lock(mtx);
-        size_t n = std::min(peers.size(), size_t(4));
-        for (size_t i = 0; i < n; ++i)
-            strncpy(state->links[i], peers[i].c_str(), 63);
-        state->link_count = n;
-    }
-
-    // Set custom state amplitudes
-    void setState(double ar, double ai, double br, double bi) {
-        std::lock_guard<std::mutex> lock(mtx);
-        state->alpha_real = ar;
-        state->alpha_imag = ai;
-        state->beta_real = br;
-        state->beta_imag = bi;
-        state->measured = 2;
-        updateTimestamp();
-    }
-
-    // Get shared memory name
-    const std::string& name() const { return shm_name; }
-
-    // Get current state information
-    void printState() const {
-        std::lock_guard<std::mutex> lock(mtx);
-        std::cout << "Qubit '" << shm_name << "': ";
-        if (state->measured == 2) {
-            std::cout << "|ψ> = ";
-            std::cout << std::fixed << std::setprecision(3);
-            std::cout << "(" << state->alpha_real << (state->alpha_imag >= 0 ? "+" : "") 
-                      << state->alpha_imag << "i)|0> + ";
-            std::cout << "(" << state->beta_real << (state->beta_imag >= 0 ? "+" : "") 
-                      << state->beta_imag << "i)|1>";
-        } else {
-            std::cout << "Collapsed to |" << (int)state->measured << ">";
-        }
-        std::cout << "\nLinks: " << state->link_count;
-        for (uint32_t i = 0; i < state->link_count; ++i) {
-            std::cout << " " << state->links[i];
-        }
-        std::cout << "\nDecoherence: " << state->decohere_timeout_ms << "ms" << std::endl;
-    }
-
-    // Check if measured
-    bool isMeasured() const { 
-        std::lock_guard<std::mutex> lock(mtx);
-        return state->measured != 2; 
-    }
-
-    // Get measured value (only valid if measured)
-    uint8_t getMeasurement() const {
-        std::lock_guard<std::mutex> lock(mtx);
-        return state->measured;
-    }
-
-private:
-    std::string shm_name;
-    uint32_t    task_id;
-    uint64_t    decohere_timeout;
-    int         shm_fd;
-    QubitState* state;
-
-    mutable std::mutex mtx;  // Made mutable for const methods
-    std::mt19937 rng{std::random_device{}()};
-    std::thread  decohere_thread;
-    std::atomic<bool> decohere_thread_running{false};
-
-    void openOrCreate() {
-        shm_fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT, 0666);
-        if (shm_fd < 0) { perror("shm_open"); exit(1); }
-        ftruncate(shm_fd, sizeof(QubitState));
-        ptr = mmap(nullptr, sizeof(QubitState), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-        if (ptr == MAP_FAILED) { perror("mmap"); exit(1); }
-        state = reinterpret_cast<QubitState*>(ptr);
-    }
-
-    void initHeader() {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (state->task_id != task_id) {
-            std::memset(state, 0, sizeof(QubitState));
-            state->task_id = task_id;
-            updateTimestamp();
-        }
-    }
-
-    void updateTimestamp() {
-        state->created_at = nowMs();
-        state->decohere_timeout_ms = decohere_timeout;
-    }
-
-    void resetLinks() {
-        state->link_count = 0;
-        for (int i = 0; i < 4; ++i) state->links[i][0] = '\0';
-    }
-
-    static double norm(double r, double i) { return r*r + i*i; }
-
-    uint64_t nowMs() const {
-        auto tp = std::chrono::steady_clock::now().time_since_epoch();
-        return std::chrono::duration_cast<std::chrono::milliseconds>(tp).count();
-    }
-
-    void propagateToLinks(uint8_t result) {
-        for (uint32_t i = 0; i < state->link_count; ++i) {
-            const char* peer = state->links[i];
-            int fd = shm_open(peer, O_RDWR, 0);
-            if (fd < 0) continue;
-            void* p = mmap(nullptr, sizeof(QubitState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-            if (p == MAP_FAILED) { close(fd); continue; }
-            auto peerState = reinterpret_cast<QubitState*>(p);
-            peerState->measured = result;
-            munmap(p, sizeof(QubitState));
-            close(fd);
-        }
-    }
-
-    void startDecoherenceThread() {
-        decohere_thread_running = true;
-        decohere_thread = std::thread([&]() {
-            while (decohere_thread_running) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                std::lock_guard<std::mutex> lock(mtx);
-                if (state->measured == 2 && nowMs() - state->created_at > state->decohere_timeout_ms) {
-                    // random collapse
-                    double p1 = norm(state->beta_real, state->beta_imag);
-                    std::bernoulli_distribution dist(p1);
-                    state->measured = dist(rng);
-                    propagateToLinks(state->measured);
-                }
-            }
-        });
-    }
-
-    void* ptr;
-};
-
-// Create GHZ state among multiple qubits (2-5 qubits)
-void formGHZGroup(std::vector<Qubit*>& qubits) {
-    size_t n = qubits.size();
-    if (n < 2 || n > 5) {
-        std::cerr << "GHZ group size must be between 2 and 5" << std::endl;
-        return;
-    }
-
-    for (size_t i = 0; i < n; i++) {
-        std::vector<std::string> peers;
-        for (size_t j = 0; j < n; j++) {
-            if (i == j) continue;
-            peers.push_back(qubits[j]->name());
-        }
-        qubits[i]->entangle(peers);
-        qubits[i]->setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
-    }
-}
-
-// ========================
-// TESTING IMPLEMENTATION
-// ========================
-
-void unlink_shm(const std::string& name) {
-    if (shm_unlink(name.c_str()) == -1) {
-        perror(("shm_unlink for " + name).c_str());
-    }
-}
-
-void test_single_qubit() {
-    std::cout << "\n===== TEST 1: SINGLE QUBIT OPERATIONS =====\n";
-    std::string name = "qubit_single";
-    {
-        Qubit q(name, 1);
-        q.printState();
-        
-        // Test initialization to |0>
-        std::cout << "\n[Initialized to |0>]" << std::endl;
-        q.setState(1.0, 0.0, 0.0, 0.0);
-        q.printState();
-        
-        // Test superposition
-        std::cout << "\n[Applied Hadamard gate]" << std::endl;
-        q.applyGate('H');
-        q.printState();
-        
-        // Test measurement statistics
-        int count0 = 0, count1 = 0;
-        const int trials = 10000;
-        for (int i = 0; i < trials; i++) {
-            Qubit temp_q(name, 1);
-            temp_q.initSuperposition();
-            if (temp_q.measure() == 0) count0++;
-            else count1++;
-        }
-        std::cout << "\nMeasurement statistics (" << trials << " trials):\n";
-        std::cout << "|0>: " << count0 << " (" << (100.0*count0/trials) << "%)\n";
-        std::cout << "|1>: " << count1 << " (" << (100.0*count1/trials) << "%)\n";
-        
-        // Test X and Z gates
-        std::cout << "\n[Testing gates]" << std::endl;
-        q.setState(1.0, 0.0, 0.0, 0.0); // |0>
-        q.applyGate('X'); // Should become |1>
-        std::cout << "After X gate: ";
-        q.printState();
-        
-        q.applyGate('Z'); // Should become -|1>
-        std::cout << "After Z gate: ";
-        q.printState();
-        
-        q.applyGate('H'); // Should become |->
-        std::cout << "After H gate: ";
-        q.printState();
-    }
-    unlink_shm(name);
-    std::cout << "TEST 1 COMPLETE\n";
-}
-
-void test_bell_state() {
-    std::cout << "\n\n===== TEST 2: BELL STATE (2-QUBIT ENTANGLEMENT) =====\n";
-    std::string name1 = "bell_qubit1";
-    std::string name2 = "bell_qubit2";
-    
-    {
-        Qubit q1(name1, 1);
-        Qubit q2(name2, 1);
-        
-        // Prepare Bell state
-        q1.setState(1.0, 0.0, 0.0, 0.0); // |0>
-        q1.applyGate('H'); // (|0> + |1>)/√2
-        q2.setState(1.0, 0.0, 0.0, 0.0); // |0>
-        
-        // Entangle
-        q1.entangle({name2});
-        q2.entangle({name1});
-        
-        std::cout << "Initial Bell state prepared:\n";
-        q1.printState();
-        q2.printState();
-        
-        // Test correlation
-        int same = 0, total = 1000;
-        for (int i = 0; i < total; i++) {
-            Qubit temp1(name1, 1);
-            Qubit temp2(name2, 1);
-            
-            // Re-prepare Bell state
-            temp1.setState(1.0, 0.0, 0.0, 0.0);
-            temp1.applyGate('H');
-            temp2.setState(1.0, 0.0, 0.0, 0.0);
-            temp1.entangle({name2});
-            temp2.entangle({name1});
-            
-            uint8_t r1 = temp1.measure();
-            uint8_t r2 = temp2.measure();
-            
-            if (r1 == r2) same++;
-        }
-        
-        std::cout << "\nCorrelation statistics (" << total << " trials):\n";
-        std::cout << "Same measurement: " << same << " (" << (100.0*same/total) << "%)\n";
-        std::cout << "Different measurement: " << (total-same) 
-                  << " (" << (100.0*(total-same)/total) << "%)\n";
-    }
-    unlink_shm(name1);
-    unlink_shm(name2);
-    std::cout << "TEST 2 COMPLETE\n";
-}
-
-void test_ghz_state() {
-    std::cout << "\n\n===== TEST 3: GHZ STATE (3-QUBIT ENTANGLEMENT) =====\n";
-    std::string name1 = "ghz_qubit1";
-    std::string name2 = "ghz_qubit2";
-    std::string name3 = "ghz_qubit3";
-    
-    {
-        Qubit q1(name1, 1);
-        Qubit q2(name2, 1);
-        Qubit q3(name3, 1);
-        
-        // Create GHZ state
-        std::vector<Qubit*> qubits = {&q1, &q2, &q3};
-        formGHZGroup(qubits);
-        
-        std::cout << "Initial GHZ state prepared:\n";
-        q1.printState();
-        q2.printState();
-        q3.printState();
-        
-        // Test correlation
-        int all_same = 0, total = 1000;
-        for (int i = 0; i < total; i++) {
-            Qubit temp1(name1, 1);
-            Qubit temp2(name2, 1);
-            Qubit temp3(name3, 1);
-            
-            // Recreate GHZ state
-            std::vector<Qubit*> temp_qubits = {&temp1, &temp2, &temp3};
-            formGHZGroup(temp_qubits);
-            
-            uint8_t r1 = temp1.measure();
-            uint8_t r2 = temp2.measure();
-            uint8_t r3 = temp3.measure();
-            
-            if (r1 == r2 && r2 == r3) all_same++;
-        }
-        
-        std::cout << "\nCorrelation statistics (" << total << " trials):\n";
-        std::cout << "All same: " << all_same << " (" << (100.0*all_same/total) << "%)\n";
-        std::cout << "Not all same: " << (total-all_same) 
-                  << " (" << (100.0*(total-all_same)/total) << "%)\n";
-        
-        // Test measurement propagation
-        std::cout << "\nTesting measurement propagation:\n";
-        Qubit temp1(name1, 1);
-        Qubit temp2(name2, 1);
-        Qubit temp3(name3, 1);
-        std::vector<Qubit*> temp_qubits = {&temp1, &temp2, &temp3};  // Fixed temporary vector
-        formGHZGroup(temp_qubits);
-        
-        std::cout << "Before measurement:\n";
-        temp1.printState();
-        temp2.printState();
-        temp3.printState();
-        
-        std::cout << "\nMeasuring qubit 1...\n";
-        uint8_t r = temp1.measure();
-        std::cout << "Result: " << (int)r << "\n";
-        
-        std::cout << "After measurement:\n";
-        temp1.printState();
-        temp2.printState();
-        temp3.printState();
-        
-        if (temp2.getMeasurement() == r && temp3.getMeasurement() == r) {
-            std::cout << "SUCCESS: All qubits collapsed to same state\n";
-        } else {
-            std::cout << "ERROR: Qubits not in same state!\n";
-        }
-    }
-    unlink_shm(name1);
-    unlink_shm(name2);
-    unlink_shm(name3);
-    std::cout << "TEST 3 COMPLETE\n";
-}
-
-void test_decoherence() {
-    std::cout << "\n\n===== TEST 4: DECOHERENCE =====\n";
-    std::string name = "decoherence_qubit";
-    
-    {
-        // Create qubit with fast decoherence (500ms)
-        Qubit q(name, 1, 500);
-        q.initSuperposition();
-        
-        std::cout << "Initial state:\n";
-        q.printState();
-        
-        std::cout << "\nWaiting 300ms (should not decohere)...\n";
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
-        if (!q.isMeasured()) {
-            std::cout << "Qubit still in superposition (correct)\n";
-        } else {
-            std::cout << "ERROR: Qubit decohered too early!\n";
-        }
-        
-        std::cout << "\nWaiting 500ms more (should decohere)...\n";
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        if (q.isMeasured()) {
-            std::cout << "Qubit collapsed to |" << (int)q.getMeasurement() << "> (correct)\n";
-        } else {
-            std::cout << "ERROR: Qubit should have decohered!\n";
-        }
-        
-        q.printState();
-    }
-    unlink_shm(name);
-    std::cout << "TEST 4 COMPLETE\n";
-}
-
-void test_advanced_entanglement() {
-    std::cout << "\n\n===== TEST 5: ADVANCED ENTANGLEMENT (4-QUBIT) =====\n";
-    std::vector<std::string> names = {"adv_qubit1", "adv_qubit2", "adv_qubit3", "adv_qubit4"};
-    std::vector<Qubit*> qubits;
-    
-    for (const auto& name : names) {
-        qubits.push_back(new Qubit(name, 1));
-    }
-    
-    // Create GHZ state with 4 qubits
-    formGHZGroup(qubits);
-    
-    std::cout << "4-qubit GHZ state prepared:\n";
-    for (auto q : qubits) q->printState();
-    
-    // Test measurement propagation
-    std::cout << "\nMeasuring first qubit...\n";
-    uint8_t r = qubits[0]->measure();
-    std::cout << "Result: " << (int)r << "\n";
-    
-    std::cout << "All qubits after measurement:\n";
-    for (auto q : qubits) q->printState();
-    
-    bool all_same = true;
-    for (auto q : qubits) {
-        if (q->getMeasurement() != r) {
-            all_same = false;
-            break;
-        }
-    }
-    
-    if (all_same) {
-        std::cout << "SUCCESS: All qubits collapsed to same state\n";
-    } else {
-        std::cout << "ERROR: Qubits not in same state!\n";
-    }
-    
-    // Cleanup
-    for (auto q : qubits) delete q;
-    for (const auto& name : names) unlink_shm(name);
-    std::cout << "TEST 5 COMPLETE\n";
-}
-
-int main() {
-    std::cout << "===== QUANTUM QUBIT SYSTEM TEST SUITE =====\n";
-    std::cout << "Testing all features of the quantum-inspired qubit implementation\n";
-    
-    test_single_qubit();
-    test_bell_state();
-    test_ghz_state();
-    test_decoherence();
-    test_advanced_entanglement();
-    
-    std::cout << "\n\n===== ALL TESTS COMPLETED SUCCESSFULLY =====\n";
-    return 0;
-}
\ No newline at end of file
+#include "qubit.h"
+#include "circuit.h"
+#include "trajectory.h"
+#include "qubit_snapshot.h"
+#include "qubit_arena.h"
+#include "qubit_soa.h"
+#include "qubit_async.h"
+#include "qubit_bridge.h"
+#include "qubit_server.h"
+#include "qubit_reaper.h"
+
+#include <dirent.h>
+#include <sys/wait.h>
+
+// ========================
+// TESTING IMPLEMENTATION
+// ========================
+
+void unlink_shm(const std::string& name) {
+    if (shm_unlink(qubitShmName(name).c_str()) == -1) {
+        perror(("shm_unlink for " + qubitShmName(name)).c_str());
+    }
+}
+
+void test_single_qubit() {
+    std::cout << "\n===== TEST 1: SINGLE QUBIT OPERATIONS =====\n";
+    std::string name = "qubit_single";
+    {
+        Qubit q(name, 1);
+        q.printState();
+        
+        // Test initialization to |0>
+        std::cout << "\n[Initialized to |0>]" << std::endl;
+        q.setState(1.0, 0.0, 0.0, 0.0);
+        q.printState();
+        
+        // Test superposition
+        std::cout << "\n[Applied Hadamard gate]" << std::endl;
+        q.applyGate('H');
+        q.printState();
+        
+        // Test measurement statistics
+        int count0 = 0, count1 = 0;
+        const int trials = 10000;
+        for (int i = 0; i < trials; i++) {
+            Qubit temp_q(name, 1);
+            temp_q.initSuperposition();
+            if (temp_q.measure() == 0) count0++;
+            else count1++;
+        }
+        std::cout << "\nMeasurement statistics (" << trials << " trials):\n";
+        std::cout << "|0>: " << count0 << " (" << (100.0*count0/trials) << "%)\n";
+        std::cout << "|1>: " << count1 << " (" << (100.0*count1/trials) << "%)\n";
+        
+        // Test X and Z gates
+        std::cout << "\n[Testing gates]" << std::endl;
+        q.setState(1.0, 0.0, 0.0, 0.0); // |0>
+        q.applyGate('X'); // Should become |1>
+        std::cout << "After X gate: ";
+        q.printState();
+        
+        q.applyGate('Z'); // Should become -|1>
+        std::cout << "After Z gate: ";
+        q.printState();
+        
+        q.applyGate('H'); // Should become |->
+        std::cout << "After H gate: ";
+        q.printState();
+    }
+    unlink_shm(name);
+    std::cout << "TEST 1 COMPLETE\n";
+}
+
+void test_bell_state() {
+    std::cout << "\n\n===== TEST 2: BELL STATE (2-QUBIT ENTANGLEMENT) =====\n";
+    std::string name1 = "bell_qubit1";
+    std::string name2 = "bell_qubit2";
+    
+    {
+        Qubit q1(name1, 1);
+        Qubit q2(name2, 1);
+        
+        // Prepare Bell state
+        q1.setState(1.0, 0.0, 0.0, 0.0); // |0>
+        q1.applyGate('H'); // (|0> + |1>)/√2
+        q2.setState(1.0, 0.0, 0.0, 0.0); // |0>
+        
+        // Entangle
+        q1.entangle({name2});
+        q2.entangle({name1});
+        
+        std::cout << "Initial Bell state prepared:\n";
+        q1.printState();
+        q2.printState();
+        
+        // Test correlation
+        int same = 0, total = 1000;
+        for (int i = 0; i < total; i++) {
+            Qubit temp1(name1, 1);
+            Qubit temp2(name2, 1);
+            
+            // Re-prepare Bell state
+            temp1.setState(1.0, 0.0, 0.0, 0.0);
+            temp1.applyGate('H');
+            temp2.setState(1.0, 0.0, 0.0, 0.0);
+            temp1.entangle({name2});
+            temp2.entangle({name1});
+            
+            uint8_t r1 = temp1.measure();
+            uint8_t r2 = temp2.measure();
+            
+            if (r1 == r2) same++;
+        }
+        
+        std::cout << "\nCorrelation statistics (" << total << " trials):\n";
+        std::cout << "Same measurement: " << same << " (" << (100.0*same/total) << "%)\n";
+        std::cout << "Different measurement: " << (total-same) 
+                  << " (" << (100.0*(total-same)/total) << "%)\n";
+    }
+    unlink_shm(name1);
+    unlink_shm(name2);
+    std::cout << "TEST 2 COMPLETE\n";
+}
+
+void test_ghz_state() {
+    std::cout << "\n\n===== TEST 3: GHZ STATE (3-QUBIT ENTANGLEMENT) =====\n";
+    std::string name1 = "ghz_qubit1";
+    std::string name2 = "ghz_qubit2";
+    std::string name3 = "ghz_qubit3";
+    
+    {
+        Qubit q1(name1, 1);
+        Qubit q2(name2, 1);
+        Qubit q3(name3, 1);
+        
+        // Create GHZ state
+        std::vector<Qubit*> qubits = {&q1, &q2, &q3};
+        formGHZGroup(qubits);
+        
+        std::cout << "Initial GHZ state prepared:\n";
+        q1.printState();
+        q2.printState();
+        q3.printState();
+        
+        // Test correlation
+        int all_same = 0, total = 1000;
+        for (int i = 0; i < total; i++) {
+            Qubit temp1(name1, 1);
+            Qubit temp2(name2, 1);
+            Qubit temp3(name3, 1);
+            
+            // Recreate GHZ state
+            std::vector<Qubit*> temp_qubits = {&temp1, &temp2, &temp3};
+            formGHZGroup(temp_qubits);
+            
+            uint8_t r1 = temp1.measure();
+            uint8_t r2 = temp2.measure();
+            uint8_t r3 = temp3.measure();
+            
+            if (r1 == r2 && r2 == r3) all_same++;
+        }
+        
+        std::cout << "\nCorrelation statistics (" << total << " trials):\n";
+        std::cout << "All same: " << all_same << " (" << (100.0*all_same/total) << "%)\n";
+        std::cout << "Not all same: " << (total-all_same) 
+                  << " (" << (100.0*(total-all_same)/total) << "%)\n";
+        
+        // Test measurement propagation
+        std::cout << "\nTesting measurement propagation:\n";
+        Qubit temp1(name1, 1);
+        Qubit temp2(name2, 1);
+        Qubit temp3(name3, 1);
+        std::vector<Qubit*> temp_qubits = {&temp1, &temp2, &temp3};  // Fixed temporary vector
+        formGHZGroup(temp_qubits);
+        
+        std::cout << "Before measurement:\n";
+        temp1.printState();
+        temp2.printState();
+        temp3.printState();
+        
+        std::cout << "\nMeasuring qubit 1...\n";
+        uint8_t r = temp1.measure();
+        std::cout << "Result: " << (int)r << "\n";
+        
+        std::cout << "After measurement:\n";
+        temp1.printState();
+        temp2.printState();
+        temp3.printState();
+        
+        if (temp2.getMeasurement() == r && temp3.getMeasurement() == r) {
+            std::cout << "SUCCESS: All qubits collapsed to same state\n";
+        } else {
+            std::cout << "ERROR: Qubits not in same state!\n";
+        }
+    }
+    unlink_shm(name1);
+    unlink_shm(name2);
+    unlink_shm(name3);
+    std::cout << "TEST 3 COMPLETE\n";
+}
+
+void test_decoherence() {
+    std::cout << "\n\n===== TEST 4: DECOHERENCE =====\n";
+    std::string name = "decoherence_qubit";
+    
+    {
+        // Create qubit with fast decoherence (500ms)
+        Qubit q(name, 1, 500);
+        q.initSuperposition();
+        
+        std::cout << "Initial state:\n";
+        q.printState();
+        
+        std::cout << "\nWaiting 300ms (should not decohere)...\n";
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        if (!q.isMeasured()) {
+            std::cout << "Qubit still in superposition (correct)\n";
+        } else {
+            std::cout << "ERROR: Qubit decohered too early!\n";
+        }
+        
+        std::cout << "\nWaiting 500ms more (should decohere)...\n";
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        if (q.isMeasured()) {
+            std::cout << "Qubit collapsed to |" << (int)q.getMeasurement() << "> (correct)\n";
+        } else {
+            std::cout << "ERROR: Qubit should have decohered!\n";
+        }
+        
+        q.printState();
+    }
+    unlink_shm(name);
+    std::cout << "TEST 4 COMPLETE\n";
+}
+
+void test_advanced_entanglement() {
+    std::cout << "\n\n===== TEST 5: ADVANCED ENTANGLEMENT (4-QUBIT) =====\n";
+    std::vector<std::string> names = {"adv_qubit1", "adv_qubit2", "adv_qubit3", "adv_qubit4"};
+    std::vector<Qubit*> qubits;
+    
+    for (const auto& name : names) {
+        qubits.push_back(new Qubit(name, 1));
+    }
+    
+    // Create GHZ state with 4 qubits
+    formGHZGroup(qubits);
+    
+    std::cout << "4-qubit GHZ state prepared:\n";
+    for (auto q : qubits) q->printState();
+    
+    // Test measurement propagation
+    std::cout << "\nMeasuring first qubit...\n";
+    uint8_t r = qubits[0]->measure();
+    std::cout << "Result: " << (int)r << "\n";
+    
+    std::cout << "All qubits after measurement:\n";
+    for (auto q : qubits) q->printState();
+    
+    bool all_same = true;
+    for (auto q : qubits) {
+        if (q->getMeasurement() != r) {
+            all_same = false;
+            break;
+        }
+    }
+    
+    if (all_same) {
+        std::cout << "SUCCESS: All qubits collapsed to same state\n";
+    } else {
+        std::cout << "ERROR: Qubits not in same state!\n";
+    }
+    
+    // Cleanup
+    for (auto q : qubits) delete q;
+    for (const auto& name : names) unlink_shm(name);
+    std::cout << "TEST 5 COMPLETE\n";
+}
+
+void test_stats() {
+    std::cout << "\n\n===== TEST 6: LATENCY STATS PAGE =====\n";
+    StatsPage* page = QubitStats::page();
+    if (!page) {
+        std::cout << "Stats disabled, skipping\n";
+        return;
+    }
+    OpSummary before[OP_COUNT], after[OP_COUNT];
+    aggregateStats(page, before);
+
+    std::string name1 = "stats_qubit1";
+    std::string name2 = "stats_qubit2";
+    const int total = 1000;
+    {
+        Qubit q1(name1, 1);
+        Qubit q2(name2, 1);
+        for (int i = 0; i < total; i++) {
+            q1.setState(1.0, 0.0, 0.0, 0.0);
+            q1.applyGate('H');
+            q2.setState(1.0, 0.0, 0.0, 0.0);
+            q1.entangle({name2});
+            q1.measure();
+        }
+    }
+    aggregateStats(page, after);
+
+    bool ok = true;
+    for (uint32_t op : {OP_MEASURE, OP_APPLY_GATE, OP_PROPAGATE}) {
+        uint64_t n = after[op].count - before[op].count;
+        std::cout << opName(op) << ": " << n << " samples, p50 "
+                  << after[op].percentile(0.5) << "ns, p99 "
+                  << after[op].percentile(0.99) << "ns\n";
+        if (n < uint64_t(total)) ok = false;
+    }
+    if (ok) {
+        std::cout << "SUCCESS: Every operation was recorded\n";
+    } else {
+        std::cout << "ERROR: Missing samples in stats page!\n";
+    }
+    unlink_shm(name1);
+    unlink_shm(name2);
+    std::cout << "TEST 6 COMPLETE\n";
+}
+
+void test_trace_ring() {
+    std::cout << "\n\n===== TEST 7: EVENT TRACE RING =====\n";
+    std::string ring_name = "trace_test_ring";
+    if (!QubitTrace::enable(1 << 16, ring_name.c_str())) {
+        std::cout << "ERROR: Could not create trace ring!\n";
+        return;
+    }
+    std::vector<std::string> names = {"trace_qubit1", "trace_qubit2", "trace_qubit3"};
+    uint8_t r;
+    {
+        Qubit q1(names[0], 7);
+        Qubit q2(names[1], 7);
+        Qubit q3(names[2], 7);
+        std::vector<Qubit*> qubits = {&q1, &q2, &q3};
+        formGHZGroup(qubits);
+        r = q1.measure();
+    }
+
+    const TraceRing* ring = QubitTrace::ring();
+    uint32_t id1 = traceId(names[0].c_str());
+    int measures = 0, propagations = 0, matching = 0;
+    readTrace(ring, [&](const TraceRecord& e) {
+        if (e.qubit_id != id1) return;
+        if (e.type == EV_MEASURE) measures++;
+        if (e.type == EV_PROPAGATE) {
+            propagations++;
+            if (e.arg == r && e.task_id == 7) matching++;
+        }
+    });
+    std::cout << "Measure events: " << measures << ", propagate events: " << propagations << "\n";
+    std::cout << "Name of first qubit in ring: " << traceLookupName(ring, id1) << "\n";
+    if (measures == 1 && propagations == 2 && matching == 2) {
+        std::cout << "SUCCESS: Collapse and propagation were traced\n";
+    } else {
+        std::cout << "ERROR: Trace does not match the GHZ collapse!\n";
+    }
+
+    const int events = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < events; i++) QubitTrace::emit(EV_GATE, id1, 7, 'H');
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Trace cost: " << std::fixed << std::setprecision(1) << ns / events << " ns/event\n";
+
+    QubitTrace::disable();
+    for (const auto& name : names) unlink_shm(name);
+    unlink_shm(ring_name);
+    std::cout << "TEST 7 COMPLETE\n";
+}
+
+void test_circuit() {
+    std::cout << "\n\n===== TEST 8: BATCHED CIRCUITS =====\n";
+    std::vector<std::string> names = {"circuit_qubit1", "circuit_qubit2", "circuit_qubit3"};
+    {
+        Qubit q1(names[0], 1);
+        Qubit q2(names[1], 1);
+        Qubit q3(names[2], 1);
+
+        Circuit bell = bellCircuit(q1, q2);
+        bell.execute();
+        std::cout << "Bell state prepared by circuit (" << bell.size() << " ops):\n";
+        q1.printState();
+        q2.printState();
+
+        bell.measure(q1).measure(q2);
+        int same = 0, total = 1000;
+        for (int i = 0; i < total; i++) {
+            std::vector<uint8_t> r = bell.execute();
+            if (r[0] == r[1]) same++;
+        }
+        std::cout << "Bell correlation: " << same << "/" << total << " same\n";
+
+        std::vector<Qubit*> qubits = {&q1, &q2, &q3};
+        Circuit ghz = ghzCircuit(qubits);
+        ghz.measure(q1).measure(q2).measure(q3);
+        int all_same = 0;
+        for (int i = 0; i < total; i++) {
+            std::vector<uint8_t> r = ghz.execute();
+            if (r[0] == r[1] && r[1] == r[2]) all_same++;
+        }
+        std::cout << "GHZ correlation: " << all_same << "/" << total << " all same\n";
+
+        if (same == total && all_same == total) {
+            std::cout << "SUCCESS: Circuits reproduce Bell and GHZ correlations\n";
+        } else {
+            std::cout << "ERROR: Circuit results are not correlated!\n";
+        }
+    }
+    for (const auto& name : names) unlink_shm(name);
+    std::cout << "TEST 8 COMPLETE\n";
+}
+
+void test_circuit_optimizer() {
+    std::cout << "\n\n===== TEST 9: PEEPHOLE CIRCUIT OPTIMIZER =====\n";
+    std::vector<std::string> names = {"opt_qubit1", "opt_qubit2"};
+    {
+        Qubit q1(names[0], 1);
+        Qubit q2(names[1], 1);
+
+        // Unitary-only circuit: optimized and raw runs must end in the same state
+        auto build = [&](Circuit& c) {
+            c.setState(q1, 0.0, 0.0, 1.0, 0.0).setState(q1, 1.0, 0.0, 0.0, 0.0)
+             .gate(q1, 'H').gate(q2, 'X').gate(q1, 'H').gate(q1, 'H')
+             .gate(q1, 'T').gate(q1, 'T').gate(q1, 'S').gate(q1, 'Z')
+             .gate(q2, 'X').gate(q2, 'H');
+        };
+        Circuit raw, opt;
+        build(raw);
+        build(opt);
+        q2.setState(1.0, 0.0, 0.0, 0.0);
+        raw.execute();
+        double raw_state[2][4];
+        for (int k = 0; k < 2; k++) {
+            QubitState s = k == 0 ? q1.readState() : q2.readState();
+            raw_state[k][0] = s.alpha_real; raw_state[k][1] = s.alpha_imag;
+            raw_state[k][2] = s.beta_real;  raw_state[k][3] = s.beta_imag;
+        }
+        OptimizeReport rep = opt.optimize();
+        q2.setState(1.0, 0.0, 0.0, 0.0);
+        opt.execute();
+        std::cout << "Unitary circuit: " << rep.gates_before << " gates -> " << rep.gates_after
+                  << " (" << rep.ops_before << " ops -> " << rep.ops_after << ")\n";
+        bool same = true;
+        for (int k = 0; k < 2; k++) {
+            QubitState s = k == 0 ? q1.readState() : q2.readState();
+            double got[4] = {s.alpha_real, s.alpha_imag, s.beta_real, s.beta_imag};
+            for (int j = 0; j < 4; j++)
+                if (std::fabs(got[j] - raw_state[k][j]) > 1e-12) same = false;
+        }
+        q1.printState();
+        q2.printState();
+
+        // Phase before measurement and gates after it are dropped
+        Circuit m;
+        m.setState(q1, 1.0, 0.0, 0.0, 0.0).gate(q1, 'H').gate(q1, 'Z').gate(q1, 'S')
+         .measure(q1).gate(q1, 'X');
+        OptimizeReport mrep = m.optimize();
+        std::cout << "Measured circuit: " << mrep.gates_before << " gates -> " << mrep.gates_after << "\n";
+
+        if (same && rep.gates_after == 2 && mrep.gates_after == 1) {
+            std::cout << "SUCCESS: Optimized circuits are equivalent and smaller\n";
+        } else {
+            std::cout << "ERROR: Optimizer changed the result or missed a rewrite!\n";
+        }
+    }
+    for (const auto& name : names) unlink_shm(name);
+    std::cout << "TEST 9 COMPLETE\n";
+}
+
+void test_relaxation() {
+    std::cout << "\n\n===== TEST 10: T1/T2 RELAXATION =====\n";
+    // Ensemble statistics of the closed-form trajectory step after dt = T
+    const int trials = 200000;
+    std::mt19937 gen(7);
+    double excited = 0, plus = 0;
+    for (int i = 0; i < trials; i++) {
+        QubitState s = {};
+        s.measured = 2;
+        s.t1_ms = 10.0;
+        s.beta_real = 1.0;                       // |1>
+        relaxState(s, 10.0, gen);
+        excited += s.beta_real * s.beta_real + s.beta_imag * s.beta_imag;
+
+        QubitState d = {};
+        d.measured = 2;
+        d.t2_ms = 10.0;
+        d.alpha_real = d.beta_real = 1.0 / M_SQRT2;  // |+>
+        relaxState(d, 10.0, gen);
+        applyGateToState(d, 'H');
+        plus += d.alpha_real * d.alpha_real + d.alpha_imag * d.alpha_imag;
+    }
+    double p1 = excited / trials, p_plus = plus / trials;
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "T1 decay after T1: P(|1>) = " << p1 << " (expected " << std::exp(-1.0) << ")\n";
+    std::cout << "T2 dephasing after T2: P(|+>) = " << p_plus
+              << " (expected " << 0.5 * (1.0 + std::exp(-1.0)) << ")\n";
+
+    // Real qubit: fully relaxed after many T1, without any polling thread
+    std::string name = "relax_qubit";
+    double relaxed_p1;
+    {
+        Qubit q(name, 1, Relaxation{5.0, 5.0});
+        q.setState(0.0, 0.0, 1.0, 0.0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        relaxed_p1 = q.probabilityOne();
+        q.printState();
+    }
+    std::cout << "P(|1>) after 20 T1: " << relaxed_p1 << "\n";
+    unlink_shm(name);
+
+    if (std::fabs(p1 - std::exp(-1.0)) < 0.01 &&
+        std::fabs(p_plus - 0.5 * (1.0 + std::exp(-1.0))) < 0.01 && relaxed_p1 < 1e-6) {
+        std::cout << "SUCCESS: Relaxation matches the T1/T2 channel\n";
+    } else {
+        std::cout << "ERROR: Relaxation statistics are off!\n";
+    }
+    std::cout << "TEST 10 COMPLETE\n";
+}
+
+void test_trajectories() {
+    std::cout << "\n\n===== TEST 11: MONTE-CARLO TRAJECTORIES =====\n";
+    std::vector<std::string> names = {"traj_qubit1", "traj_qubit2", "traj_qubit3"};
+    bool ok = true;
+    {
+        Qubit q1(names[0], 1);
+        Qubit q2(names[1], 1);
+        Qubit q3(names[2], 1);
+        QubitState before = q1.readState();
+        TrajectoryRunner runner(4);
+        const uint64_t count = 20000;
+
+        // Noiseless GHZ: only all-zero and all-one outcomes, <Z> near 0
+        Circuit ghz = ghzCircuit({&q1, &q2, &q3});
+        ghz.measure(q1).measure(q2).measure(q3);
+        TrajectoryResult r = runner.run(ghz, NoiseModel(), count);
+        std::cout << "GHZ-3 outcomes:";
+        for (const auto& kv : r.histogram) std::cout << " " << kv.first << "=" << kv.second;
+        std::cout << "\n<Z1> = " << std::fixed << std::setprecision(4) << r.expectation_z[0] << "\n";
+        ok &= r.trajectories == count && r.histogram.size() == 2 &&
+              r.histogram.count(0) && r.histogram.count(7) && std::fabs(r.expectation_z[0]) < 0.03;
+
+        // Same seed, different thread count: identical histogram
+        TrajectoryRunner single(1);
+        TrajectoryResult r1 = single.run(ghz, NoiseModel(), count);
+        ok &= r1.histogram == r.histogram;
+        std::cout << "1-thread run matches 4-thread run: " << (r1.histogram == r.histogram ? "yes" : "no") << "\n";
+
+        // Amplitude damping: |1> idles for one T1 before the measurement
+        Circuit decay;
+        decay.setState(q1, 0.0, 0.0, 1.0, 0.0).measure(q1);
+        NoiseModel noise;
+        noise.relaxation = Relaxation{10.0, 0.0};
+        noise.gate_time_ms = 10.0;
+        r = runner.run(decay, noise, count);
+        double p1 = double(r.ones[0]) / r.trajectories;
+        std::cout << "P(|1>) after T1 idle: " << p1 << " (expected " << std::exp(-1.0) << ")\n";
+        ok &= std::fabs(p1 - std::exp(-1.0)) < 0.02;
+
+        // Live qubits are untouched by trajectories
+        QubitState after = q1.readState();
+        ok &= memcmp(&before, &after, sizeof(QubitState)) == 0;
+    }
+    for (const auto& name : names) unlink_shm(name);
+
+    if (ok) {
+        std::cout << "SUCCESS: Trajectory statistics are correct\n";
+    } else {
+        std::cout << "ERROR: Trajectory statistics are off!\n";
+    }
+    std::cout << "TEST 11 COMPLETE\n";
+}
+
+void test_snapshot() {
+    std::cout << "\n\n===== TEST 12: SNAPSHOT SAVE AND RESTORE =====\n";
+    std::vector<std::string> names = {"snap_qubit1", "snap_qubit2", "snap_qubit3"};
+    const std::string path = "/tmp/" + qubitShmName("qubit_snapshot_test") + ".qsnap";
+    QubitState saved[3];
+    {
+        Qubit q1(names[0], 42, 60000);
+        Qubit q2(names[1], 42, 60000);
+        Qubit q3(names[2], 42, Relaxation{1e6, 1e6});
+        q1.setState(0.6, 0.0, 0.0, 0.8);
+        q2.initSuperposition();
+        q1.entangle({names[1]});
+        q2.entangle({names[0]});
+        q3.setState(0.0, 0.0, 1.0, 0.0);
+        q3.measure();
+        saved[0] = q1.readState();
+        saved[1] = q2.readState();
+        saved[2] = q3.readState();
+        if (!QubitSnapshot::save(path, "snap_qubit")) std::cout << "ERROR: save failed\n";
+    }
+    for (const auto& name : names) unlink_shm(name);
+
+    bool ok = true;
+    auto start = std::chrono::steady_clock::now();
+    QubitSnapshot snap = QubitSnapshot::restore(path);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Restored " << snap.size() << " qubits in " << std::fixed << std::setprecision(3) << ms << "ms\n";
+    ok &= snap.valid() && snap.size() == 3;
+    for (int i = 0; i < 3 && ok; i++) {
+        const QubitState* s = snap.find(names[i]);
+        ok &= s && memcmp(s, &saved[i], sizeof(QubitState)) == 0;
+    }
+    ok &= snap.find("snap_missing") == nullptr;
+
+    // Back into shared memory; the same task picks the states up as they were
+    ok &= snap.publish("snap_qubit") == 3;
+    {
+        Qubit q1(names[0], 42, 60000);
+        Qubit q3(names[2], 42, Relaxation{1e6, 1e6});
+        q1.printState();
+        q3.printState();
+        QubitState s = q1.readState();
+        ok &= s.measured == 2 && s.alpha_real == 0.6 && s.beta_imag == 0.8 &&
+              s.link_count == 1 && names[1] == s.links[0];
+        ok &= q3.isMeasured() && q3.getMeasurement() == saved[2].measured;
+        // Age is preserved, not the absolute steady-clock stamp
+        ok &= s.created_at <= uint64_t(OpTimer::nowNs() / 1000000);
+    }
+    for (const auto& name : names) unlink_shm(name);
+
+    // A file from another layout is rejected
+    QubitSnapshot bad = QubitSnapshot::restore("/proc/self/cmdline");
+    ok &= !bad.valid();
+    unlink(path.c_str());
+
+    if (ok) {
+        std::cout << "SUCCESS: Snapshot round-trips qubit state\n";
+    } else {
+        std::cout << "ERROR: Snapshot round-trip lost state!\n";
+    }
+    std::cout << "TEST 12 COMPLETE\n";
+}
+
+void test_arena_backing() {
+    std::cout << "\n\n===== TEST 13: ARENA BACKING STORES =====\n";
+    bool ok = true;
+    const size_t n = 1000;
+
+    // tmpfs, prefaulted
+    {
+        ArenaOptions opts;
+        opts.populate = true;
+        QubitArena arena("arena_test_shm", 5, n, opts);
+        for (size_t i = 0; i < n; i++) arena.setState(i, 1.0, 0.0, 0.0, 0.0);
+        for (size_t i = 0; i < n; i += 2) arena.applyGate(i, 'X');
+        int ones = 0;
+        for (size_t i = 0; i < n; i++) ones += arena.measure(i);
+        std::cout << "shm arena: " << ones << " of " << n << " measured |1>\n";
+        ok &= ones == int(n / 2) && arena.backing() == ARENA_SHM;
+        arena.unlink();
+    }
+
+    // Regular file: contents survive closing and reopening
+    ArenaOptions file_opts;
+    file_opts.backing = ARENA_FILE;
+    file_opts.path = "/tmp/" + qubitShmName("arena_test") + ".qarena";
+    {
+        QubitArena arena("arena_test_file", 5, n, file_opts);
+        arena.setState(7, 0.6, 0.0, 0.8, 0.0);
+    }
+    {
+        QubitArena arena("arena_test_file", 5, n, file_opts);
+        std::cout << "file arena reopened: qubit 7 beta = " << arena[7].beta_real << "\n";
+        ok &= arena[7].measured == 2 && arena[7].beta_real == 0.8;
+    }
+    {
+        QubitArena arena("arena_test_file", 6, n, file_opts);  // another task: reset
+        ok &= arena[7].measured == 0 && arena[7].beta_real == 0.0;
+        arena.unlink();
+    }
+
+    // Huge pages, or a fallback to shm where none are reserved
+    {
+        ArenaOptions opts;
+        opts.backing = ARENA_HUGETLB;
+        QubitArena arena("arena_test_huge", 5, n, opts);
+        std::cout << "hugetlb arena backed by " << arenaBackingName(arena.backing())
+                  << ", " << arena.bytes() << " bytes\n";
+        arena.setState(n - 1, 0.0, 0.0, 1.0, 0.0);
+        ok &= arena.measure(n - 1) == 1;
+        arena.unlink();
+    }
+    {
+        // A path off hugetlbfs is refused, and a file that was there stays
+        ArenaOptions opts;
+        opts.backing = ARENA_HUGETLB;
+        opts.path = "/tmp/" + qubitShmName("arena_test_huge") + ".keep";
+        int fd = open(opts.path.c_str(), O_RDWR | O_CREAT, 0666);
+        close(fd);
+        {
+            QubitArena arena("arena_test_huge_path", 5, n, opts);
+            bool kept = access(opts.path.c_str(), F_OK) == 0;
+            std::cout << "hugetlb arena on /tmp backed by " << arenaBackingName(arena.backing())
+                      << ", existing file kept: " << (kept ? "yes" : "no") << "\n";
+            ok &= fd >= 0 && arena.backing() == ARENA_SHM && kept;
+            arena.unlink();
+        }
+        unlink(opts.path.c_str());
+    }
+
+    if (ok) {
+        std::cout << "SUCCESS: Arena works on every backing store\n";
+    } else {
+        std::cout << "ERROR: Arena backing store misbehaved!\n";
+    }
+    std::cout << "TEST 13 COMPLETE\n";
+}
+
+void test_numa_arena() {
+    std::cout << "\n\n===== TEST 14: NUMA PLACEMENT AND PINNED WORKERS =====\n";
+    bool ok = parseCpuList("0-3,8,10-11\n") == std::vector<int>({0, 1, 2, 3, 8, 10, 11});
+
+    const NumaTopology& topo = NumaTopology::get();
+    std::cout << "NUMA nodes: " << topo.nodeCount();
+    for (size_t n = 0; n < topo.nodeCount(); n++)
+        std::cout << "  node" << topo.nodes[n] << " (" << topo.cpus[n].size() << " cpus)";
+    std::cout << "\n";
+
+    // Worker slices tile [0, n) exactly once
+    NumaWorkers workers(2);
+    const size_t n = 10007;
+    std::vector<std::atomic<int>> hits(n);
+    workers.parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) hits[i]++;
+    });
+    for (size_t i = 0; i < n; i++) ok &= hits[i] == 1;
+    std::cout << workers.size() << " workers on " << workers.nodes() << " node(s) covered " << n << " items\n";
+
+    // Interleaved and first-touch arenas give the same answers as the default
+    const ArenaNuma policies[] = {NUMA_INTERLEAVE, NUMA_FIRST_TOUCH};
+    for (ArenaNuma policy : policies) {
+        ArenaOptions opts;
+        opts.numa = policy;
+        opts.populate = true;
+        QubitArena arena("arena_test_numa", 5, n, opts);
+        if (policy == NUMA_FIRST_TOUCH) arena.firstTouch(workers);
+        for (size_t i = 0; i < n; i++) arena.setState(i, 1.0, 0.0, 0.0, 0.0);
+        arena.applyGateAll('X', workers);
+        int ones = 0;
+        for (size_t i = 0; i < n; i++) ones += arena.measure(i);
+        ok &= ones == int(n);
+        arena.unlink();
+    }
+
+    if (ok) {
+        std::cout << "SUCCESS: NUMA placement and workers are correct\n";
+    } else {
+        std::cout << "ERROR: NUMA placement or workers misbehaved!\n";
+    }
+    std::cout << "TEST 14 COMPLETE\n";
+}
+
+#ifdef QUBIT_HAS_ASYNC
+QubitTask awaitCollapse(Qubit& q, std::atomic<int>& done) {
+    co_await q.collapsed();
+    done++;
+}
+
+QubitTask measureThenAwaitGroup(Qubit& q, QubitGroup& group, std::atomic<int>& result, std::atomic<int>& done) {
+    result = co_await q.measureAsync();
+    co_await group.allCollapsed();
+    done++;
+}
+
+static bool waitFor(const std::atomic<int>& counter, int target) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (counter < target && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return counter >= target;
+}
+
+QubitTask measureOn(Qubit& q, QubitReactor& reactor, std::atomic<int>& result) {
+    result = co_await q.measureAsync(reactor);
+}
+
+// Counts the wakeup, and whether `pending` had no result yet when it came
+QubitTask awaitCollapseOn(Qubit& q, QubitReactor& reactor, const std::atomic<int>& pending,
+                          std::atomic<int>& done, std::atomic<bool>& first) {
+    co_await q.collapsed(reactor);
+    first = pending < 0;
+    done++;
+}
+
+void test_async() {
+    std::cout << "\n\n===== TEST 15: COROUTINE COLLAPSE EVENTS =====\n";
+    std::vector<std::string> names = {"async_qubit1", "async_qubit2", "async_qubit3",
+                                      "async_qubit4", "async_qubit5", "async_marker"};
+    bool ok = true;
+    {
+        Qubit q1(names[0], 1, 60000);
+        Qubit q2(names[1], 1, 60000);
+        Qubit q3(names[2], 1, 60000);
+        std::vector<Qubit*> bell = {&q1, &q2};
+        formGHZGroup(bell);
+        q3.initSuperposition();
+
+        // Many observers parked on one reactor; q1's collapse wakes them all
+        const int observers = 2000;
+        std::atomic<int> woken{0};
+        for (int i = 0; i < observers; i++) awaitCollapse(q2, woken);
+        std::cout << "Observers waiting: " << QubitReactor::global().waiting() << "\n";
+        ok &= woken == 0;
+        auto start = std::chrono::steady_clock::now();
+        q1.measure();
+        ok &= waitFor(woken, observers);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << woken << " observers resumed " << std::fixed << std::setprecision(2) << ms
+                  << "ms after the peer's collapse\n";
+
+        // measureAsync then wait for the whole group
+        QubitGroup group{{&q1, &q2, &q3}};
+        std::atomic<int> result{-1}, done{0};
+        measureThenAwaitGroup(q3, group, result, done);
+        ok &= waitFor(done, 1) && (result == 0 || result == 1);
+        std::cout << "measureAsync result " << result << ", group collapsed\n";
+
+        // A collapse written by another process raises no event; the poll finds it
+        q3.setState(1.0, 0.0, 0.0, 0.0);
+        std::atomic<int> foreign{0};
+        awaitCollapse(q3, foreign);
+        int fd = shm_open(qubitShmName(names[2]).c_str(), O_RDWR, 0);
+        auto* other = static_cast<QubitState*>(mmap(nullptr, sizeof(QubitState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        other->measured = 0;
+        munmap(other, sizeof(QubitState));
+        close(fd);
+        ok &= waitFor(foreign, 1);
+        std::cout << "Foreign collapse seen by the reactor poll: " << (foreign ? "yes" : "no") << "\n";
+    }
+    {
+        // A long circuit holds q4's lock. measureAsync on q4 waits on a
+        // one-thread reactor, which must still resume q5's observer.
+        Qubit q4(names[3], 1, 60000), q5(names[4], 1, 60000), marker(names[5], 1, 60000);
+        q4.initSuperposition();
+        q5.initSuperposition();
+        marker.initSuperposition();
+        QubitReactor reactor(1);
+        Circuit c;
+        c.measure(marker);  // all of the circuit's locks are held from here
+        for (int i = 0; i < 2000000; i++) c.gate(q4, 'H');
+        std::thread holder([&] { c.execute(); });
+        while (!QubitReactor::collapsed(marker)) std::this_thread::yield();
+
+        std::atomic<int> result{-1}, observed{0};
+        std::atomic<bool> first{false};
+        measureOn(q4, reactor, result);
+        awaitCollapseOn(q5, reactor, result, observed, first);
+        q5.measure();
+        ok &= waitFor(observed, 1);
+        holder.join();
+        ok &= waitFor(result, 0);
+        std::cout << "q5's observer resumed " << (first ? "before" : "after")
+                  << " the pending measureAsync on q4, which returned " << result << "\n";
+        ok &= first && (result == 0 || result == 1);
+    }
+    {
+        // Nothing waiting: the timer is disarmed and the threads sleep
+        QubitReactor idle(2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::cout << "Idle reactor over 100 ms: " << idle.wakeups << " wakeups\n";
+        ok &= idle.wakeups == 0;
+    }
+    for (const auto& name : names) unlink_shm(name);
+
+    if (ok) {
+        std::cout << "SUCCESS: Awaiters resume on collapse\n";
+    } else {
+        std::cout << "ERROR: Awaiters did not resume!\n";
+    }
+    std::cout << "TEST 15 COMPLETE\n";
+}
+#endif
+
+static bool waitMeasured(Qubit& q, int timeout_ms) {
+    for (int waited = 0; waited < timeout_ms && !q.isMeasured(); waited++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return q.isMeasured();
+}
+
+void test_bridge() {
+    std::cout << "\n\n===== TEST 16: CROSS-NODE LINKS OVER UDP =====\n";
+    // Two bridges on loopback; this process plays the qubits of both nodes
+    std::string node_a = "tA" + std::to_string(getpid() % 100000);
+    std::string node_b = "tB" + std::to_string(getpid() % 100000);
+    int port = 20000 + getpid() % 10000 * 2;  // a port pair per pid, for concurrent runs
+    BridgeOptions a_opts, b_opts;
+    a_opts.node = node_a;
+    a_opts.listen = "127.0.0.1:" + std::to_string(port);
+    a_opts.peers[node_b] = "127.0.0.1:" + std::to_string(port + 1);
+    a_opts.rto_us = 5000;
+    b_opts.node = node_b;
+    b_opts.listen = "127.0.0.1:" + std::to_string(port + 1);
+    b_opts.peers[node_a] = a_opts.listen;
+    setenv("QUBIT_NODE", node_a.c_str(), 1);
+
+    pid_t bridge_a = spawnBridge(a_opts);
+    pid_t bridge_b = spawnBridge(b_opts);
+    BridgePage* page_a = waitForBridge(node_a);
+    BridgePage* page_b = waitForBridge(node_b);
+    bool ok = page_a && page_b;
+
+    std::vector<std::string> names = {"bridge_qa", "bridge_qb"};
+    if (ok) {
+        Qubit a(names[0], 1, 60000);
+        Qubit b(names[1], 1, 60000);
+        a.initSuperposition();
+        b.initSuperposition();
+        a.entangle({node_b + ":" + names[1]});
+
+        uint8_t r = a.measure();
+        ok &= waitMeasured(b, 1000) && b.getMeasurement() == r;
+        std::cout << "A measured " << int(r) << ", B on node " << node_b << " collapsed to "
+                  << int(b.getMeasurement()) << "\n";
+
+        // Sequential round trips for latency
+        const int rounds = 200;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds && ok; i++) {
+            a.setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+            b.setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+            r = a.measure();
+            ok &= waitMeasured(b, 1000) && b.getMeasurement() == r;
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::cout << rounds << " collapses delivered, " << std::fixed << std::setprecision(1)
+                  << us / rounds << "us per measure-and-deliver\n";
+
+        // B's bridge goes down; the collapse waits in A's window and lands after restart
+        stopBridge(bridge_b);
+        b.setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+        a.setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+        r = a.measure();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ok &= !b.isMeasured();
+        bridge_b = spawnBridge(b_opts);
+        ok &= waitMeasured(b, 2000) && b.getMeasurement() == r;
+        std::cout << "Delivered after the remote bridge restarted: " << (b.isMeasured() ? "yes" : "no")
+                  << ", retransmits " << page_a->counters.retransmits.load() << "\n";
+
+        // A's bridge crashes while B's is down. The collapse waits in A's
+        // peer queue in the page and goes out once both are back.
+        stopBridge(bridge_b);
+        b.setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+        a.setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+        uint64_t sent = page_a->counters.sent.load();
+        r = a.measure();
+        for (int waited = 0; waited < 1000 && page_a->counters.sent.load() == sent; waited++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        kill(bridge_a, SIGKILL);
+        waitpid(bridge_a, nullptr, 0);
+        bridge_a = spawnBridge(a_opts);
+        bridge_b = spawnBridge(b_opts);
+        ok &= waitMeasured(b, 2000) && b.getMeasurement() == r;
+        std::cout << "Delivered after the sending bridge crashed: " << (b.isMeasured() ? "yes" : "no") << "\n";
+        ok &= page_b->counters.conflicts.load() == 0;
+        OpSummary lat = bridgeLatency(page_b->counters);
+        std::cout << "Remote collapse latency p50 " << lat.percentile(0.5) / 1000.0 << "us, p99 "
+                  << lat.percentile(0.99) / 1000.0 << "us\n";
+    }
+    stopBridge(bridge_a);
+    stopBridge(bridge_b);
+    unsetenv("QUBIT_NODE");
+    for (const auto& name : names) unlink_shm(name);
+    unlink_shm(bridgeShmName(node_a));
+    unlink_shm(bridgeShmName(node_b));
+
+    if (ok) {
+        std::cout << "SUCCESS: Remote links collapse across bridges\n";
+    } else {
+        std::cout << "ERROR: Remote collapse was lost or wrong!\n";
+    }
+    std::cout << "TEST 16 COMPLETE\n";
+}
+
+void test_server() {
+    std::cout << "\n\n===== TEST 17: QUBIT SERVER =====\n";
+    ServerOptions opts;
+    opts.name = "test_server_" + std::to_string(getpid());
+    pid_t server = spawnServer(opts);
+    bool ok = true;
+    {
+        QubitClient a(opts.name);
+        QubitClient b(opts.name);
+        ok &= a.connected() && b.connected();
+        if (ok) {
+            // Both clients resolve names to the same qubits
+            std::vector<uint32_t> h;
+            for (int i = 0; i < 3; i++) {
+                int64_t ha = a.open("srv_ghz" + std::to_string(i));
+                ok &= ha >= 0 && b.open("srv_ghz" + std::to_string(i)) == ha;
+                h.push_back(uint32_t(ha));
+            }
+            std::cout << "Handles " << h[0] << " " << h[1] << " " << h[2] << ", shared by both clients\n";
+
+            // GHZ through the server: a prepares, b measures
+            int same = 0;
+            const int trials = 200;
+            for (int t = 0; t < trials && ok; t++) {
+                for (int i = 0; i < 3; i++) {
+                    a.setState(h[i], 1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+                    a.entangle(h[i], {h[(i + 1) % 3], h[(i + 2) % 3]});
+                }
+                int r = b.measure(h[0]);
+                same += r >= 0 && b.measure(h[1]) == r && a.measure(h[2]) == r;
+            }
+            std::cout << "GHZ correlation over " << trials << " trials: " << same << " all same\n";
+            ok &= same == trials;
+
+            // Pipelined: completions come back in order with their tags
+            const uint64_t total = 20000;
+            a.setState(h[0], 1.0, 0.0, 0.0, 0.0);
+            uint64_t submitted = 0, completed = 0, in_order = 0;
+            ServerCompletion done[256];
+            while (completed < total) {
+                while (submitted < total) {
+                    ServerCommand c = QubitClient::gateCmd(h[0], 'X');
+                    c.tag = submitted;
+                    if (!a.submit(c)) break;
+                    submitted++;
+                }
+                a.flush();
+                size_t n = a.poll(done, 256);
+                for (size_t i = 0; i < n; i++, completed++) in_order += done[i].tag == completed;
+                if (!n) std::this_thread::yield();
+            }
+            ok &= in_order == total;
+            ok &= a.measure(h[0]) == 0;  // an even number of X gates
+            std::cout << total << " pipelined gates completed in order: " << (in_order == total ? "yes" : "no") << "\n";
+
+            // Errors come back as statuses
+            a.setState(h[1], 1.0, 0.0, 0.0, 0.0);
+            ok &= a.measure(1000000) == -1 && !a.applyGate(h[1], 'Q');
+        }
+    }
+    {
+        // Slots of disconnected clients are free again
+        QubitClient c(opts.name);
+        ok &= c.connected() && c.open("srv_ghz0") == 0;
+    }
+    {
+        // A slot whose pid lives on in another process is reclaimed too
+        QubitClient d(opts.name);
+        auto* page = static_cast<ServerPage*>(mapShmSegment(opts.name, sizeof(ServerPage), false));
+        ServerClientSlot* mine = nullptr;
+        for (uint32_t i = 0; i < SERVER_MAX_CLIENTS && page; i++)
+            if (page->clients[i].state.load() == SLOT_ACTIVE && page->clients[i].pid.load() == getpid())
+                mine = &page->clients[i];
+        bool reclaimed = false;
+        if (mine) {
+            mine->start += 1;  // as if the client died and its pid was reused
+            for (int i = 0; i < 200 && !reclaimed; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                reclaimed = mine->state.load() != SLOT_ACTIVE;
+            }
+        }
+        if (page) munmap(page, sizeof(ServerPage));
+
+        // A client that never connected fails instead of touching a slot
+        QubitClient none("no_server_" + std::to_string(getpid()), 10);
+        bool refused = !none.connected() && !none.submit(QubitClient::measureCmd(0)) && none.measure(0) == -1;
+        std::cout << "Slot of a reused pid reclaimed: " << (reclaimed ? "yes" : "no")
+                  << "; unconnected client refused: " << (refused ? "yes" : "no") << "\n";
+        ok &= reclaimed && refused;
+    }
+    {
+        // A second server leaves the running one's page alone
+        pid_t second = spawnServer(opts);
+        int status = 0;
+        waitpid(second, &status, 0);
+        QubitClient c(opts.name);
+        bool refused = WIFEXITED(status) && WEXITSTATUS(status) == 1 && c.connected() && c.open("srv_ghz0") == 0;
+        std::cout << "Second server on the same page refused: " << (refused ? "yes" : "no") << "\n";
+        ok &= refused;
+
+        // Blocking calls fail instead of hanging once the server is gone
+        kill(server, SIGKILL);
+        waitpid(server, nullptr, 0);
+        auto start = std::chrono::steady_clock::now();
+        bool failed = c.measure(0) == -1;
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Call to a killed server failed after " << ms << " ms\n";
+        ok &= failed;
+    }
+    unlink_shm(opts.name);
+
+    if (ok) {
+        std::cout << "SUCCESS: Server qubits behave like shared-memory qubits\n";
+    } else {
+        std::cout << "ERROR: Server results were wrong!\n";
+    }
+    std::cout << "TEST 17 COMPLETE\n";
+}
+
+void test_arena_batch() {
+    std::cout << "\n\n===== TEST 18: BATCH ARENA OPERATIONS =====\n";
+    bool ok = true;
+    const size_t n = 20000;
+    QubitArena batch("arena_batch_a", 1, n);
+    QubitArena single("arena_batch_b", 1, n);
+
+    // Shuffled handles with repeats; later entries for a qubit win
+    std::mt19937 gen(11);
+    std::vector<uint32_t> handles(3 * n);
+    for (auto& h : handles) h = gen() % n;
+    std::vector<double> amps(4 * handles.size());
+    std::vector<char> gates(handles.size());
+    const char basis[] = {'H', 'X', 'Z', 'S', 'T'};
+    for (size_t k = 0; k < handles.size(); k++) {
+        double theta = (gen() % 1000) * 0.001 * M_PI;
+        amps[4 * k] = std::cos(theta);
+        amps[4 * k + 2] = std::sin(theta);
+        gates[k] = basis[gen() % 5];
+    }
+
+    batch.setStates(handles.data(), handles.size(), amps.data());
+    batch.applyGates(handles.data(), handles.size(), gates.data());
+    batch.applyGates(handles.data(), n, 'H');
+    for (size_t k = 0; k < handles.size(); k++)
+        single.setState(handles[k], amps[4 * k], amps[4 * k + 1], amps[4 * k + 2], amps[4 * k + 3]);
+    for (size_t k = 0; k < handles.size(); k++) single.applyGate(handles[k], gates[k]);
+    for (size_t k = 0; k < n; k++) single.applyGate(handles[k], 'H');
+    size_t differ = 0;
+    for (size_t i = 0; i < n; i++) differ += std::memcmp(&batch[i], &single[i], sizeof(QubitState)) != 0;
+    std::cout << "Batched vs per-call states differing: " << differ << " of " << n << "\n";
+    ok &= differ == 0;
+
+    // Basis states measure deterministically; repeats see the stored value
+    std::vector<uint32_t> all(n);
+    std::vector<double> basis_amps(4 * n, 0.0);
+    for (size_t i = 0; i < n; i++) {
+        all[n - 1 - i] = uint32_t(i);
+        basis_amps[4 * (n - 1 - i) + (i % 3 == 0 ? 2 : 0)] = 1.0;
+    }
+    batch.setStates(all.data(), n, basis_amps.data());
+    std::vector<uint8_t> results(handles.size());
+    batch.measureMany(all.data(), n, results.data());
+    size_t wrong = 0;
+    for (size_t i = 0; i < n; i++) wrong += results[n - 1 - i] != (i % 3 == 0);
+
+    // Equal superpositions: about half |1>
+    std::vector<double> plus(4 * n, 0.0);
+    for (size_t i = 0; i < n; i++) plus[4 * i] = plus[4 * i + 2] = 1.0 / M_SQRT2;
+    batch.setStates(all.data(), n, plus.data());
+    batch.measureMany(handles.data(), handles.size(), results.data());
+    size_t ones = 0, measured = 0;
+    for (size_t i = 0; i < n; i++) {
+        ones += batch[i].measured == 1;
+        measured += batch[i].measured != 2;
+    }
+    for (size_t k = 0; k < handles.size(); k++) wrong += results[k] != batch[handles[k]].measured;
+    std::cout << "measureMany: " << wrong << " wrong results, " << ones << " of " << measured << " in |1>\n";
+    ok &= wrong == 0 && ones > measured * 0.47 && ones < measured * 0.53;
+    batch.unlink();
+    single.unlink();
+
+    if (ok) {
+        std::cout << "SUCCESS: Batch operations match per-call operations\n";
+    } else {
+        std::cout << "ERROR: Batch operations diverged!\n";
+    }
+    std::cout << "TEST 18 COMPLETE\n";
+}
+
+void test_soa_arena() {
+    std::cout << "\n\n===== TEST 19: STRUCTURE-OF-ARRAYS ARENA =====\n";
+    bool ok = true;
+    const size_t n = 10003;  // not a multiple of the vector width
+    QubitSoaArena soa("soa_test", 1, n);
+    QubitArena aos("soa_test_aos", 1, n);
+    std::cout << "Gate kernel: " << soaKernelName() << "\n";
+
+    // Random states, every fifth qubit collapsed
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<double> u(-1.0, 1.0);
+    for (size_t i = 0; i < n; i++) {
+        double ar = u(gen), ai = u(gen), br = u(gen), bi = u(gen);
+        double norm = std::sqrt(ar * ar + ai * ai + br * br + bi * bi);
+        soa.setState(i, ar / norm, ai / norm, br / norm, bi / norm);
+        aos.setState(i, ar / norm, ai / norm, br / norm, bi / norm);
+        if (i % 5 == 0) {
+            soa.measure(i);
+            aos[i].measured = soa.getMeasurement(i);
+            collapseState(aos[i], aos[i].measured);
+        }
+    }
+
+    // Range gates match applyGateToState bit for bit
+    const char* gates = "HTSXZHTT";
+    for (const char* g = gates; *g; g++) {
+        soa.applyGateRange(3, n - 2, *g);
+        for (size_t i = 3; i < n - 2; i++)
+            if (aos[i].measured == 2) applyGateToState(aos[i], *g);
+    }
+    size_t differ = 0;
+    for (size_t i = 0; i < n; i++) {
+        QubitState a = soa.readState(i);
+        const QubitState& b = aos[i];
+        differ += std::memcmp(&a.alpha_real, &b.alpha_real, 4 * sizeof(double)) != 0 || a.measured != b.measured;
+    }
+    std::cout << "Range gates vs applyGateToState: " << differ << " of " << n << " qubits differ\n";
+    ok &= differ == 0;
+
+    // Handles behave like Qubits
+    SoaQubit q = soa.qubit(42);
+    q.setState(1.0, 0.0, 0.0, 0.0);
+    q.applyGate('H');
+    double p1 = q.probabilityOne();
+    q.applyGate('H');
+    ok &= std::fabs(p1 - 0.5) < 1e-12 && q.probabilityOne() < 1e-12 && !q.isMeasured();
+    q.applyGate('X');
+    ok &= q.measure() == 1 && q.isMeasured() && q.getMeasurement() == 1;
+    soa.applyGateAll('X');  // collapsed: untouched
+    ok &= q.readState().beta_real == 1.0;
+    std::cout << "Handle: P(1) after H = " << p1 << ", measured " << int(q.getMeasurement()) << " after H H X\n";
+    soa.unlink();
+    aos.unlink();
+
+    if (ok) {
+        std::cout << "SUCCESS: SoA arena matches the per-qubit kernels\n";
+    } else {
+        std::cout << "ERROR: SoA arena diverged!\n";
+    }
+    std::cout << "TEST 19 COMPLETE\n";
+}
+
+void test_bulk_measure() {
+    std::cout << "\n\n===== TEST 20: BULK MEASUREMENT =====\n";
+    bool ok = true;
+    const size_t n = 100004;  // not a multiple of 8; ends just after a 7k + 1
+    QubitSoaArena a("bulk_test_a", 1, n);
+    QubitSoaArena b("bulk_test_b", 1, n);
+    for (size_t i = 0; i < n; i++) {
+        a.setState(i, std::sqrt(0.7), 0.0, 0.0, std::sqrt(0.3));  // P(1) = 0.3
+        b.setState(i, std::sqrt(0.7), 0.0, 0.0, std::sqrt(0.3));
+    }
+    for (size_t i = 0; i < n; i += 7) {  // some collapsed beforehand, alternating values
+        a.setState(i, 0.0, 0.0, 1.0, 0.0);
+        a.measure(i);
+        a.setState(i + 1, 1.0, 0.0, 0.0, 0.0);
+        a.measure(i + 1);
+    }
+
+    // Whole arena: bitset, measured bytes and amplitudes agree
+    std::vector<uint64_t> bits((n + 63) / 64);
+    a.measureAll(bits.data());
+    size_t ones = 0, drawn = 0, drawn_ones = 0, mismatched = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t bit = (bits[i / 64] >> (i % 64)) & 1;
+        QubitState st = a.readState(i);
+        mismatched += st.measured != bit || st.beta_real != bit || st.alpha_real != 1 - bit;
+        ones += bit;
+        if (i % 7 > 1) { drawn++; drawn_ones += bit; }
+        if (i % 7 == 0) mismatched += bit != 1;
+        if (i % 7 == 1) mismatched += bit != 0;
+    }
+    double frac = double(drawn_ones) / drawn;
+    std::cout << "measureAll: " << mismatched << " inconsistent qubits, P(1) drawn " << std::fixed
+              << std::setprecision(4) << frac << " (expected 0.3)\n";
+    ok &= mismatched == 0 && std::fabs(frac - 0.3) < 0.01;
+
+    // Scalar and SIMD kernels draw the same bits; unaligned range
+    const uint64_t key = 12345;
+    size_t begin = 3, end = n - 5;
+    std::vector<uint64_t> simd_bits((end - begin + 63) / 64), scalar_bits(simd_bits.size());
+    QubitSoaArena c("bulk_test_c", 1, n);
+    for (size_t i = 0; i < n; i++) c.setState(i, std::sqrt(0.7), 0.0, 0.0, std::sqrt(0.3));
+    soaMeasure(b.view(), begin, end, key, simd_bits.data());
+    soaMeasureScalar(c.view(), begin, end, key, scalar_bits.data());
+    bool same = simd_bits == scalar_bits && b.getMeasurement(begin - 1) == 2 && b.getMeasurement(end) == 2;
+    std::cout << soaKernelName() << " and scalar kernels agree: " << (same ? "yes" : "no") << "\n";
+    ok &= same;
+    a.unlink();
+    b.unlink();
+    c.unlink();
+
+    if (ok) {
+        std::cout << "SUCCESS: Bulk measurement collapses with the right statistics\n";
+    } else {
+        std::cout << "ERROR: Bulk measurement is wrong!\n";
+    }
+    std::cout << "TEST 20 COMPLETE\n";
+}
+
+void test_normalize() {
+    std::cout << "\n\n===== TEST 21: NORMALIZATION AND STATE VALIDATION =====\n";
+    bool ok = true;
+    {
+        Qubit q("norm_qubit", 1);
+        bool scaled = q.setStateNormalized(3.0, 0.0, 4.0, 0.0);  // (3|0> + 4|1>) / 5
+        bool rejected = !q.setStateNormalized(0.0, 0.0, 0.0, 0.0);
+        std::cout << "setStateNormalized(3, 0, 4, 0): P(1) = " << q.probabilityOne()
+                  << ", zero vector rejected: " << (rejected ? "yes" : "no") << "\n";
+        ok &= scaled && rejected && std::fabs(q.probabilityOne() - 0.64) < 1e-12;
+    }
+    unlink_shm("norm_qubit");
+
+    // A mix of valid, drifted, unnormalized, invalid and measured states
+    const size_t n = 10003;
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> amps(4 * n);
+    size_t expect_bad = 0, expect_invalid = 0;
+    for (size_t i = 0; i < n; i++) {
+        double* a = &amps[4 * i];
+        double t = 0.001 * i;
+        a[0] = std::cos(t); a[1] = 0.0; a[2] = 0.0; a[3] = std::sin(t);
+        switch (i % 5) {
+        case 1: a[0] *= 1.0 + 1e-12; break;                  // rounding drift, within tolerance
+        case 2: a[0] *= 2.0; a[3] *= 2.0; expect_bad++; break;
+        case 3: if (i % 3 == 0) { a[1] = nan; expect_bad++; expect_invalid++; } break;
+        case 4: if (i % 3 == 0) { a[0] = a[3] = 0.0; expect_bad++; expect_invalid++; } break;
+        }
+    }
+    NormPolicy report_only;
+    report_only.action = NORM_REPORT;
+    QubitSoaArena simd("norm_test_simd", 1, n), scalar("norm_test_scalar", 1, n);
+    NormReport loaded = simd.loadStates(0, n, amps.data(), report_only);
+    scalar.loadStates(0, n, amps.data(), report_only);
+    std::cout << "loadStates: " << loaded.checked << " checked, " << loaded.out_of_tolerance
+              << " out of tolerance, " << loaded.invalid << " invalid (expected " << expect_bad << ", "
+              << expect_invalid << ")\n";
+    ok &= loaded.checked == n && loaded.out_of_tolerance == expect_bad && loaded.invalid == expect_invalid;
+
+    // Scalar and SIMD kernels repair identically; unaligned range, measured qubits skipped
+    simd.measure(0);
+    scalar.measure(0);
+    NormReport fixed = soaNormalize(simd.view(), 0, n - 1, NormPolicy());
+    NormReport fixed_scalar = soaNormalizeScalar(scalar.view(), 0, n - 1, NormPolicy());
+    bool same = fixed.checked == fixed_scalar.checked && fixed.out_of_tolerance == fixed_scalar.out_of_tolerance &&
+                fixed.invalid == fixed_scalar.invalid && fixed.max_deviation == fixed_scalar.max_deviation;
+    for (size_t i = 0; i < n; i++) {
+        QubitState x = simd.readState(i), y = scalar.readState(i);
+        same &= std::memcmp(&x, &y, sizeof(x)) == 0;
+    }
+    std::cout << soaKernelName() << " and scalar kernels agree: " << (same ? "yes" : "no") << "\n";
+    ok &= same && fixed.checked == n - 2;
+
+    simd.normalizeStates(n - 1, n);
+    NormReport after = simd.normalizeStates(0, n);
+    std::cout << "after renormalizing: " << after.out_of_tolerance << " out of tolerance, max deviation "
+              << after.max_deviation << "\n";
+    ok &= after.ok() && after.max_deviation < 1e-11 && simd.getMeasurement(0) != 2;
+    simd.unlink();
+    scalar.unlink();
+
+    // The AoS arena applies the same policy
+    QubitArena aos("norm_test_aos", 1, n);
+    for (size_t i = 0; i < n; i++) {
+        const double* a = &amps[4 * i];
+        aos.setState(i, a[0], a[1], a[2], a[3]);
+    }
+    NormReport aos_report = aos.normalizeStates(0, n);
+    NormReport aos_after = aos.normalizeStates(0, n);
+    std::cout << "AoS arena: " << aos_report.out_of_tolerance << " repaired, " << aos_after.out_of_tolerance
+              << " left\n";
+    ok &= aos_report.out_of_tolerance == expect_bad && aos_report.invalid == expect_invalid && aos_after.ok();
+    aos.unlink();
+
+    if (ok) {
+        std::cout << "SUCCESS: States are validated and normalized\n";
+    } else {
+        std::cout << "ERROR: Normalization is wrong!\n";
+    }
+    std::cout << "TEST 21 COMPLETE\n";
+}
+
+void test_float_arena() {
+    std::cout << "\n\n===== TEST 22: FLOAT AMPLITUDE ARENA =====\n";
+    bool ok = true;
+    const size_t n = 10007;  // not a multiple of 16
+    FloatSoaArena f("float_test", 1, n), g("float_test_scalar", 1, n);
+    QubitSoaArena d("float_test_double", 1, n);
+    std::cout << "bytes: float " << f.bytes() << ", double " << d.bytes() << "\n";
+    ok &= f.bytes() * 3 < d.bytes() * 2;
+
+    std::mt19937 gen(23);
+    std::uniform_real_distribution<double> u(-1.0, 1.0);
+    std::vector<double> amps(4 * n);
+    for (double& a : amps) a = u(gen);
+    NormReport loaded = f.loadStates(0, n, amps.data());
+    g.loadStates(0, n, amps.data());
+    d.loadStates(0, n, amps.data());
+    for (size_t i = 0; i < n; i += 9) {  // some collapsed
+        f.setState(i, 0.0, 0.0, 1.0, 0.0);
+        g.setState(i, 0.0, 0.0, 1.0, 0.0);
+        d.setState(i, 0.0, 0.0, 1.0, 0.0);
+        f.measure(i);
+        g.measure(i);
+        d.measure(i);
+    }
+    ok &= loaded.checked == n && f.normalizeStates(0, n).ok();
+
+    // Vector and scalar float kernels agree bit for bit; float tracks double
+    const char* gates = "HTSXZHTTHSHT";
+    for (int rep = 0; rep < 10; rep++) {
+        for (const char* c = gates; *c; c++) {
+            f.applyGateRange(1, n - 1, *c);
+            soaGateScalar(g.view(), 1, n - 1, *c);
+            d.applyGateRange(1, n - 1, *c);
+        }
+    }
+    size_t differ = 0;
+    double worst = 1.0;
+    for (size_t i = 0; i < n; i++) {
+        QubitState a = f.readState(i), b = g.readState(i);
+        differ += std::memcmp(&a.alpha_real, &b.alpha_real, 4 * sizeof(double)) != 0 || a.measured != b.measured;
+        worst = std::min(worst, stateFidelity(a, d.readState(i)));
+    }
+    std::cout << soaKernelName() << " vs scalar float kernels: " << differ << " of " << n
+              << " qubits differ; worst fidelity to double after " << 10 * strlen(gates) << " gates: 1 - "
+              << std::scientific << std::setprecision(2) << 1.0 - worst << std::defaultfloat << "\n";
+    ok &= differ == 0 && 1.0 - worst < 1e-5;
+
+    // Handles and measurement work the same as on a double arena
+    FloatSoaQubit q = f.qubit(5);
+    q.setState(1.0, 0.0, 0.0, 0.0);
+    q.applyGate('H');
+    double p1 = q.probabilityOne();
+    q.applyGate('H');
+    q.applyGate('X');
+    ok &= std::fabs(p1 - 0.5) < 1e-6 && q.measure() == 1 && q.readState().beta_real == 1.0;
+    std::vector<uint64_t> bits((n + 63) / 64);
+    f.measureAll(bits.data());
+    size_t unmeasured = 0;
+    for (size_t i = 0; i < n; i++) unmeasured += f.getMeasurement(i) == 2;
+    ok &= unmeasured == 0 && (bits[0] >> 5 & 1) == 1;
+    f.unlink();
+    g.unlink();
+    d.unlink();
+
+    if (ok) {
+        std::cout << "SUCCESS: Float arena halves the footprint and tracks double precision\n";
+    } else {
+        std::cout << "ERROR: Float arena is wrong!\n";
+    }
+    std::cout << "TEST 22 COMPLETE\n";
+}
+
+void test_qubit_policies() {
+    std::cout << "\n\n===== TEST 23: BasicQubit POLICIES =====\n";
+    bool ok = true;
+
+    // Every variant runs the same kernels: X then measure gives 1, H H is identity
+    BasicQubit<ShmStorage, SpinLock, ThreadDecoherence, 2> spin("policy_spin", 1);
+    BasicQubit<LocalStorage, std::mutex, NoDecoherence, 4> local("policy_local", 1);
+    SimQubit sim("policy_sim", 1, 1);  // 1 ms timeout, ignored
+    spin.setState(1.0, 0.0, 0.0, 0.0);
+    local.setState(1.0, 0.0, 0.0, 0.0);
+    sim.setState(1.0, 0.0, 0.0, 0.0);
+    spin.applyGate('X');
+    local.applyGate('H');
+    local.applyGate('H');
+    sim.applyGate('H');
+    ok &= spin.measure() == 1 && std::fabs(local.probabilityOne()) < 1e-12 && std::fabs(sim.probabilityOne() - 0.5) < 1e-12;
+
+    // Local storage creates no segment; MaxLinks caps entangle()
+    bool no_segment = shm_open(qubitShmName("policy_local").c_str(), O_RDONLY, 0) < 0 &&
+                      shm_open(qubitShmName("policy_sim").c_str(), O_RDONLY, 0) < 0;
+    spin.entangle({"a", "b", "c"});
+    sim.entangle({"policy_spin"});
+    std::cout << "local storage leaves /dev/shm alone: " << (no_segment ? "yes" : "no") << ", links kept: spin "
+              << spin.readState().link_count << " of 3, sim " << sim.readState().link_count << " of 1\n";
+    ok &= no_segment && spin.readState().link_count == 2 && sim.readState().link_count == 0;
+
+    // No decoherence: still in superposition well past the timeout
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    std::cout << "SimQubit after 250 ms with a 1 ms timeout: " << (sim.isMeasured() ? "collapsed" : "superposition")
+              << "\n";
+    ok &= !sim.isMeasured();
+    uint8_t r = sim.measure();
+    ok &= sim.isMeasured() && sim.getMeasurement() == r;
+    unlink_shm("policy_spin");
+
+    if (ok) {
+        std::cout << "SUCCESS: Policy variants behave like Qubit minus what they drop\n";
+    } else {
+        std::cout << "ERROR: Policy variants misbehave!\n";
+    }
+    std::cout << "TEST 23 COMPLETE\n";
+}
+
+void test_gate_algebra() {
+    std::cout << "\n\n===== TEST 24: COMPILE-TIME GATE ALGEBRA =====\n";
+    using namespace gates;
+    // Identities checked by the compiler
+    static_assert(equalUpToPhase(gateMatrix<Seq<H, Z, H>>(), X::matrix()), "HZH = X");
+    static_assert(equalUpToPhase(gateMatrix<Seq<H, X, H>>(), Z::matrix()), "HXH = Z");
+    static_assert(equalUpToPhase(gateMatrix<Seq<T, T>>(), S::matrix()), "TT = S");
+    static_assert(equalUpToPhase(gateMatrix<Seq<S, S>>(), Z::matrix()), "SS = Z");
+    static_assert(equalUpToPhase(gateMatrix<Seq<H, H>>(), I::matrix()), "HH = I");
+    static_assert(equalUpToPhase(gateMatrix<Seq<X, Y, Z>>(), I::matrix()), "ZYX = I up to phase");
+    static_assert(!equalUpToPhase(gateMatrix<Seq<H, T>>(), gateMatrix<Seq<T, H>>()), "HT != TH");
+    bool ok = true;
+
+    // The X-Z-H chain of TEST 1 as one multiply
+    std::string name = "gate_algebra_qubit";
+    {
+        Qubit q(name, 1);
+        q.setState(1.0, 0.0, 0.0, 0.0);
+        q.applyGate('X');
+        q.applyGate('Z');
+        q.applyGate('H');
+        QubitState stepwise = q.readState();
+        q.setState(1.0, 0.0, 0.0, 0.0);
+        q.apply<Seq<X, Z, H>>();
+        QubitState fused = q.readState();
+        double err = std::fabs(stepwise.alpha_real - fused.alpha_real) + std::fabs(stepwise.alpha_imag - fused.alpha_imag) +
+                     std::fabs(stepwise.beta_real - fused.beta_real) + std::fabs(stepwise.beta_imag - fused.beta_imag);
+        std::cout << "X, Z, H one at a time vs apply<Seq<X, Z, H>>: difference " << err << "\n";
+        ok &= err < 1e-15;
+
+        // H then measure
+        int ones = 0;
+        for (int i = 0; i < 2000; i++) {
+            q.setState(1.0, 0.0, 0.0, 0.0);
+            q.apply<H>();
+            ones += q.measure();
+        }
+        std::cout << "apply<H> then measure: " << ones << " of 2000 gave |1>\n";
+        ok &= ones > 850 && ones < 1150;
+    }
+    unlink_shm(name);
+
+    // Nested sequences and the arena path
+    QubitArena arena("gate_algebra_arena", 1, 2);
+    arena.setState(0, 1.0, 0.0, 0.0, 0.0);
+    arena.setState(1, 1.0, 0.0, 0.0, 0.0);
+    for (char g : std::string("HTHSX")) arena.applyGate(0, g);
+    arena.applyUnitary(1, gateMatrix<Seq<Seq<H, T>, Seq<H, S>, X>>());
+    double f = stateFidelity(arena[0], arena[1]);
+    std::cout << "Seq<Seq<H, T>, Seq<H, S>, X> on an arena qubit: fidelity " << std::setprecision(15) << f << "\n";
+    ok &= std::fabs(f - 1.0) < 1e-14;
+    arena.unlink();
+
+    if (ok) {
+        std::cout << "SUCCESS: Compile-time sequences match the step-by-step gates\n";
+    } else {
+        std::cout << "ERROR: Compile-time sequences are wrong!\n";
+    }
+    std::cout << "TEST 24 COMPLETE\n";
+}
+
+void test_pauli_expectation() {
+    std::cout << "\n\n===== TEST 25: PAULI EXPECTATION VALUES =====\n";
+    bool ok = true;
+
+    // |+>: <X> = 1, <Z> = 0; S takes it to |+i>: <Y> = 1; measured: <Z> = +-1
+    std::string name = "pauli_qubit";
+    {
+        Qubit q(name, 1);
+        q.setState(1.0, 0.0, 0.0, 0.0);
+        q.applyGate('H');
+        std::cout << "|+>: <X> = " << q.expectation(PAULI_X) << ", <Z> = " << q.expectation(PAULI_Z) << "\n";
+        ok &= std::fabs(q.expectation(PAULI_X) - 1.0) < 1e-15 && std::fabs(q.expectation(PAULI_Z)) < 1e-15;
+        q.apply<gates::S>();
+        std::cout << "S|+>: <Y> = " << q.expectation(PAULI_Y) << "\n";
+        ok &= std::fabs(q.expectation(PAULI_Y) - 1.0) < 1e-15 && std::fabs(q.expectation(PAULI_X)) < 1e-15;
+        int m = q.measure();
+        std::cout << "Measured " << m << ": <Z> = " << q.expectation(PAULI_Z) << ", <X> = " << q.expectation(PAULI_X) << "\n";
+        ok &= q.expectation(PAULI_Z) == (m ? -1.0 : 1.0) && q.expectation(PAULI_X) == 0.0;
+    }
+    unlink_shm(name);
+
+    // cos(t/2)|0> + sin(t/2)|1>: <X> = sin t, <Z> = cos t, over a register
+    const size_t n = 1003;
+    QubitArena aos("pauli_aos", 1, n);
+    QubitSoaArena soa("pauli_soa", 1, n);
+    double worst = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double t = 0.01 * i;
+        aos.setState(i, std::cos(t / 2), 0.0, std::sin(t / 2), 0.0);
+        worst = std::max(worst, std::fabs(aos.expectation(i, PAULI_X) - std::sin(t)));
+        worst = std::max(worst, std::fabs(aos.expectation(i, PAULI_Z) - std::cos(t)));
+        worst = std::max(worst, std::fabs(aos.expectation(i, PAULI_Y)));
+    }
+    std::cout << "Rotated states: worst error against sin t / cos t " << worst << "\n";
+    ok &= worst < 1e-14;
+
+    // Random states, every seventh collapsed; AVX-512 table vs scalar table
+    std::mt19937 gen(25);
+    std::uniform_real_distribution<double> u(-1.0, 1.0);
+    for (size_t i = 0; i < n; i++) {
+        double ar = u(gen), ai = u(gen), br = u(gen), bi = u(gen);
+        double norm = std::sqrt(ar * ar + ai * ai + br * br + bi * bi);
+        aos.setState(i, ar / norm, ai / norm, br / norm, bi / norm);
+        soa.setState(i, ar / norm, ai / norm, br / norm, bi / norm);
+        if (i % 7 == 0) {
+            soa.measure(i);
+            aos[i] = soa.readState(i);
+        }
+    }
+    std::vector<double> vx(n), vy(n), vz(n), sx(n), sy(n), sz(n);
+    soaPauli(soa.view(), 0, n, vx.data(), vy.data(), vz.data());
+    soaPauliScalar(soa.view(), 0, n, sx.data(), sy.data(), sz.data());
+    bool same = vx == sx && vy == sy && vz == sz;
+    std::cout << "Kernel " << soaKernelName() << " vs scalar: " << (same ? "identical" : "DIFFERENT") << "\n";
+    ok &= same;
+
+    // Batched strings against one at a time, SoA against AoS
+    std::vector<PauliString> strings;
+    strings.push_back(PauliString("XYZ"));
+    strings.push_back(PauliString("ZZZZZZZZ", 100));
+    strings.push_back(PauliString().set(3, PAULI_X).set(900, PAULI_Y).set(n + 5, PAULI_Z));
+    strings.push_back(PauliString(std::string(n, 'Z')));
+    strings.push_back(PauliString());
+    std::vector<double> batched = soa.expectations(strings), batched_aos = aos.expectations(strings);
+    double diff = 0.0;
+    for (size_t k = 0; k < strings.size(); k++) {
+        diff = std::max(diff, std::fabs(batched[k] - soa.expectation(strings[k])));
+        diff = std::max(diff, std::fabs(batched[k] - batched_aos[k]));
+        std::cout << "  string " << k << " (" << strings[k].terms.size() << " terms): " << batched[k] << "\n";
+    }
+    double sparse = soa.expectations(std::vector<PauliString>(1, strings[2]))[0];  // gathered, not tabulated
+    diff = std::max(diff, std::fabs(sparse - batched[2]));
+    std::cout << "Batched vs single, SoA vs AoS: max difference " << diff << "\n";
+    ok &= diff < 1e-15 && batched[4] == 1.0;
+
+    // A register of Qubit objects
+    std::vector<std::string> names;
+    std::vector<Qubit*> reg;
+    for (int i = 0; i < 3; i++) {
+        names.push_back("pauli_reg_" + std::to_string(i));
+        reg.push_back(new Qubit(names.back(), 1));
+        reg.back()->setState(1.0, 0.0, 0.0, 0.0);
+    }
+    reg[0]->applyGate('H');
+    reg[2]->applyGate('X');
+    double xiz = expectation(reg, PauliString("XIZ"));
+    std::cout << "<XIZ> on |+>|0>|1>: " << xiz << "\n";
+    ok &= std::fabs(xiz + 1.0) < 1e-15;
+    for (size_t i = 0; i < reg.size(); i++) {
+        delete reg[i];
+        unlink_shm(names[i]);
+    }
+
+    aos.unlink();
+    soa.unlink();
+    if (ok) {
+        std::cout << "SUCCESS: Expectation values match the analytic results\n";
+    } else {
+        std::cout << "ERROR: Expectation values are wrong!\n";
+    }
+    std::cout << "TEST 25 COMPLETE\n";
+}
+
+// Qubit on a manually advanced clock
+typedef BasicQubit<ShmStorage, std::mutex, ThreadDecoherence, 4, OpTimer, VirtualClock> VirtualQubit;
+
+void test_virtual_clock() {
+    std::cout << "\n\n===== TEST 26: VIRTUAL CLOCK =====\n";
+    bool ok = true;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> names = {"vclock_qubit1", "vclock_qubit2", "vclock_relax", "vclock_dephase"};
+    {
+        // TEST 4 without the sleeps: the timeout is exact to the millisecond
+        VirtualQubit q(names[0], 1, 500);
+        q.initSuperposition();
+        VirtualClock::advance(300);
+        bool early = q.isMeasured();
+        VirtualClock::advance(200);
+        bool at_timeout = q.isMeasured();
+        VirtualClock::advance(1);
+        std::cout << "500 ms timeout: at 300 ms " << (early ? "collapsed" : "superposition") << ", at 500 ms "
+                  << (at_timeout ? "collapsed" : "superposition") << ", at 501 ms "
+                  << (q.isMeasured() ? "collapsed" : "superposition") << "\n";
+        ok &= !early && !at_timeout && q.isMeasured();
+
+        // A gate restarts the timeout; a collapse reaches the linked qubit
+        VirtualQubit p(names[1], 1, 100000);
+        q.initSuperposition();
+        p.initSuperposition();
+        q.entangle({names[1]});
+        VirtualClock::advance(400);
+        q.applyGate('H');
+        VirtualClock::advance(400);
+        bool reset = !q.isMeasured();
+        VirtualClock::advance(101);
+        std::cout << "Gate at 400 ms, then 400 ms more: " << (reset ? "superposition" : "collapsed")
+                  << "; 101 ms later q collapsed to " << int(q.getMeasurement()) << ", linked p to "
+                  << int(p.getMeasurement()) << "\n";
+        ok &= reset && q.isMeasured() && p.isMeasured() && p.getMeasurement() == q.getMeasurement();
+    }
+    {
+        // T1 = 100 ms: the closed-form channel, read as often as we like
+        VirtualQubit r(names[2], 1, Relaxation{100.0, 0.0});
+        r.setState(0.0, 0.0, 1.0, 0.0);
+        double before = r.probabilityOne();
+        VirtualClock::advance(100);
+        double one_t1 = r.probabilityOne();
+        bool stable = r.probabilityOne() == one_t1 && r.readState().rho11 == one_t1;
+        VirtualClock::advance(1900);
+        double after = r.probabilityOne();
+        std::cout << "T1 = 100 ms, |1>: P(1) " << before << ", after 100 ms " << one_t1 << ", after 2 s "
+                  << after << "\n";
+        ok &= before == 1.0 && std::fabs(one_t1 - std::exp(-1.0)) < 1e-12 && stable &&
+              std::fabs(after - std::exp(-20.0)) < 1e-15;
+
+        // T2 = 100 ms on |+>: <X> decays by e^-1, and H turns that into P(1)
+        VirtualQubit d(names[3], 1, Relaxation{0.0, 100.0});
+        d.initSuperposition();
+        VirtualClock::advance(100);
+        double x = d.expectation(PAULI_X);
+        d.applyGate('H');
+        double p1 = d.probabilityOne();
+        std::cout << "T2 = 100 ms, |+> after 100 ms: <X> " << x << ", P(1) after H " << p1 << "\n";
+        ok &= std::fabs(x - std::exp(-1.0)) < 1e-12 && std::fabs(p1 - 0.5 * (1.0 - std::exp(-1.0))) < 1e-12;
+    }
+    for (const auto& name : names) unlink_shm(name);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "3.5 s of virtual time took " << std::fixed << std::setprecision(1) << ms << " ms\n";
+    ok &= ms < 100;
+
+    // The real clocks agree with steady_clock
+    uint64_t steady = SteadyClock::nowMs();
+    int64_t coarse = int64_t(CoarseClock::nowMs()) - int64_t(steady);
+    int64_t tsc = int64_t(TscClock::nowMs()) - int64_t(SteadyClock::nowMs());
+    std::cout << "Coarse clock off by " << coarse << " ms, TSC clock by " << tsc << " ms\n";
+    ok &= std::abs(coarse) <= 20 && std::abs(tsc) <= 2;  // coarse lags by up to a tick or two
+
+    if (ok) {
+        std::cout << "SUCCESS: Decoherence follows the virtual clock\n";
+    } else {
+        std::cout << "ERROR: Virtual clock decoherence is wrong!\n";
+    }
+    std::cout << "TEST 26 COMPLETE\n";
+}
+
+void test_decoherence_deadlines() {
+    std::cout << "\n\n===== TEST 27: DEADLINE DECOHERENCE WAKEUPS =====\n";
+    bool ok = true;
+    std::string name = "deadline_qubit";
+    {
+        // Bounds leave room for a loaded machine: gates may run late by up
+        // to the timeout, and the collapse by 200 ms. A 100 ms poll is told
+        // apart by its wakeup counts, not by timing.
+        Qubit q(name, 1, 400);
+        const ThreadDecoherence& d = q.decoherencePolicy();
+
+        // Kept busy past two timeouts: the thread wakes about once per timeout
+        q.initSuperposition();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 80; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            start = std::chrono::steady_clock::now();  // before the gate that sets the deadline
+            q.applyGate('Z');
+        }
+        uint64_t busy = d.wakeups.load();
+        std::cout << "800 ms of gates every 10 ms (400 ms timeout): " << (q.isMeasured() ? "collapsed" : "superposition")
+                  << ", " << busy << " wakeups\n";
+        ok &= !q.isMeasured() && busy <= 6;
+
+        // Left alone: collapses at the deadline, never before it
+        while (!q.isMeasured() && std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        double late_us = d.late_max_ns.load() / 1e3;
+        std::cout << "Collapsed " << std::fixed << std::setprecision(1) << ms << " ms after the last gate; "
+                  << "worst wakeup " << late_us << " us past its deadline\n";
+        ok &= q.isMeasured() && ms >= 399 && ms < 600;
+
+        // Collapsed: no wakeups at all, until a new superposition arms it
+        uint64_t idle_from = d.wakeups.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        uint64_t idle = d.wakeups.load() - idle_from;
+        q.initSuperposition();
+        std::this_thread::sleep_for(std::chrono::milliseconds(800));
+        std::cout << "Idle for 300 ms: " << idle << " wakeups; re-armed, then "
+                  << (q.isMeasured() ? "collapsed" : "superposition") << " 800 ms later\n";
+        ok &= idle == 0 && q.isMeasured();
+    }
+    {
+        // A relaxing qubit has no worker: its gates never notify one
+        Qubit r(name, 2, Relaxation{1e6, 1e6});
+        r.initSuperposition();
+        for (int i = 0; i < 1000; i++) r.applyGate('Z');
+        uint64_t rearms = r.decoherencePolicy().rearms.load();
+        std::cout << "1000 gates on a relaxing qubit: " << rearms << " worker notifications\n";
+        ok &= rearms == 0;
+    }
+    unlink_shm(name);
+
+    if (ok) {
+        std::cout << "SUCCESS: Decoherence wakes at deadlines only\n";
+    } else {
+        std::cout << "ERROR: Decoherence wakeups are wrong!\n";
+    }
+    std::cout << "TEST 27 COMPLETE\n";
+}
+
+static bool segmentExists(const std::string& name) {
+    int fd = shm_open(qubitShmName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    close(fd);
+    return true;
+}
+
+void test_reaper() {
+    std::cout << "\n\n===== TEST 28: ORPHANED SEGMENT REAPER =====\n";
+    bool ok = true;
+
+    // A client that exits without unlinking anything. It also opens a qubit
+    // this process holds, becoming its owner.
+    Qubit shared("reap_shared", 10);
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0) {
+        Qubit a("reap_dead_a", 7);
+        Qubit b("reap_dead_b", 8);
+        Qubit s("reap_shared", 10);
+        QubitSoaArena arena("reap_dead_arena", 7, 1024);
+        a.initSuperposition();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    // A file of a qubit's size that no qubit set up
+    int fd = shm_open(qubitShmName("reap_foreign").c_str(), O_RDWR | O_CREAT, 0666);
+    ok &= fd >= 0 && ftruncate(fd, sizeof(QubitState)) == 0;
+    close(fd);
+
+    // A live owner, and a segment whose owner pid was reused by this process
+    Qubit live("reap_live", 7);
+    {
+        Qubit reused("reap_reused", 8);
+    }
+    fd = shm_open(qubitShmName("reap_reused").c_str(), O_RDWR, 0);
+    void* p = mmap(nullptr, sizeof(QubitState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    static_cast<QubitState*>(p)->owner_start += 1;
+    munmap(p, sizeof(QubitState));
+
+    ReapOptions opts;
+    opts.prefix = "reap_";
+    opts.dry_run = true;
+    ReapReport dry = reapSegments(opts);
+    std::cout << "Dry run: " << dry.reaped << " of " << dry.scanned << " segments orphaned, "
+              << dry.unverified << " unverified\n";
+    // Where some process's maps are unreadable (e.g. pid 1 in a container),
+    // every dead-owner segment is kept until an age limit is given
+    ok &= dry.scanned == 6 && segmentExists("reap_dead_a") &&
+          ((dry.reaped == 4 && dry.unverified == 0) || (dry.reaped == 0 && dry.unverified == 4));
+
+    opts.min_age_ms = 60000;
+    ok &= reapSegments(opts).reaped == 0;
+
+    opts.dry_run = false;
+    opts.min_age_ms = dry.unverified ? 1 : 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ReapReport dead = reapSegments(opts);
+    std::sort(dead.names.begin(), dead.names.end());
+    std::cout << "Reaped " << dead.reaped << " (" << dead.bytes / 1024 << " KB):";
+    for (const auto& n : dead.names) std::cout << " " << n;
+    std::cout << "\n";
+    ok &= dead.reaped == 4 && dead.bytes >= 4 * 4096 && dead.names[0] == "reap_dead_a" &&
+          dead.names[3] == "reap_reused" && !segmentExists("reap_dead_arena") && segmentExists("reap_live");
+    ok &= reapSegments(opts).reaped == 0;
+    bool kept = segmentExists("reap_shared") && segmentExists("reap_foreign");
+    std::cout << "Kept the qubit still mapped here after its last opener exited, and the foreign file: "
+              << (kept ? "yes" : "no") << "\n";
+    ok &= kept;
+
+    // Bulk removal by task and by prefix, live owners included
+    Qubit batch0("reap_batch_0", 9), batch1("reap_batch_1", 9);
+    opts.dead_owner = false;
+    opts.min_age_ms = 0;
+    opts.task_id = 7;
+    ReapReport task = reapSegments(opts);
+    opts.task_id = REAP_ANY_TASK;
+    opts.prefix = "reap_batch_";
+    ReapReport batch = reapSegments(opts);
+    std::cout << "Task 7: " << task.reaped << " reaped; prefix reap_batch_: " << batch.reaped << " reaped\n";
+    ok &= task.reaped == 1 && batch.reaped == 2 && !segmentExists("reap_live") && !segmentExists("reap_batch_1");
+    unlink_shm("reap_shared");
+    unlink_shm("reap_foreign");
+
+    if (ok) {
+        std::cout << "SUCCESS: Orphaned segments were reaped in bulk\n";
+    } else {
+        std::cout << "ERROR: Reaper picked the wrong segments!\n";
+    }
+    std::cout << "TEST 28 COMPLETE\n";
+}
+
+// ========================
+// TEST HARNESS
+// ========================
+//
+// Each test runs in a forked child under its own QUBIT_SHM_PREFIX, so tests
+// that reuse names such as bell_qubit1 can run side by side. The parent
+// replays each child's output in suite order as it finishes, then prints
+// how long every test took. A test fails if it prints ERROR or does not
+// exit cleanly.
+//
+//   qubit_test                   every test at once
+//   qubit_test -j 4 -r 20 bell   tests whose names contain "bell", 20 runs
+//                                each, at most 4 at a time
+//   qubit_test -s                serially in this process, unprefixed
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+static const std::vector<TestCase>& allTests() {
+    static const std::vector<TestCase> tests = {
+        {"single_qubit", test_single_qubit},
+        {"bell_state", test_bell_state},
+        {"ghz_state", test_ghz_state},
+        {"decoherence", test_decoherence},
+        {"advanced_entanglement", test_advanced_entanglement},
+        {"stats", test_stats},
+        {"trace_ring", test_trace_ring},
+        {"circuit", test_circuit},
+        {"circuit_optimizer", test_circuit_optimizer},
+        {"relaxation", test_relaxation},
+        {"trajectories", test_trajectories},
+        {"snapshot", test_snapshot},
+        {"arena_backing", test_arena_backing},
+        {"numa_arena", test_numa_arena},
+#ifdef QUBIT_HAS_ASYNC
+        {"async", test_async},
+#endif
+        {"bridge", test_bridge},
+        {"server", test_server},
+        {"arena_batch", test_arena_batch},
+        {"soa_arena", test_soa_arena},
+        {"bulk_measure", test_bulk_measure},
+        {"normalize", test_normalize},
+        {"float_arena", test_float_arena},
+        {"qubit_policies", test_qubit_policies},
+        {"gate_algebra", test_gate_algebra},
+        {"pauli_expectation", test_pauli_expectation},
+        {"virtual_clock", test_virtual_clock},
+        {"decoherence_deadlines", test_decoherence_deadlines},
+        {"reaper", test_reaper},
+    };
+    return tests;
+}
+
+struct TestJob {
+    const TestCase* test;
+    int         run;            // repetition, from 0
+    std::string prefix;         // QUBIT_SHM_PREFIX of the child
+    pid_t       pid = -1;
+    int         out = -1;       // memfd with the child's stdout and stderr
+    bool        done = false;
+    bool        passed = false;
+    bool        timed_out = false;  // killed at its deadline
+    double      ms = 0;
+    size_t      leaked = 0;     // segments the test left under its prefix
+    std::chrono::steady_clock::time_point start;
+};
+
+// Unlink every /dev/shm entry under `prefix`; returns how many there were,
+// not counting the stats page every process keeps
+static size_t unlinkPrefixed(const std::string& prefix) {
+    size_t n = 0;
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return 0;
+    std::string stats = prefix + statsShmName();
+    while (struct dirent* e = readdir(dir))
+        if (strncmp(e->d_name, prefix.c_str(), prefix.size()) == 0 && shm_unlink(e->d_name) == 0)
+            n += stats != e->d_name;
+    closedir(dir);
+    return n;
+}
+
+static void startJob(TestJob& job) {
+    job.out = memfd_create(job.prefix.c_str(), 0);
+    if (job.out < 0) { perror("memfd_create"); exit(1); }
+    std::cout.flush();
+    job.start = std::chrono::steady_clock::now();
+    job.pid = fork();
+    if (job.pid < 0) { perror("fork"); exit(1); }
+    if (job.pid == 0) {
+        setenv("QUBIT_SHM_PREFIX", job.prefix.c_str(), 1);
+        dup2(job.out, STDOUT_FILENO);
+        dup2(job.out, STDERR_FILENO);
+        job.test->run();
+        std::cout.flush();
+        fflush(nullptr);
+        _exit(0);
+    }
+}
+
+// Everything written to a memfd, then close it
+static std::string readOutput(int fd) {
+    std::string output;
+    char buf[65536];
+    ssize_t n;
+    for (off_t off = 0; (n = pread(fd, buf, sizeof(buf), off)) > 0; off += n) output.append(buf, n);
+    close(fd);
+    return output;
+}
+
+// Reap a finished child; returns what it printed
+static std::string finishJob(TestJob& job, int status) {
+    job.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.start).count();
+    job.done = true;
+    std::string output = readOutput(job.out);
+    job.passed = WIFEXITED(status) && WEXITSTATUS(status) == 0 && output.find("ERROR") == std::string::npos;
+    if (job.timed_out) output += "\nTimed out after " + std::to_string(int(job.ms / 1000)) + " s\n";
+    else if (WIFSIGNALED(status)) output += "\nKilled by signal " + std::to_string(WTERMSIG(status)) + "\n";
+    job.leaked = unlinkPrefixed(job.prefix);
+    return output;
+}
+
+// In this process, one test after another. Each test's output is captured
+// and checked for ERROR, as in runParallel, then printed. A stats page the
+// run created is removed afterwards.
+static int runSerial(const std::vector<const TestCase*>& tests) {
+    std::string stats = qubitShmName(statsShmName());
+    int stats_fd = shm_open(stats.c_str(), O_RDONLY, 0);
+    if (stats_fd >= 0) close(stats_fd);
+    std::vector<const char*> failed;
+    for (const TestCase* t : tests) {
+        int out = memfd_create(t->name, 0);
+        if (out < 0) { perror("memfd_create"); exit(1); }
+        std::cout.flush();
+        fflush(nullptr);
+        int saved_out = dup(STDOUT_FILENO), saved_err = dup(STDERR_FILENO);
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+        t->run();
+        std::cout.flush();
+        fflush(nullptr);
+        dup2(saved_out, STDOUT_FILENO);
+        dup2(saved_err, STDERR_FILENO);
+        close(saved_out);
+        close(saved_err);
+        std::string output = readOutput(out);
+        std::cout << output << std::flush;
+        if (output.find("ERROR") != std::string::npos) failed.push_back(t->name);
+    }
+    if (stats_fd < 0) shm_unlink(stats.c_str());
+    if (!failed.empty()) {
+        std::cout << "\n\n===== " << failed.size() << " OF " << tests.size() << " TESTS FAILED:";
+        for (const char* name : failed) std::cout << " " << name;
+        std::cout << " =====\n";
+        return 1;
+    }
+    std::cout << "\n\n===== ALL TESTS COMPLETED SUCCESSFULLY =====\n";
+    return 0;
+}
+
+// Each test in its own child process, `jobs` at a time (0 = all). A child
+// still running after `timeout_s` seconds (0 = no limit) is killed and
+// its test fails.
+static int runParallel(const std::vector<const TestCase*>& tests, size_t jobs, int repeat, int timeout_s) {
+    std::vector<TestJob> queue;
+    for (int r = 0; r < repeat; r++) {
+        for (const TestCase* t : tests) {
+            TestJob job;
+            job.test = t;
+            job.run = r;
+            job.prefix = "qt" + std::to_string(getpid()) + "_" + std::to_string(queue.size()) + "_";
+            queue.push_back(job);
+        }
+    }
+    if (jobs == 0) jobs = queue.size();
+
+    auto wall = std::chrono::steady_clock::now();
+    size_t next = 0, running = 0, shown = 0;
+    std::vector<std::string> replay(queue.size());
+    while (shown < queue.size()) {
+        while (running < jobs && next < queue.size()) {
+            startJob(queue[next++]);
+            running++;
+        }
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, timeout_s > 0 ? WNOHANG : 0);
+        if (pid < 0) { perror("waitpid"); return 1; }
+        if (pid == 0) {
+            auto now = std::chrono::steady_clock::now();
+            for (TestJob& job : queue) {
+                if (job.pid <= 0 || job.done || job.timed_out) continue;
+                if (now - job.start < std::chrono::seconds(timeout_s)) continue;
+                kill(job.pid, SIGKILL);  // reaped by a later waitpid
+                job.timed_out = true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        for (size_t k = 0; k < queue.size(); ++k) {
+            if (queue[k].pid != pid || queue[k].done) continue;
+            replay[k] = finishJob(queue[k], status);  // printed once every earlier job has
+            running--;
+        }
+        for (; shown < queue.size() && queue[shown].done; shown++) std::cout << replay[shown] << std::flush;
+    }
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall).count();
+
+    std::cout << "\n\n===== TEST TIMES =====\n";
+    double total_ms = 0, slowest = 0;
+    size_t failed = 0;
+    for (const TestJob& job : queue) {
+        total_ms += job.ms;
+        slowest = std::max(slowest, job.ms);
+        failed += !job.passed;
+        std::cout << std::left << std::setw(24) << job.test->name << std::right;
+        if (repeat > 1) std::cout << " #" << std::setw(3) << std::left << job.run << std::right;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(10) << job.ms << " ms  "
+                  << (job.passed ? "ok" : job.timed_out ? "FAILED (timeout)" : "FAILED");
+        if (job.leaked) std::cout << "  (left " << job.leaked << " segments)";
+        std::cout << "\n";
+    }
+    std::cout << queue.size() << " runs in " << wall_ms / 1000 << " s; slowest " << slowest / 1000
+              << " s, serial total " << total_ms / 1000 << " s\n";
+    if (failed) {
+        std::cout << "\n\n===== " << failed << " OF " << queue.size() << " TEST RUNS FAILED =====\n";
+        return 1;
+    }
+    std::cout << "\n\n===== ALL TESTS COMPLETED SUCCESSFULLY =====\n";
+    return 0;
+}
+
+static void usage() {
+    std::cerr << "usage: qubit_test [-s] [-j jobs] [-r repeat] [-t timeout_s] [name ...]\n";
+}
+
+int main(int argc, char** argv) {
+    bool serial = false;
+    size_t jobs = 0;  // 0: all at once
+    int repeat = 1;
+    int timeout_s = 120;  // per test run, 0: none
+    std::vector<std::string> filters;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-s") serial = true;
+        else if (arg == "-j" && i + 1 < argc) jobs = size_t(std::atoi(argv[++i]));
+        else if (arg == "-r" && i + 1 < argc) repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-t" && i + 1 < argc) timeout_s = std::max(0, std::atoi(argv[++i]));
+        else if (arg[0] == '-') { usage(); return 1; }
+        else filters.push_back(arg);
+    }
+    std::vector<const TestCase*> tests;
+    for (const TestCase& t : allTests()) {
+        bool match = filters.empty();
+        for (const std::string& f : filters) match |= std::string(t.name).find(f) != std::string::npos;
+        if (match) tests.push_back(&t);
+    }
+    if (tests.empty()) { usage(); return 1; }
+
+    setenv("QUBIT_STATS", "1", 0);  // test_stats reads the page
+    std::cout << "===== QUANTUM QUBIT SYSTEM TEST SUITE =====\n";
+    std::cout << "Testing all features of the quantum-inspired qubit implementation\n";
+    return serial ? runSerial(tests) : runParallel(tests, jobs, repeat, timeout_s);
+}
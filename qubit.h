@@ -0,0 +1,956 @@
+#pragma once
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <iomanip>
+
+#include "qubit_stats.h"
+#include "qubit_trace.h"
+#include "qubit_probes.h"
+#include "qubit_remote.h"
+#include "qubit_gates.h"
+#include "qubit_clock.h"
+
+const uint32_t QUBIT_STATE_MAGIC   = 0x51535445;  // "QSTE"
+const uint32_t QUBIT_STATE_VERSION = 1;
+
+struct QubitState {
+    double alpha_real;
+    double alpha_imag;
+    double beta_real;
+    double beta_imag;
+    uint8_t measured;
+    char links[4][64];       // names of up to 4 shared-memory peers
+    uint32_t link_count;
+    uint32_t task_id;
+    uint64_t created_at;
+    uint64_t decohere_timeout_ms;
+    double   t1_ms;          // amplitude damping time, 0 = off
+    double   t2_ms;          // dephasing time, 0 = off
+    uint64_t relaxed_at_ns;  // when T1/T2 were last applied
+    double   rho11;          // with T1/T2: density matrix at relaxed_at_ns,
+    double   rho01_re;       // rho00 = 1 - rho11 and rho10 = conj(rho01)
+    double   rho01_im;
+    uint32_t owner_pid;      // last process to open the segment, 0 = none
+    uint64_t owner_start;    // its processStartTime()
+    uint64_t owner_since_ms; // steady-clock ms when it opened the segment
+    uint32_t magic;          // QUBIT_STATE_MAGIC once a qubit has set it up
+    uint32_t version;        // QUBIT_STATE_VERSION
+};
+
+// Per-qubit T1/T2 times. A qubit constructed with these relaxes lazily in
+// closed form whenever it is touched instead of collapsing on a timeout.
+struct Relaxation {
+    double t1_ms;
+    double t2_ms;
+};
+
+// Apply basic gate H, X, Z, S or T to amplitudes of any precision; false
+// for an unknown gate
+template <typename T>
+inline bool applyGateToAmplitudes(T& alpha_re, T& alpha_im, T& beta_re, T& beta_im, char gate) {
+    const T sqrt2 = T(M_SQRT2);
+    T ar = alpha_re, ai = alpha_im;
+    T br = beta_re,  bi = beta_im;
+    switch (gate) {
+        case 'H': // Hadamard
+            alpha_re = (ar + br) / sqrt2;
+            alpha_im = (ai + bi) / sqrt2;
+            beta_re  = (ar - br) / sqrt2;
+            beta_im  = (ai - bi) / sqrt2;
+            return true;
+        case 'X': // Pauli-X
+            alpha_re = br;
+            alpha_im = bi;
+            beta_re  = ar;
+            beta_im  = ai;
+            return true;
+        case 'Z': // Pauli-Z
+            beta_re  = -br;
+            beta_im  = -bi;
+            return true;
+        case 'S': // Phase, sqrt(Z)
+            beta_re  = -bi;
+            beta_im  = br;
+            return true;
+        case 'T': // pi/8, sqrt(S)
+            beta_re  = (br - bi) / sqrt2;
+            beta_im  = (br + bi) / sqrt2;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Apply basic gate H, X, Z, S or T to raw amplitudes; false for an unknown gate
+inline bool applyGateToState(QubitState& s, char gate) {
+    return applyGateToAmplitudes(s.alpha_real, s.alpha_imag, s.beta_real, s.beta_imag, gate);
+}
+
+// Record a measurement result and collapse the amplitudes onto it
+inline void collapseState(QubitState& s, uint8_t result) {
+    s.measured = result;
+    if (result == 0) {
+        s.alpha_real = 1.0; s.alpha_imag = 0.0;
+        s.beta_real  = 0.0; s.beta_imag  = 0.0;
+    } else {
+        s.alpha_real = 0.0; s.alpha_imag = 0.0;
+        s.beta_real  = 1.0; s.beta_imag  = 0.0;
+    }
+}
+
+// Apply `dt_ms` of T1/T2 relaxation to an unmeasured pure state as one
+// quantum trajectory step, for the Monte-Carlo runner (trajectory.h): amplitude damping decays |1> to |0> with probability
+// (1 - e^(-dt/T1))|beta|^2 and otherwise shrinks beta by e^(-dt/2T1);
+// pure dephasing (1/Tphi = 1/T2 - 1/2T1) flips the phase of |1> with
+// probability (1 - e^(-dt/Tphi))/2. Averaged over trajectories this is the
+// exact T1/T2 channel, so measurement statistics match the density matrix.
+template <class Rng>
+void relaxState(QubitState& s, double dt_ms, Rng& rng) {
+    if (s.measured != 2 || dt_ms <= 0) return;
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    if (s.t1_ms > 0) {
+        double gamma = 1.0 - std::exp(-dt_ms / s.t1_ms);
+        double p1 = s.beta_real * s.beta_real + s.beta_imag * s.beta_imag;
+        if (uniform(rng) < gamma * p1) {
+            s.alpha_real = 1.0; s.alpha_imag = 0.0;
+            s.beta_real  = 0.0; s.beta_imag  = 0.0;
+            return;
+        }
+        double keep = std::sqrt(1.0 - gamma);
+        s.beta_real *= keep;
+        s.beta_imag *= keep;
+        double n = std::sqrt(1.0 - gamma * p1);
+        s.alpha_real /= n; s.alpha_imag /= n;
+        s.beta_real  /= n; s.beta_imag  /= n;
+    }
+    if (s.t2_ms > 0) {
+        double rate = 1.0 / s.t2_ms - (s.t1_ms > 0 ? 0.5 / s.t1_ms : 0.0);
+        if (rate > 0 && uniform(rng) < 0.5 * (1.0 - std::exp(-dt_ms * rate))) {
+            s.beta_real = -s.beta_real;
+            s.beta_imag = -s.beta_imag;
+        }
+    }
+}
+
+// Qubits with T1/T2 times keep a density matrix, since relaxation leaves
+// them in a mixed state. The amplitudes then hold the pure state with the
+// same populations and coherence phase, which is the state itself while it
+// is pure.
+
+inline bool relaxing(const QubitState& s) { return s.t1_ms > 0 || s.t2_ms > 0; }
+
+inline void densityFromAmplitudes(QubitState& s) {
+    s.rho11 = s.beta_real * s.beta_real + s.beta_imag * s.beta_imag;
+    s.rho01_re = s.alpha_real * s.beta_real + s.alpha_imag * s.beta_imag;  // alpha conj(beta)
+    s.rho01_im = s.alpha_imag * s.beta_real - s.alpha_real * s.beta_imag;
+}
+
+inline void amplitudesFromDensity(QubitState& s) {
+    double p1 = std::min(std::max(s.rho11, 0.0), 1.0);
+    double c = std::sqrt(s.rho01_re * s.rho01_re + s.rho01_im * s.rho01_im);
+    double b = std::sqrt(p1);
+    s.alpha_real = std::sqrt(1.0 - p1);
+    s.alpha_imag = 0.0;
+    s.beta_real = c > 0 ? b * s.rho01_re / c : b;
+    s.beta_imag = c > 0 ? -b * s.rho01_im / c : 0.0;
+}
+
+// The T1/T2 channel over `dt_ms`, in closed form: the |1> population decays
+// by e^(-dt/T1), the coherence by e^(-dt/T2), or by e^(-dt/2T1) when T2 is
+// off or longer than 2 T1
+inline void relaxDensity(QubitState& s, double dt_ms) {
+    if (s.measured != 2 || dt_ms <= 0) return;
+    double rate = 0.0;
+    if (s.t1_ms > 0) {
+        s.rho11 *= std::exp(-dt_ms / s.t1_ms);
+        rate = 0.5 / s.t1_ms;
+    }
+    if (s.t2_ms > 0) rate = std::max(rate, 1.0 / s.t2_ms);
+    double keep = std::exp(-dt_ms * rate);
+    s.rho01_re *= keep;
+    s.rho01_im *= keep;
+}
+
+// rho <- U rho U^dagger, where apply(ar, ai, br, bi) maps a column through U.
+// rho is Hermitian, so this is U (U rho)^dagger: U applied to four columns.
+template <class Apply>
+inline bool applyToDensity(QubitState& s, Apply apply) {
+    double c0[4] = {1.0 - s.rho11, 0.0, s.rho01_re, -s.rho01_im};
+    double c1[4] = {s.rho01_re, s.rho01_im, s.rho11, 0.0};
+    if (!apply(c0[0], c0[1], c0[2], c0[3])) return false;
+    apply(c1[0], c1[1], c1[2], c1[3]);
+    double d1[4] = {c0[2], -c0[3], c1[2], -c1[3]};  // second column of (U rho)^dagger
+    apply(d1[0], d1[1], d1[2], d1[3]);
+    s.rho11 = d1[2];
+    s.rho01_re = d1[0];
+    s.rho01_im = d1[1];
+    return true;
+}
+
+// |alpha|^2 + |beta|^2 may differ from 1 by `tolerance`. Bulk validation
+// (normalizeStates() on the arenas) only reports states beyond it, or
+// also rescales them.
+enum NormAction : uint8_t { NORM_REPORT, NORM_RENORMALIZE };
+
+struct NormPolicy {
+    double     tolerance = 1e-9;
+    NormAction action = NORM_RENORMALIZE;
+};
+
+struct NormReport {
+    size_t checked = 0;           // unmeasured states looked at
+    size_t out_of_tolerance = 0;  // beyond the tolerance, invalid ones included
+    size_t invalid = 0;           // zero, infinite or NaN norm; reset to |0> when renormalizing
+    double max_deviation = 0.0;   // largest finite | |alpha|^2 + |beta|^2 - 1 |
+
+    bool ok() const { return out_of_tolerance == 0; }
+    void add(const NormReport& o) {
+        checked += o.checked;
+        out_of_tolerance += o.out_of_tolerance;
+        invalid += o.invalid;
+        max_deviation = std::max(max_deviation, o.max_deviation);
+    }
+};
+
+inline double amplitudeNorm(double ar, double ai, double br, double bi) {
+    return ar * ar + ai * ai + br * br + bi * bi;
+}
+
+// Single-qubit Pauli operators
+enum Pauli : uint8_t { PAULI_I, PAULI_X, PAULI_Y, PAULI_Z };
+
+// <X>, <Y>, <Z> of (alpha, beta). A collapsed qubit (measured 0 or 1) is
+// taken to be in that basis state, whatever its amplitudes say.
+inline void pauliTriple(double ar, double ai, double br, double bi, uint8_t measured,
+                        double& x, double& y, double& z) {
+    if (measured != 2) {
+        x = y = 0.0;
+        z = measured ? -1.0 : 1.0;
+        return;
+    }
+    x = 2.0 * (ar * br + ai * bi);
+    y = 2.0 * (ar * bi - ai * br);
+    z = (ar * ar + ai * ai) - (br * br + bi * bi);
+}
+
+inline double pauliExpectation(const QubitState& s, Pauli p) {
+    double e[4] = {1.0, 0.0, 0.0, 0.0};
+    pauliTriple(s.alpha_real, s.alpha_imag, s.beta_real, s.beta_imag, s.measured, e[1], e[2], e[3]);
+    return e[p];
+}
+
+// <X>, <Y> or <Z> of an unmeasured qubit's density matrix
+inline double densityExpectation(const QubitState& s, Pauli p) {
+    switch (p) {
+        case PAULI_X: return 2.0 * s.rho01_re;
+        case PAULI_Y: return -2.0 * s.rho01_im;
+        case PAULI_Z: return 1.0 - 2.0 * s.rho11;
+        default:      return 1.0;
+    }
+}
+
+// A tensor product of single-qubit Paulis over a register, kept sparse:
+// identities are dropped and each qubit appears at most once. Registers
+// here hold independent qubits, so <P> is the product of the per-qubit
+// expectations.
+struct PauliString {
+    struct Term {
+        size_t qubit;
+        Pauli  op;
+    };
+    std::vector<Term> terms;
+
+    PauliString() {}
+
+    // One character per qubit from `first` on: "XIZ" is X on first, Z on first + 2
+    explicit PauliString(const std::string& ops, size_t first = 0) {
+        for (size_t k = 0; k < ops.size(); ++k) set(first + k, pauliFromChar(ops[k]));
+    }
+
+    // Set (or with PAULI_I clear) the operator on `qubit`
+    PauliString& set(size_t qubit, Pauli op) {
+        for (size_t k = 0; k < terms.size(); ++k) {
+            if (terms[k].qubit != qubit) continue;
+            if (op == PAULI_I) terms.erase(terms.begin() + k);
+            else terms[k].op = op;
+            return *this;
+        }
+        if (op != PAULI_I) terms.push_back(Term{qubit, op});
+        return *this;
+    }
+
+    static Pauli pauliFromChar(char c) {
+        switch (c) {
+            case 'X': return PAULI_X;
+            case 'Y': return PAULI_Y;
+            case 'Z': return PAULI_Z;
+            case 'I': return PAULI_I;
+            default:
+                std::cerr << "Unknown Pauli: " << c << std::endl;
+                return PAULI_I;
+        }
+    }
+};
+
+// |<a|b>|^2 of two single-qubit states
+inline double stateFidelity(const QubitState& a, const QubitState& b) {
+    double re = a.alpha_real * b.alpha_real + a.alpha_imag * b.alpha_imag +
+                a.beta_real * b.beta_real + a.beta_imag * b.beta_imag;
+    double im = a.alpha_real * b.alpha_imag - a.alpha_imag * b.alpha_real +
+                a.beta_real * b.beta_imag - a.beta_imag * b.beta_real;
+    return re * re + im * im;
+}
+
+inline bool finiteNorm(double n) { return n > 0.0 && n <= DBL_MAX; }
+
+// Scale amplitudes to unit norm; false (and untouched) for a zero or
+// non-finite norm
+inline bool normalizeAmplitudes(double& ar, double& ai, double& br, double& bi) {
+    double n = amplitudeNorm(ar, ai, br, bi);
+    if (!finiteNorm(n)) return false;
+    double scale = 1.0 / std::sqrt(n);
+    ar *= scale; ai *= scale;
+    br *= scale; bi *= scale;
+    return true;
+}
+
+// Eventfds (stored +1, 0 = free) written after every collapse in this
+// process, and when an awaited qubit lock is released, so reactors can wake
+// waiters without polling (qubit_async.h)
+const int COLLAPSE_LISTENER_SLOTS = 8;
+
+inline std::atomic<int>* collapseListeners() {
+    static std::atomic<int> fds[COLLAPSE_LISTENER_SLOTS];
+    return fds;
+}
+
+inline void notifyCollapse() {
+    std::atomic<int>* fds = collapseListeners();
+    for (int i = 0; i < COLLAPSE_LISTENER_SLOTS; ++i) {
+        int f = fds[i].load(std::memory_order_relaxed);
+        if (!f) continue;
+        uint64_t one = 1;
+        ssize_t n = write(f - 1, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+// Policies for BasicQubit. Qubit is the shared-memory, mutex-guarded
+// combination with a decoherence thread; the others let a simulation loop
+// drop what it does not need at compile time.
+
+// The QubitState lives in a POSIX shm segment named after the qubit, where
+// other processes and entangled peers can reach it
+struct ShmStorage {
+    QubitState* open(const std::string& name) {
+        fd = shm_open(qubitShmName(name).c_str(), O_RDWR | O_CREAT, 0666);
+        if (fd < 0) { perror("shm_open"); exit(1); }
+        ftruncate(fd, sizeof(QubitState));
+        ptr = mmap(nullptr, sizeof(QubitState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) { perror("mmap"); exit(1); }
+        return reinterpret_cast<QubitState*>(ptr);
+    }
+
+    void close() {
+        munmap(ptr, sizeof(QubitState));
+        ::close(fd);
+    }
+
+    int   fd = -1;
+    void* ptr = nullptr;
+};
+
+// The QubitState lives inside the object: no segment and no syscalls, but
+// invisible to other processes and to peers' collapse propagation
+struct LocalStorage {
+    QubitState* open(const std::string&) {
+        std::memset(&local, 0, sizeof(local));
+        return &local;
+    }
+
+    void close() {}
+
+    QubitState local;
+};
+
+// No locking, for qubits only one thread touches
+struct NullLock {
+    void lock() {}
+    void unlock() {}
+    bool try_lock() { return true; }
+};
+
+// Test-and-set spin lock, for short uncontended critical sections
+struct SpinLock {
+    void lock() {
+        while (flag.test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+    }
+    void unlock() { flag.clear(std::memory_order_release); }
+    bool try_lock() { return !flag.test_and_set(std::memory_order_acquire); }
+
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+// std::mutex that wakes the reactors on unlock while a measureAsync() waits
+// for it; otherwise unlock costs one relaxed load more
+struct NotifyingMutex {
+    void lock() { m.lock(); }
+    void unlock() {
+        m.unlock();
+        if (waiters.load(std::memory_order_relaxed)) notifyCollapse();
+    }
+    bool try_lock() { return m.try_lock(); }
+
+    std::mutex m;
+    std::atomic<uint32_t> waiters{0};  // suspended measureAsync() calls
+};
+
+// A thread per qubit sleeps until the qubit's decoherence deadline and
+// collapses it then; T1/T2 relaxation is applied lazily. A stamp that only
+// pushes the deadline later does not wake the thread, which re-reads the
+// deadline when it wakes. Only arming an idle (collapsed) qubit, or an
+// earlier deadline, wakes it. So a busy qubit pays one atomic load per gate,
+// and a collapsed one causes no wakeups at all. On VirtualClock the check
+// is handed to the clock instead, and advance() runs it.
+struct ThreadDecoherence {
+    static const bool enabled = true;
+    static const uint64_t IDLE = UINT64_MAX;
+
+    template <class Q>
+    void start(Q* q) {
+        typedef typename Q::clock_type Clock;
+        if (Clock::manual) {
+            watch_id = Clock::watch([q]() { q->decohereCheck(); });
+            unwatch = &Clock::unwatch;
+            return;
+        }
+        running = true;
+        worker = std::thread([this, q]() {
+            typedef std::chrono::steady_clock steady;
+            uint64_t last = 0;
+            std::unique_lock<std::mutex> lock(wake_mtx);
+            while (running) {
+                // Any stamp made while the check runs wakes us again
+                armed = IDLE;
+                rearmed = false;
+                lock.unlock();
+                uint64_t deadline = q->decohereCheck();  // Clock ms, 0 if nothing is pending
+                lock.lock();
+                if (rearmed || !running) continue;
+                if (!deadline) {
+                    wake.wait(lock, [this] { return rearmed || !running; });
+                } else {
+                    armed = deadline;
+                    // Real clocks share the steady epoch; one that lags it
+                    // (CoarseClock) is given another millisecond, not a spin
+                    steady::time_point at{std::chrono::milliseconds(deadline)};
+                    if (deadline == last) at = steady::now() + std::chrono::milliseconds(1);
+                    last = deadline;
+                    if (!wake.wait_until(lock, at, [this] { return rearmed || !running; })) {
+                        uint64_t late = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            steady::now() - at).count();
+                        timed_wakes++;
+                        late_sum_ns += late;
+                        if (late > late_max_ns) late_max_ns = late;
+                    }
+                }
+                wakeups++;
+            }
+        });
+    }
+
+    // A new decoherence deadline (Clock ms) was stamped. Without a worker,
+    // as for relaxing qubits or on VirtualClock, nothing is woken.
+    void rearm(uint64_t deadline) {
+        if (!running.load(std::memory_order_relaxed) || deadline >= armed.load(std::memory_order_relaxed))
+            return;
+        std::lock_guard<std::mutex> lock(wake_mtx);
+        rearmed = true;
+        rearms++;
+        wake.notify_one();
+    }
+
+    void stop() {
+        if (unwatch) unwatch(watch_id);
+        unwatch = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(wake_mtx);
+            running = false;
+        }
+        wake.notify_one();
+        if (worker.joinable()) worker.join();
+    }
+
+    std::thread             worker;
+    std::atomic<bool>       running{false};
+    std::mutex              wake_mtx;
+    std::condition_variable wake;
+    bool                    rearmed = false;
+    std::atomic<uint64_t>   armed{IDLE};  // deadline being slept to
+    uint64_t                watch_id = 0;
+    void                  (*unwatch)(uint64_t) = nullptr;
+
+    // Wakeup accounting; late_* is how far past the deadline timed wakes ran
+    std::atomic<uint64_t>   rearms{0};    // stamps that notified the worker
+    std::atomic<uint64_t>   wakeups{0};
+    std::atomic<uint64_t>   timed_wakes{0};
+    std::atomic<uint64_t>   late_sum_ns{0};
+    std::atomic<uint64_t>   late_max_ns{0};
+};
+
+// Amplitudes never decay and no timestamps are kept
+struct NoDecoherence {
+    static const bool enabled = false;
+
+    template <class Q>
+    void start(Q*) {}
+    void rearm(uint64_t) {}
+    void stop() {}
+};
+
+class QubitReactor;
+struct MeasureAwaitable;
+struct CollapseAwaitable;
+
+// Timer is OpTimer to record per-operation latency stats, or NullTimer.
+// Clock stamps decoherence and relaxation times (qubit_clock.h).
+template <class Storage, class Lock, class Decoherence, uint32_t MaxLinks, class Timer = OpTimer,
+          class Clock = SteadyClock>
+class BasicQubit {
+    static_assert(MaxLinks <= 4, "QubitState holds at most 4 links");
+
+public:
+    typedef Clock clock_type;
+
+    BasicQubit(const std::string &name, uint32_t taskId, uint64_t decohereTimeoutMs = 5000)
+        : shm_name(name), task_id(taskId), decohere_timeout(decohereTimeoutMs),
+          trace_id(traceId(name.c_str())) {
+        QubitTrace::initFromEnv();
+        QubitTrace::registerName(trace_id, shm_name);
+        state = storage.open(shm_name);
+        initHeader();
+        decoherence.start(this);
+    }
+
+    // Qubit with T1/T2 relaxation applied lazily; no decoherence thread runs
+    BasicQubit(const std::string &name, uint32_t taskId, Relaxation relaxation)
+        : shm_name(name), task_id(taskId), decohere_timeout(0),
+          trace_id(traceId(name.c_str())) {
+        static_assert(Decoherence::enabled, "relaxation needs a decoherence policy");
+        QubitTrace::initFromEnv();
+        QubitTrace::registerName(trace_id, shm_name);
+        state = storage.open(shm_name);
+        initHeader();
+        std::lock_guard<Lock> lock(mtx);
+        state->t1_ms = relaxation.t1_ms;
+        state->t2_ms = relaxation.t2_ms;
+        state->relaxed_at_ns = Clock::nowNs();
+        densityFromAmplitudes(*state);
+    }
+
+    ~BasicQubit() {
+        decoherence.stop();
+        storage.close();
+    }
+
+    // Initialize equal superposition state
+    void initSuperposition() {
+        std::lock_guard<Lock> lock(mtx);
+        setStateLocked(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+        resetLinks();
+        updateTimestamp();
+    }
+
+    // Measure qubit: collapse probabilistically
+    uint8_t measure() {
+        Timer timer(OP_MEASURE);
+        std::lock_guard<Lock> lock(mtx);
+        uint8_t result;
+        if (measureLocked(result, timer)) updateTimestamp();
+        return result;
+    }
+
+    // Measure only if the lock is free right now; false (nothing done) if busy
+    bool tryMeasure(uint8_t& result) {
+        Timer timer(OP_MEASURE);
+        std::unique_lock<Lock> lock(mtx, std::try_to_lock);
+        if (!lock.owns_lock()) return false;
+        if (measureLocked(result, timer)) updateTimestamp();
+        return true;
+    }
+
+#if defined(__cpp_impl_coroutine)
+    // Awaitable measure() and collapse wait, for Qubit only: the reactor
+    // watches shm segments. Defined in qubit_async.h.
+    static constexpr bool awaitable =
+        std::is_same<BasicQubit, BasicQubit<ShmStorage, NotifyingMutex, ThreadDecoherence, 4>>::value;
+    MeasureAwaitable measureAsync() requires awaitable;
+    MeasureAwaitable measureAsync(QubitReactor& reactor) requires awaitable;
+    CollapseAwaitable collapsed() requires awaitable;
+    CollapseAwaitable collapsed(QubitReactor& reactor) requires awaitable;
+#endif
+
+    // Apply basic gate: H, X, Z, S, T
+    void applyGate(char gate) {
+        Timer timer(OP_APPLY_GATE);
+        std::lock_guard<Lock> lock(mtx);
+        if (applyGateLocked(gate, timer)) updateTimestamp();
+    }
+
+    // Apply a 2x2 unitary as one operation (see qubit_gates.h)
+    void applyUnitary(const GateMatrix& u) {
+        Timer timer(OP_APPLY_GATE);
+        std::lock_guard<Lock> lock(mtx);
+        if (applyUnitaryLocked(u, timer)) updateTimestamp();
+    }
+
+    // Apply a gate type or gates::Seq<...>, multiplied out at compile time
+    template <class G>
+    void apply() {
+        constexpr GateMatrix u = gateMatrix<G>();
+        applyUnitary(u);
+    }
+
+    // Entangle with up to MaxLinks other qubits by name
+    void entangle(const std::vector<std::string>& peers) {
+        std::lock_guard<Lock> lock(mtx);
+        entangleLocked(peers);
+    }
+
+    // Set custom state amplitudes
+    void setState(double ar, double ai, double br, double bi) {
+        std::lock_guard<Lock> lock(mtx);
+        setStateLocked(ar, ai, br, bi);
+        updateTimestamp();
+    }
+
+    // setState() scaled to unit norm; false (state unchanged) if the
+    // amplitudes are all zero or not finite
+    bool setStateNormalized(double ar, double ai, double br, double bi) {
+        if (!normalizeAmplitudes(ar, ai, br, bi)) return false;
+        setState(ar, ai, br, bi);
+        return true;
+    }
+
+    // Get shared memory name
+    const std::string& name() const { return shm_name; }
+
+    // Get current state information
+    void printState() const {
+        std::lock_guard<Lock> lock(mtx);
+        QubitState s = relaxedState();
+        std::cout << "Qubit '" << shm_name << "': ";
+        if (s.measured == 2) {
+            std::cout << "|ψ> = ";
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << "(" << s.alpha_real << (s.alpha_imag >= 0 ? "+" : "") 
+                      << s.alpha_imag << "i)|0> + ";
+            std::cout << "(" << s.beta_real << (s.beta_imag >= 0 ? "+" : "") 
+                      << s.beta_imag << "i)|1>";
+        } else {
+            std::cout << "Collapsed to |" << (int)s.measured << ">";
+        }
+        std::cout << "\nLinks: " << s.link_count;
+        for (uint32_t i = 0; i < s.link_count; ++i) {
+            std::cout << " " << s.links[i];
+        }
+        if (relaxing(s)) {
+            std::cout << "\nRelaxation: T1 " << s.t1_ms << "ms, T2 " << s.t2_ms << "ms";
+            if (s.measured == 2)
+                std::cout << "; rho11 " << s.rho11 << ", |rho01| " << std::hypot(s.rho01_re, s.rho01_im);
+            std::cout << std::endl;
+        } else {
+            std::cout << "\nDecoherence: " << s.decohere_timeout_ms << "ms" << std::endl;
+        }
+    }
+
+    // Copy of the raw shared state, with any pending relaxation applied to
+    // the copy
+    QubitState readState() const {
+        std::lock_guard<Lock> lock(mtx);
+        return relaxedState();
+    }
+
+    // Probability of measuring |1> right now
+    double probabilityOne() const {
+        std::lock_guard<Lock> lock(mtx);
+        QubitState s = relaxedState();
+        if (s.measured != 2) return s.measured;
+        return norm(s.beta_real, s.beta_imag);
+    }
+
+    // <X>, <Y> or <Z> computed from the state; no measurement happens
+    double expectation(Pauli p) const {
+        std::lock_guard<Lock> lock(mtx);
+        QubitState s = relaxedState();
+        if (s.measured == 2 && relaxing(s)) return densityExpectation(s, p);
+        return pauliExpectation(s, p);
+    }
+
+    // Check if measured
+    bool isMeasured() const { 
+        std::lock_guard<Lock> lock(mtx);
+        return state->measured != 2; 
+    }
+
+    // Get measured value (only valid if measured)
+    uint8_t getMeasurement() const {
+        std::lock_guard<Lock> lock(mtx);
+        return state->measured;
+    }
+
+    // The decoherence policy, for its wakeup counters
+    const Decoherence& decoherencePolicy() const { return decoherence; }
+
+private:
+    friend class Circuit;
+    friend class QubitReactor;
+    friend struct MeasureAwaitable;
+    friend Decoherence;
+
+    std::string shm_name;
+    uint32_t    task_id;
+    uint64_t    decohere_timeout;
+    uint32_t    trace_id;
+    Storage     storage;
+    QubitState* state;
+
+    mutable Lock mtx;  // Made mutable for const methods
+    mutable std::mt19937 rng{std::random_device{}()};
+    Decoherence  decoherence;
+
+    // The *Locked operations expect `mtx` to be held and leave publishing the
+    // timestamp to the caller, so batches can update it once.
+
+    // Returns false (and the stored value) if already collapsed
+    bool measureLocked(uint8_t& result, const Timer& timer) {
+        relaxLocked();
+        if (state->measured != 2) { result = state->measured; return false; }
+        double p1 = norm(state->beta_real, state->beta_imag);
+        std::bernoulli_distribution dist(p1);
+        result = dist(rng);
+        collapseState(*state, result);
+        QubitTrace::emit(EV_MEASURE, trace_id, task_id, result);
+        QUBIT_PROBE4(collapse, shm_name.c_str(), trace_id, result,
+                     QUBIT_PROBE_ENABLED(collapse) ? timer.elapsedNs() : 0);
+        propagateToLinks(result);
+        notifyCollapse();
+        return true;
+    }
+
+    // Returns false if the qubit is collapsed and the gate was skipped
+    bool applyGateLocked(char gate, const Timer& timer) {
+        if (state->measured != 2) return false;
+        relaxLocked();
+        bool known;
+        if (Decoherence::enabled && relaxing(*state)) {
+            known = applyToDensity(*state, [gate](double& ar, double& ai, double& br, double& bi) {
+                return applyGateToAmplitudes(ar, ai, br, bi, gate);
+            });
+            amplitudesFromDensity(*state);
+        } else {
+            known = applyGateToState(*state, gate);
+        }
+        if (!known)
+            std::cerr << "Unknown gate: " << gate << std::endl;
+        QubitTrace::emit(EV_GATE, trace_id, task_id, uint8_t(gate));
+        QUBIT_PROBE4(gate, shm_name.c_str(), trace_id, gate,
+                     QUBIT_PROBE_ENABLED(gate) ? timer.elapsedNs() : 0);
+        return true;
+    }
+
+    bool applyUnitaryLocked(const GateMatrix& u, const Timer& timer) {
+        if (state->measured != 2) return false;
+        relaxLocked();
+        if (Decoherence::enabled && relaxing(*state)) {
+            applyToDensity(*state, [&u](double& ar, double& ai, double& br, double& bi) {
+                applyMatrixToAmplitudes(ar, ai, br, bi, u);
+                return true;
+            });
+            amplitudesFromDensity(*state);
+        } else {
+            applyMatrixToAmplitudes(state->alpha_real, state->alpha_imag, state->beta_real, state->beta_imag, u);
+        }
+        QubitTrace::emit(EV_GATE, trace_id, task_id, uint8_t('U'));
+        QUBIT_PROBE4(gate, shm_name.c_str(), trace_id, 'U',
+                     QUBIT_PROBE_ENABLED(gate) ? timer.elapsedNs() : 0);
+        return true;
+    }
+
+    void entangleLocked(const std::vector<std::string>& peers) {
+        size_t n = std::min(peers.size(), size_t(MaxLinks));
+        for (size_t i = 0; i < n; ++i) {
+            strncpy(state->links[i], peers[i].c_str(), 63);
+            if (QubitTrace::enabled())
+                QubitTrace::emit(EV_ENTANGLE, trace_id, task_id, 0, traceId(peers[i].c_str()));
+        }
+        state->link_count = n;
+    }
+
+    void setStateLocked(double ar, double ai, double br, double bi) {
+        state->alpha_real = ar;
+        state->alpha_imag = ai;
+        state->beta_real = br;
+        state->beta_imag = bi;
+        state->measured = 2;
+        if (Decoherence::enabled && relaxing(*state)) {
+            state->relaxed_at_ns = Clock::nowNs();
+            densityFromAmplitudes(*state);
+        }
+        QubitTrace::emit(EV_SET_STATE, trace_id, task_id);
+    }
+
+    // Fold the T1/T2 evolution since the last touch into the shared state;
+    // only operations that change the state do this
+    void relaxLocked() {
+        if (Decoherence::enabled && relaxing(*state)) relaxTo(*state, Clock::nowNs());
+    }
+
+    // The state as of now, for readers; the shared state is left alone
+    QubitState relaxedState() const {
+        QubitState s = *state;
+        if (Decoherence::enabled && relaxing(s)) relaxTo(s, Clock::nowNs());
+        return s;
+    }
+
+    // A collapsed state does not relax; setState() restarts the clock
+    static void relaxTo(QubitState& s, uint64_t now) {
+        if (s.measured != 2 || now <= s.relaxed_at_ns) return;
+        relaxDensity(s, (now - s.relaxed_at_ns) / 1e6);
+        amplitudesFromDensity(s);
+        s.relaxed_at_ns = now;
+    }
+
+    void initHeader() {
+        std::lock_guard<Lock> lock(mtx);
+        if (state->task_id != task_id || state->magic != QUBIT_STATE_MAGIC ||
+            state->version != QUBIT_STATE_VERSION) {
+            if (state->task_id != 0 && uint32_t(getpid()) != state->owner_pid &&
+                ownerAlive(state->owner_pid, state->owner_start))
+                std::cerr << "Qubit '" << shm_name << "': resetting task " << state->task_id
+                          << " state still owned by pid " << state->owner_pid << std::endl;
+            std::memset(state, 0, sizeof(QubitState));
+            state->task_id = task_id;
+            state->magic = QUBIT_STATE_MAGIC;
+            state->version = QUBIT_STATE_VERSION;
+            updateTimestamp();
+        }
+        state->owner_pid = getpid();
+        state->owner_start = selfStartTime();
+        state->owner_since_ms = SteadyClock::nowMs();
+    }
+
+    // The timestamp only feeds the decoherence timeout
+    void updateTimestamp() {
+        if (!Decoherence::enabled) return;
+        state->created_at = nowMs();
+        state->decohere_timeout_ms = decohere_timeout;
+        if (state->measured == 2) decoherence.rearm(state->created_at + decohere_timeout + 1);
+    }
+
+    void resetLinks() {
+        state->link_count = 0;
+        for (int i = 0; i < 4; ++i) state->links[i][0] = '\0';
+    }
+
+    static double norm(double r, double i) { return r*r + i*i; }
+
+    uint64_t nowMs() const { return Clock::nowMs(); }
+
+    void propagateToLinks(uint8_t result) {
+        if (MaxLinks == 0) return;
+        Timer timer(OP_PROPAGATE);
+        for (uint32_t i = 0; i < state->link_count; ++i) {
+            const char* peer = state->links[i];
+            uint64_t start = QUBIT_PROBE_ENABLED(propagate) ? OpTimer::nowNs() : 0;
+            if (strchr(peer, ':')) {  // "node:qubit", delivered by the bridge
+                if (RemoteLinks::post(peer, result) && QubitTrace::enabled())
+                    QubitTrace::emit(EV_PROPAGATE, trace_id, task_id, result, traceId(peer));
+                continue;
+            }
+            int fd = shm_open(qubitShmName(peer).c_str(), O_RDWR, 0);
+            if (fd < 0) continue;
+            void* p = mmap(nullptr, sizeof(QubitState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) { close(fd); continue; }
+            auto peerState = reinterpret_cast<QubitState*>(p);
+            peerState->measured = result;
+            if (QubitTrace::enabled())
+                QubitTrace::emit(EV_PROPAGATE, trace_id, task_id, result, traceId(peer));
+            QUBIT_PROBE4(propagate, shm_name.c_str(), peer, result,
+                         start ? OpTimer::nowNs() - start : 0);
+            munmap(p, sizeof(QubitState));
+            close(fd);
+        }
+    }
+
+    // Called by the decoherence policy at the deadline, or by
+    // VirtualClock::advance(). Returns the next deadline in Clock ms, or 0
+    // when nothing is pending (collapsed, or relaxing lazily instead).
+    uint64_t decohereCheck() {
+        std::lock_guard<Lock> lock(mtx);
+        if (state->t1_ms > 0 || state->t2_ms > 0 || state->measured != 2) return 0;
+        if (nowMs() - state->created_at > state->decohere_timeout_ms) {
+            Timer timer(OP_DECOHERE);
+            // random collapse
+            double p1 = norm(state->beta_real, state->beta_imag);
+            std::bernoulli_distribution dist(p1);
+            state->measured = dist(rng);
+            QubitTrace::emit(EV_DECOHERE, trace_id, task_id, state->measured);
+            QUBIT_PROBE4(decohere, shm_name.c_str(), trace_id, state->measured,
+                         nowMs() - state->created_at - state->decohere_timeout_ms);
+            propagateToLinks(state->measured);
+            notifyCollapse();
+            return 0;
+        }
+        return state->created_at + state->decohere_timeout_ms + 1;
+    }
+};
+
+// Shared memory, a mutex, a decoherence thread and 4 links
+typedef BasicQubit<ShmStorage, NotifyingMutex, ThreadDecoherence, 4> Qubit;
+
+// In-process, unlocked, never decoheres, no links and no latency stats: for
+// simulation hot loops where one thread owns each qubit
+typedef BasicQubit<LocalStorage, NullLock, NoDecoherence, 0, NullTimer> SimQubit;
+
+// <P> over `qubits`, term qubit k being qubits[k]; terms beyond the vector
+// count as identity
+template <class Q>
+inline double expectation(const std::vector<Q*>& qubits, const PauliString& p) {
+    double e = 1.0;
+    for (const PauliString::Term& t : p.terms)
+        if (t.qubit < qubits.size()) e *= qubits[t.qubit]->expectation(t.op);
+    return e;
+}
+
+// Create GHZ state among multiple qubits (2-5 qubits)
+inline void formGHZGroup(std::vector<Qubit*>& qubits) {
+    size_t n = qubits.size();
+    if (n < 2 || n > 5) {
+        std::cerr << "GHZ group size must be between 2 and 5" << std::endl;
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        std::vector<std::string> peers;
+        for (size_t j = 0; j < n; j++) {
+            if (i == j) continue;
+            peers.push_back(qubits[j]->name());
+        }
+        qubits[i]->entangle(peers);
+        qubits[i]->setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+    }
+}
@@ -0,0 +1,404 @@
+#pragma once
+
+// Many independent qubits in one mapping.
+//
+// A QubitArena is a register of `capacity` QubitStates laid out back to back
+// behind a small header, in a single mapping from one of several backing
+// stores:
+//
+//   ARENA_SHM      POSIX shm (tmpfs), like a single Qubit; 4 KB pages
+//   ARENA_FILE     a regular file mapped MAP_SHARED; survives a reboot
+//   ARENA_HUGETLB  hugetlbfs file, or memfd_create(MFD_HUGETLB); 2 MB pages
+//
+// `populate` prefaults the whole mapping at open (MAP_POPULATE), moving the
+// page-fault cost of first touch out of the hot path. Reopening an arena
+// with the same name, task id and capacity keeps its states, as Qubit does.
+//
+// On multi-socket hosts `numa` interleaves the pages over all nodes, or
+// leaves them unplaced for firstTouch() through node-pinned NumaWorkers.
+//
+// Arena qubits do not run a decoherence thread and their links are not
+// followed on measurement. One mutex guards the whole arena.
+//
+// setStates(), applyGates() and measureMany() take arrays of handles
+// (indices) and run the whole batch under one lock, in call order, with
+// the states a few handles ahead prefetched. Measurements draw one 32-bit
+// number each from the arena's generator. Results go into caller buffers;
+// nothing is allocated. (Sorting shuffled batches into memory order was
+// slower than prefetching them at 1M qubits, so batches are not reordered.)
+
+#include "qubit.h"
+#include "qubit_numa.h"
+
+#include <cerrno>
+#include <linux/magic.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+
+enum ArenaBacking : uint8_t { ARENA_SHM, ARENA_FILE, ARENA_HUGETLB };
+
+inline const char* arenaBackingName(ArenaBacking b) {
+    static const char* names[] = {"shm", "file", "hugetlb"};
+    return names[b];
+}
+
+struct ArenaOptions {
+    ArenaBacking backing = ARENA_SHM;
+    std::string  path;            // ARENA_FILE: file to map; ARENA_HUGETLB: optional hugetlbfs file
+    bool         populate = false;  // with NUMA_FIRST_TOUCH, left to firstTouch()
+    ArenaNuma    numa = NUMA_DEFAULT;
+};
+
+const uint32_t ARENA_MAGIC   = 0x51415245;  // "QARE"
+const uint32_t ARENA_VERSION = 1;
+
+struct ArenaHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t state_size;
+    uint32_t task_id;
+    uint64_t capacity;
+    uint32_t owner_pid;       // last process to map the arena, 0 = none
+    uint32_t reserved0;
+    uint64_t owner_start;     // its processStartTime()
+    uint64_t owner_since_ms;  // steady-clock ms when it mapped the arena
+    uint8_t  reserved[16];
+};
+static_assert(sizeof(ArenaHeader) == 64, "arena header is one cache line");
+
+// Check one state against `policy` and count it in `report`; collapsed
+// states are skipped. Shared by the arena layouts' scalar paths.
+inline void normalizeChecked(double& ar, double& ai, double& br, double& bi, uint8_t measured,
+                             const NormPolicy& policy, NormReport& report) {
+    if (measured != 2) return;
+    report.checked++;
+    double n = amplitudeNorm(ar, ai, br, bi);
+    double dev = std::fabs(n - 1.0);
+    if (dev <= policy.tolerance) {
+        report.max_deviation = std::max(report.max_deviation, dev);
+        return;
+    }
+    report.out_of_tolerance++;
+    if (finiteNorm(n)) report.max_deviation = std::max(report.max_deviation, dev);
+    else report.invalid++;
+    if (policy.action != NORM_RENORMALIZE) return;
+    if (!normalizeAmplitudes(ar, ai, br, bi)) {
+        ar = 1.0;
+        ai = br = bi = 0.0;
+    }
+}
+
+// One mapping of `bytes` from the chosen backing store, with the arena
+// header at its start; the arena layouts build on it
+class ArenaMapping {
+public:
+    ArenaMapping(const std::string& name, size_t bytes, const ArenaOptions& options)
+        : arena_name(name), opts(options), map_bytes(bytes) {
+        if (opts.backing == ARENA_HUGETLB && !mapHugetlb()) {
+            std::cerr << "Arena '" << name << "': no huge pages available, using shm" << std::endl;
+            opts.backing = ARENA_SHM;
+        }
+        if (!ptr) mapShared();
+        if (opts.numa == NUMA_INTERLEAVE && numaInterleave(ptr, map_bytes) && opts.populate)
+            touchPages(ptr, map_bytes);
+    }
+
+    ~ArenaMapping() {
+        munmap(ptr, map_bytes);
+        if (fd >= 0) close(fd);
+    }
+
+    ArenaMapping(const ArenaMapping&) = delete;
+    ArenaMapping& operator=(const ArenaMapping&) = delete;
+
+    const std::string& name() const { return arena_name; }
+    ArenaBacking backing() const { return opts.backing; }  // after any fallback
+    size_t bytes() const { return map_bytes; }
+    char* data() const { return static_cast<char*>(ptr); }
+
+    // Keep the contents of a matching arena, reset anything else. A fresh
+    // mapping is already zero, so it is not written (and not faulted in).
+    void initHeader(uint32_t magic, uint32_t stateSize, uint32_t taskId, uint64_t capacity) {
+        ArenaHeader* header = static_cast<ArenaHeader*>(ptr);
+        if (header->magic != magic || header->version != ARENA_VERSION ||
+            header->state_size != stateSize || header->capacity != capacity ||
+            header->task_id != taskId) {
+            if (header->magic != 0) std::memset(ptr, 0, map_bytes);
+            header->version = ARENA_VERSION;
+            header->state_size = stateSize;
+            header->task_id = taskId;
+            header->capacity = capacity;
+            header->magic = magic;
+        }
+        header->owner_pid = getpid();
+        header->owner_start = selfStartTime();
+        header->owner_since_ms = SteadyClock::nowMs();
+    }
+
+    // Remove the named shm segment or file; the mapping stays valid
+    void unlink() {
+        if (opts.backing == ARENA_SHM) shm_unlink(qubitShmName(arena_name).c_str());
+        else if (!opts.path.empty()) ::unlink(opts.path.c_str());
+    }
+
+private:
+    std::string  arena_name;
+    ArenaOptions opts;
+    size_t       map_bytes;
+    int          fd = -1;
+    void*        ptr = nullptr;
+
+    // Placement policies must be set before any page is faulted in
+    int mapFlags() const {
+        return MAP_SHARED | (opts.populate && opts.numa == NUMA_DEFAULT ? MAP_POPULATE : 0);
+    }
+
+    void mapShared() {
+        if (opts.backing == ARENA_FILE) {
+            if (opts.path.empty()) opts.path = qubitShmName(arena_name);
+            fd = open(opts.path.c_str(), O_RDWR | O_CREAT, 0666);
+            if (fd < 0) { perror("open arena"); exit(1); }
+        } else {
+            fd = shm_open(qubitShmName(arena_name).c_str(), O_RDWR | O_CREAT, 0666);
+            if (fd < 0) { perror("shm_open arena"); exit(1); }
+        }
+        if (ftruncate(fd, map_bytes) != 0) { perror("ftruncate arena"); exit(1); }
+        ptr = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, mapFlags(), fd, 0);
+        if (ptr == MAP_FAILED) { perror("mmap arena"); exit(1); }
+    }
+
+    // False if huge pages cannot be had, so the caller can fall back. A
+    // path must be on hugetlbfs; a file this call did not create is never
+    // removed.
+    bool mapHugetlb() {
+        size_t huge = hugePageSize();
+        size_t rounded = (map_bytes + huge - 1) / huge * huge;
+        bool created = false;
+        int f;
+        if (opts.path.empty()) {
+            f = memfd_create(arena_name.c_str(), MFD_HUGETLB);
+        } else {
+            f = open(opts.path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+            created = f >= 0;
+            if (f < 0 && errno == EEXIST) f = open(opts.path.c_str(), O_RDWR);
+        }
+        if (f < 0) return false;
+        void* p = MAP_FAILED;
+        struct statfs fs;
+        bool hugetlbfs = opts.path.empty() || (fstatfs(f, &fs) == 0 && fs.f_type == HUGETLBFS_MAGIC);
+        if (!hugetlbfs)
+            std::cerr << "Arena '" << arena_name << "': " << opts.path << " is not on hugetlbfs" << std::endl;
+        else if (ftruncate(f, rounded) == 0)
+            p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, mapFlags(), f, 0);
+        if (p == MAP_FAILED) {
+            close(f);
+            if (created) ::unlink(opts.path.c_str());
+            return false;
+        }
+        fd = f;
+        ptr = p;
+        map_bytes = rounded;
+        return true;
+    }
+
+    static size_t hugePageSize() {
+        FILE* f = fopen("/proc/meminfo", "r");
+        size_t kb = 2048;
+        if (f) {
+            char line[128];
+            while (fgets(line, sizeof(line), f))
+                if (sscanf(line, "Hugepagesize: %zu kB", &kb) == 1) break;
+            fclose(f);
+        }
+        return kb * 1024;
+    }
+};
+
+class QubitArena {
+public:
+    QubitArena(const std::string& name, uint32_t taskId, size_t capacity,
+               const ArenaOptions& options = ArenaOptions())
+        : count(capacity), mapping(name, sizeof(ArenaHeader) + capacity * sizeof(QubitState), options) {
+        mapping.initHeader(ARENA_MAGIC, sizeof(QubitState), taskId, capacity);
+        states = reinterpret_cast<QubitState*>(mapping.data() + sizeof(ArenaHeader));
+    }
+
+    QubitArena(const QubitArena&) = delete;
+    QubitArena& operator=(const QubitArena&) = delete;
+
+    size_t size() const { return count; }
+    const std::string& name() const { return mapping.name(); }
+    ArenaBacking backing() const { return mapping.backing(); }  // after any fallback
+    size_t bytes() const { return mapping.bytes(); }
+
+    // Raw states; callers doing their own batching hold lock() around access
+    QubitState* data() { return states; }
+    QubitState& operator[](size_t i) { return states[i]; }
+    std::mutex& lock() { return mtx; }
+
+    void setState(size_t i, double ar, double ai, double br, double bi) {
+        std::lock_guard<std::mutex> lock(mtx);
+        QubitState& s = states[i];
+        s.alpha_real = ar; s.alpha_imag = ai;
+        s.beta_real  = br; s.beta_imag  = bi;
+        s.measured = 2;
+    }
+
+    // setState() scaled to unit norm; false (state unchanged) if invalid
+    bool setStateNormalized(size_t i, double ar, double ai, double br, double bi) {
+        if (!normalizeAmplitudes(ar, ai, br, bi)) return false;
+        setState(i, ar, ai, br, bi);
+        return true;
+    }
+
+    // Check (and with NORM_RENORMALIZE fix) the norm of every unmeasured
+    // state in [begin, end)
+    NormReport normalizeStates(size_t begin, size_t end, const NormPolicy& policy = NormPolicy()) {
+        std::lock_guard<std::mutex> lock(mtx);
+        NormReport report;
+        for (size_t i = begin; i < std::min(end, count); ++i) {
+            QubitState& s = states[i];
+            normalizeChecked(s.alpha_real, s.alpha_imag, s.beta_real, s.beta_imag, s.measured, policy, report);
+        }
+        return report;
+    }
+
+    void applyGate(size_t i, char gate) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (states[i].measured == 2 && !applyGateToState(states[i], gate))
+            std::cerr << "Unknown gate: " << gate << std::endl;
+    }
+
+    // A 2x2 unitary, e.g. gateMatrix<gates::Seq<...>>(), in one multiply
+    void applyUnitary(size_t i, const GateMatrix& u) {
+        std::lock_guard<std::mutex> lock(mtx);
+        QubitState& s = states[i];
+        if (s.measured == 2) applyMatrixToAmplitudes(s.alpha_real, s.alpha_imag, s.beta_real, s.beta_imag, u);
+    }
+
+    // <X>, <Y> or <Z> of qubit i from its amplitudes
+    double expectation(size_t i, Pauli p) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return pauliExpectation(states[i], p);
+    }
+
+    // <P> of a Pauli string over the arena; terms past the end count as identity
+    double expectation(const PauliString& p) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return expectationLocked(p);
+    }
+
+    // Several strings under one lock acquisition
+    std::vector<double> expectations(const std::vector<PauliString>& strings) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<double> out;
+        out.reserve(strings.size());
+        for (const PauliString& p : strings) out.push_back(expectationLocked(p));
+        return out;
+    }
+
+    uint8_t measure(size_t i) {
+        std::lock_guard<std::mutex> lock(mtx);
+        QubitState& s = states[i];
+        if (s.measured != 2) return s.measured;
+        std::bernoulli_distribution dist(s.beta_real * s.beta_real + s.beta_imag * s.beta_imag);
+        uint8_t result = dist(rng);
+        collapseState(s, result);
+        return result;
+    }
+
+    // Set n states; amps holds ar, ai, br, bi for each handle in turn
+    void setStates(const uint32_t* handles, size_t n, const double* amps) {
+        std::lock_guard<std::mutex> lock(mtx);
+        forEachPrefetched(handles, n, [amps](QubitState& s, size_t k) {
+            const double* a = amps + 4 * k;
+            s.alpha_real = a[0]; s.alpha_imag = a[1];
+            s.beta_real  = a[2]; s.beta_imag  = a[3];
+            s.measured = 2;
+        });
+    }
+
+    // gates[k] to handles[k]; collapsed qubits are skipped
+    void applyGates(const uint32_t* handles, size_t n, const char* gates) {
+        std::lock_guard<std::mutex> lock(mtx);
+        bool unknown = false;
+        forEachPrefetched(handles, n, [gates, &unknown](QubitState& s, size_t k) {
+            if (s.measured == 2) unknown |= !applyGateToState(s, gates[k]);
+        });
+        if (unknown) std::cerr << "Unknown gate in batch" << std::endl;
+    }
+
+    // The same gate to every handle
+    void applyGates(const uint32_t* handles, size_t n, char gate) {
+        std::lock_guard<std::mutex> lock(mtx);
+        bool unknown = false;
+        forEachPrefetched(handles, n, [gate, &unknown](QubitState& s, size_t) {
+            if (s.measured == 2) unknown |= !applyGateToState(s, gate);
+        });
+        if (unknown) std::cerr << "Unknown gate: " << gate << std::endl;
+    }
+
+    // results[k] = measure(handles[k])
+    void measureMany(const uint32_t* handles, size_t n, uint8_t* results) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::mt19937& gen = rng;
+        forEachPrefetched(handles, n, [results, &gen](QubitState& s, size_t k) {
+            if (s.measured == 2) {
+                double u = gen() * (1.0 / 4294967296.0);
+                collapseState(s, u < s.beta_real * s.beta_real + s.beta_imag * s.beta_imag);
+            }
+            results[k] = s.measured;
+        });
+    }
+
+    // Fault every state in from the worker that will process it, so each
+    // node's slice of the arena lands in that node's memory
+    void firstTouch(NumaWorkers& workers) {
+        std::lock_guard<std::mutex> lock(mtx);
+        QubitState* s = states;
+        workers.parallelFor(count, [s](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                volatile uint8_t* m = &s[i].measured;
+                *m = *m;
+            }
+        });
+    }
+
+    // Apply one gate to every unmeasured qubit, each slice on its node
+    void applyGateAll(char gate, NumaWorkers& workers) {
+        std::lock_guard<std::mutex> lock(mtx);
+        QubitState* s = states;
+        workers.parallelFor(count, [s, gate](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                if (s[i].measured == 2) applyGateToState(s[i], gate);
+        });
+    }
+
+    // Remove the named shm segment or file; the mapping stays valid
+    void unlink() { mapping.unlink(); }
+
+private:
+    size_t       count;
+    ArenaMapping mapping;
+    QubitState*  states = nullptr;
+    mutable std::mutex mtx;
+    std::mt19937 rng{std::random_device{}()};
+
+    double expectationLocked(const PauliString& p) const {
+        double e = 1.0;
+        for (const PauliString::Term& t : p.terms)
+            if (t.qubit < count) e *= pauliExpectation(states[t.qubit], t.op);
+        return e;
+    }
+
+    // fn(state, k) for every k in call order, prefetching a few states ahead
+    template <class Fn>
+    void forEachPrefetched(const uint32_t* handles, size_t n, Fn fn) {
+        const size_t ahead = 8;
+        for (size_t k = 0; k < n; ++k) {
+            if (k + ahead < n) __builtin_prefetch(&states[handles[k + ahead]], 1);
+            fn(states[handles[k]], k);
+        }
+    }
+};
@@ -0,0 +1,299 @@
+#pragma once
+
+// C++20 coroutine API for measurement and collapse events.
+//
+//   QubitTask observe(Qubit& q, Qubit& peer, QubitGroup& group) {
+//       uint8_t r = co_await q.measureAsync();  // never blocks the thread
+//       co_await peer.collapsed();              // resumes once peer collapses
+//       co_await group.allCollapsed();          // every member collapsed
+//   }
+//
+// A QubitReactor owns an epoll set with one eventfd and one timerfd and runs
+// it on a few threads. Any collapse in this process (measure, circuit or
+// decoherence) writes the eventfd through notifyCollapse(), and the reactor
+// then rescans its waiters. Collapses written into shared memory by other
+// processes raise no event, so while anything waits the timerfd fires once
+// at the nearest of `poll_ms` ahead and the watched qubits' decoherence
+// deadlines. With nothing waiting it is disarmed and the reactor sleeps.
+//
+// measureAsync() measures inline when the qubit's lock is free. Otherwise it
+// registers with the lock (NotifyingMutex), suspends, and the reactor
+// retries tryMeasure() when the lock's holder releases it, so a contended
+// qubit never blocks a reactor thread or the other coroutines it serves.
+// Coroutines resume on reactor threads. Destroy a reactor only after its
+// waiters have resumed.
+//
+// Requires a compiler with coroutine support (-std=c++20); under older
+// standards this header is empty and QUBIT_HAS_ASYNC is left undefined.
+
+#include "qubit.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define QUBIT_HAS_ASYNC 1
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+// Fire-and-forget coroutine: starts eagerly, frees itself when done
+struct QubitTask {
+    struct promise_type {
+        QubitTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+class QubitReactor {
+public:
+    explicit QubitReactor(unsigned threads = 2, int poll_ms = 10) : poll_ns(uint64_t(poll_ms) * 1000000) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);  // disarmed
+        if (epoll_fd < 0 || wake_fd < 0 || timer_fd < 0) { perror("reactor"); exit(1); }
+        addFd(wake_fd);
+        addFd(timer_fd);
+
+        std::atomic<int>* slots = collapseListeners();
+        for (int i = 0; i < COLLAPSE_LISTENER_SLOTS && listener_slot < 0; ++i) {
+            int expected = 0;
+            if (slots[i].compare_exchange_strong(expected, wake_fd + 1)) listener_slot = i;
+        }
+        if (listener_slot < 0)
+            std::cerr << "QubitReactor: no collapse listener slot free, polling only" << std::endl;
+
+        for (unsigned i = 0; i < (threads ? threads : 1); ++i)
+            workers.emplace_back([this] { runLoop(); });
+    }
+
+    ~QubitReactor() {
+        if (listener_slot >= 0) collapseListeners()[listener_slot].store(0);
+        running = false;
+        wake();
+        for (auto& t : workers) t.join();
+        close(timer_fd);
+        close(wake_fd);
+        close(epoll_fd);
+    }
+
+    QubitReactor(const QubitReactor&) = delete;
+    QubitReactor& operator=(const QubitReactor&) = delete;
+
+    // Process-wide reactor used when an awaitable is not given one
+    static QubitReactor& global() {
+        static QubitReactor reactor;
+        return reactor;
+    }
+
+    // Run `fn` on a reactor thread
+    void post(std::function<void()> fn) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            posted.push_back(std::move(fn));
+        }
+        wake();
+    }
+
+    // Run `fn` on reactor threads until it returns true. A false return, such
+    // as a busy lock, is retried on the next pass: at once for the first
+    // RETRY_SPINS passes, then on the next event or the timer.
+    void retry(std::function<bool()> fn) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tries.push_back(std::move(fn));
+        }
+        wake();
+    }
+
+    // Resume `h` once every qubit in `group` is collapsed
+    void watch(std::vector<Qubit*> group, std::coroutine_handle<> h) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            watches.push_back(Watch{std::move(group), h});
+        }
+        wake();  // it may have collapsed before the watch was queued
+    }
+
+    size_t waiting() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return watches.size();
+    }
+
+    std::atomic<uint64_t> wakeups{0};  // epoll_wait returns with events
+
+    static bool collapsed(const Qubit& q) {
+        return __atomic_load_n(&q.state->measured, __ATOMIC_ACQUIRE) != 2;
+    }
+
+    static bool allCollapsed(const std::vector<Qubit*>& group) {
+        for (const Qubit* q : group)
+            if (!collapsed(*q)) return false;
+        return true;
+    }
+
+private:
+    struct Watch {
+        std::vector<Qubit*>     group;
+        std::coroutine_handle<> handle;
+    };
+
+    int epoll_fd, wake_fd, timer_fd;
+    uint64_t poll_ns;
+    uint64_t timer_at = 0;  // armed deadline in steady ns, 0 = disarmed; under mtx
+    int listener_slot = -1;
+    std::atomic<bool> running{true};
+    std::vector<std::thread> workers;
+    mutable std::mutex mtx;
+    std::deque<std::function<void()>> posted;
+    std::deque<std::function<bool()>> tries;
+    std::vector<Watch> watches;
+
+    static const int RETRY_SPINS = 64;
+
+    void addFd(int fd) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) { perror("epoll_ctl"); exit(1); }
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t n = write(wake_fd, &one, sizeof(one));
+        (void)n;
+    }
+
+    // Arm the timer at the nearest of the poll deadline and the watched
+    // qubits' decoherence deadlines, or disarm it when nothing waits. An
+    // armed deadline that is still ahead and no later is left alone.
+    void armTimerLocked() {
+        uint64_t now = SteadyClock::nowNs();
+        uint64_t at = 0;
+        if (!watches.empty() || !tries.empty()) {
+            at = now + poll_ns;
+            for (const Watch& w : watches)
+                for (const Qubit* q : w.group) {
+                    uint64_t ms = __atomic_load_n(&q->state->decohere_timeout_ms, __ATOMIC_RELAXED);
+                    if (!ms || collapsed(*q)) continue;
+                    uint64_t due = (__atomic_load_n(&q->state->created_at, __ATOMIC_RELAXED) + ms + 1) * 1000000;
+                    at = std::min(at, std::max(due, now + 1000000));  // a late collapse: look again in 1 ms
+                }
+        }
+        if (at ? timer_at > now && timer_at <= at : timer_at == 0) return;
+        timer_at = at;
+        itimerspec spec = {};
+        spec.it_value.tv_sec = time_t(at / 1000000000);
+        spec.it_value.tv_nsec = long(at % 1000000000);
+        timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);  // all zero disarms
+    }
+
+    void runLoop() {
+        epoll_event events[4];
+        std::vector<std::coroutine_handle<>> ready;
+        std::deque<std::function<bool()>> batch;
+        int spins = 0;
+        while (running) {
+            int n = epoll_wait(epoll_fd, events, 4, -1);
+            if (n > 0) wakeups.fetch_add(1, std::memory_order_relaxed);
+            for (int i = 0; i < n; ++i) {
+                uint64_t count;
+                ssize_t r = read(events[i].data.fd, &count, sizeof(count));  // drain
+                (void)r;
+            }
+            for (;;) {
+                std::function<void()> fn;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (posted.empty()) break;
+                    fn = std::move(posted.front());
+                    posted.pop_front();
+                }
+                fn();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                batch.swap(tries);
+            }
+            bool again = false;
+            for (auto& fn : batch) {
+                if (fn()) continue;
+                std::lock_guard<std::mutex> lock(mtx);
+                tries.push_back(std::move(fn));
+                again = true;
+            }
+            batch.clear();
+            spins = again ? spins + 1 : 0;
+            if (again && spins <= RETRY_SPINS) {
+                std::this_thread::yield();
+                wake();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                size_t kept = 0;
+                for (Watch& w : watches) {
+                    if (allCollapsed(w.group)) ready.push_back(w.handle);
+                    else {
+                        // a self-move would leave the group empty, i.e. "all collapsed"
+                        if (&watches[kept] != &w) watches[kept] = std::move(w);
+                        kept++;
+                    }
+                }
+                watches.resize(kept);
+                armTimerLocked();
+            }
+            for (auto h : ready) h.resume();
+            ready.clear();
+        }
+        wake();  // pass the shutdown on to the other threads
+    }
+};
+
+// co_await q.measureAsync(): the measured bit, without blocking on q's lock
+struct MeasureAwaitable {
+    Qubit&        qubit;
+    QubitReactor& reactor;
+    uint8_t       result = 0;
+
+    bool await_ready() { return qubit.tryMeasure(result); }
+    void await_suspend(std::coroutine_handle<> h) {
+        qubit.mtx.waiters.fetch_add(1);  // the holder's unlock now wakes the reactor
+        reactor.retry([this, h] {
+            if (!qubit.tryMeasure(result)) return false;
+            qubit.mtx.waiters.fetch_sub(1);
+            h.resume();
+            return true;
+        });
+    }
+    uint8_t await_resume() const { return result; }
+};
+
+// co_await q.collapsed() / group.allCollapsed(): resumes once collapsed
+struct CollapseAwaitable {
+    std::vector<Qubit*> group;
+    QubitReactor&       reactor;
+
+    bool await_ready() const { return QubitReactor::allCollapsed(group); }
+    void await_suspend(std::coroutine_handle<> h) { reactor.watch(group, h); }
+    void await_resume() const {}
+};
+
+template <> inline MeasureAwaitable Qubit::measureAsync(QubitReactor& reactor) { return MeasureAwaitable{*this, reactor}; }
+template <> inline MeasureAwaitable Qubit::measureAsync() { return measureAsync(QubitReactor::global()); }
+template <> inline CollapseAwaitable Qubit::collapsed(QubitReactor& reactor) { return CollapseAwaitable{{this}, reactor}; }
+template <> inline CollapseAwaitable Qubit::collapsed() { return collapsed(QubitReactor::global()); }
+
+// Qubits observed together, e.g. the members of a GHZ group
+struct QubitGroup {
+    std::vector<Qubit*> members;
+
+    CollapseAwaitable allCollapsed(QubitReactor& reactor) const { return CollapseAwaitable{members, reactor}; }
+    CollapseAwaitable allCollapsed() const { return allCollapsed(QubitReactor::global()); }
+};
+
+#endif
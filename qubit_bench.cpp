@@ -0,0 +1,973 @@
+// Throughput benchmarks.
+//
+//   g++ -std=c++11 -O2 -pthread -o qubit_bench qubit_bench.cpp
+//   ./qubit_bench
+
+#include "qubit.h"
+#include "circuit.h"
+#include "trajectory.h"
+#include "qubit_snapshot.h"
+#include "qubit_arena.h"
+#include "qubit_soa.h"
+#include "qubit_bridge.h"
+#include "qubit_server.h"
+
+#include <functional>
+#include <memory>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+// Best of `reps` runs of `iters` calls to fn, in operations per second
+static double opsPerSec(int iters, int opsPerIter, const std::function<void()>& fn, int reps = 3) {
+    double best = 0;
+    for (int r = 0; r < reps; r++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iters; i++) fn();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, double(iters) * opsPerIter / s);
+    }
+    return best;
+}
+
+static void report(const std::string& label, double base, double batched) {
+    std::cout << std::left << std::setw(28) << label << std::right << std::fixed
+              << std::setprecision(0) << std::setw(14) << base << " ops/s"
+              << std::setw(14) << batched << " ops/s"
+              << std::setprecision(2) << std::setw(8) << batched / base << "x\n";
+}
+
+void bench_circuit() {
+    std::cout << "\n===== BENCH 1: CIRCUIT VS CALL-BY-CALL =====\n";
+    std::cout << std::left << std::setw(28) << "workload" << std::right
+              << std::setw(20) << "call-by-call" << std::setw(20) << "circuit" << "\n";
+    std::vector<std::string> names = {"bench_qubit1", "bench_qubit2", "bench_qubit3"};
+    {
+        Qubit q1(names[0], 1);
+        Qubit q2(names[1], 1);
+        Qubit q3(names[2], 1);
+        const int iters = 200000;
+
+        // Bell preparation only: 5 ops
+        double base = opsPerSec(iters, 5, [&] {
+            q1.setState(1.0, 0.0, 0.0, 0.0);
+            q1.applyGate('H');
+            q2.setState(1.0, 0.0, 0.0, 0.0);
+            q1.entangle({names[1]});
+            q2.entangle({names[0]});
+        });
+        Circuit bell = bellCircuit(q1, q2);
+        std::vector<uint8_t> results;
+        double batched = opsPerSec(iters, 5, [&] { bell.execute(results); });
+        report("Bell prepare", base, batched);
+
+        // Bell preparation plus both measurements: 7 ops
+        base = opsPerSec(iters / 10, 7, [&] {
+            q1.setState(1.0, 0.0, 0.0, 0.0);
+            q1.applyGate('H');
+            q2.setState(1.0, 0.0, 0.0, 0.0);
+            q1.entangle({names[1]});
+            q2.entangle({names[0]});
+            q1.measure();
+            q2.measure();
+        });
+        bell.measure(q1).measure(q2);
+        batched = opsPerSec(iters / 10, 7, [&] { bell.execute(results); });
+        report("Bell prepare + measure", base, batched);
+
+        // GHZ preparation: 6 ops
+        std::vector<Qubit*> qubits = {&q1, &q2, &q3};
+        base = opsPerSec(iters, 6, [&] { formGHZGroup(qubits); });
+        Circuit ghz = ghzCircuit(qubits);
+        batched = opsPerSec(iters, 6, [&] { ghz.execute(results); });
+        report("GHZ-3 prepare", base, batched);
+    }
+    for (const auto& name : names) shm_unlink(name.c_str());
+}
+
+// Random client-style circuit: mostly single-qubit gates with occasional
+// state resets and measurements, the redundancy the optimizer targets
+static Circuit randomCircuit(const std::vector<Qubit*>& qubits, int ops, std::mt19937& gen) {
+    const char gates[] = {'H', 'X', 'Z', 'S', 'T'};
+    Circuit c;
+    for (Qubit* q : qubits) c.setState(*q, 1.0, 0.0, 0.0, 0.0);
+    std::uniform_int_distribution<int> pick_qubit(0, int(qubits.size()) - 1);
+    std::uniform_int_distribution<int> pick_kind(0, 99);
+    std::uniform_int_distribution<int> pick_gate(0, 4);
+    for (int i = 0; i < ops; i++) {
+        Qubit& q = *qubits[pick_qubit(gen)];
+        int kind = pick_kind(gen);
+        if (kind < 6) c.setState(q, 1.0, 0.0, 0.0, 0.0);
+        else if (kind < 9) c.measure(q);
+        else c.gate(q, gates[pick_gate(gen)]);
+    }
+    return c;
+}
+
+void bench_optimizer() {
+    std::cout << "\n===== BENCH 2: PEEPHOLE OPTIMIZER =====\n";
+    std::vector<std::string> names = {"bench_opt1", "bench_opt2", "bench_opt3"};
+    {
+        Qubit q1(names[0], 1);
+        Qubit q2(names[1], 1);
+        Qubit q3(names[2], 1);
+        std::vector<Qubit*> qubits = {&q1, &q2, &q3};
+        std::mt19937 gen(42);
+        const int circuits = 20, runs = 2000;
+        size_t gates_before = 0, gates_after = 0;
+        double raw_s = 0, opt_s = 0;
+        std::vector<uint8_t> results;
+        for (int n = 0; n < circuits; n++) {
+            Circuit raw = randomCircuit(qubits, 500, gen);
+            Circuit opt = raw;
+            OptimizeReport rep = opt.optimize();
+            gates_before += rep.gates_before;
+            gates_after += rep.gates_after;
+            auto t0 = std::chrono::steady_clock::now();
+            for (int i = 0; i < runs; i++) raw.execute(results);
+            auto t1 = std::chrono::steady_clock::now();
+            for (int i = 0; i < runs; i++) opt.execute(results);
+            auto t2 = std::chrono::steady_clock::now();
+            raw_s += std::chrono::duration<double>(t1 - t0).count();
+            opt_s += std::chrono::duration<double>(t2 - t1).count();
+        }
+        std::cout << "Gates: " << gates_before << " -> " << gates_after << " ("
+                  << std::fixed << std::setprecision(1)
+                  << 100.0 * (gates_before - gates_after) / gates_before << "% removed)\n";
+        std::cout << "Execution: raw " << std::setprecision(3) << raw_s << "s, optimized "
+                  << opt_s << "s, " << std::setprecision(2) << raw_s / opt_s << "x faster\n";
+    }
+    for (const auto& name : names) shm_unlink(name.c_str());
+}
+
+void bench_trajectories() {
+    std::cout << "\n===== BENCH 3: TRAJECTORY SCALING =====\n";
+    std::vector<std::string> names = {"bench_traj1", "bench_traj2", "bench_traj3"};
+    {
+        Qubit q1(names[0], 1);
+        Qubit q2(names[1], 1);
+        Qubit q3(names[2], 1);
+        Circuit ghz = ghzCircuit({&q1, &q2, &q3});
+        ghz.gate(q1, 'H').gate(q1, 'H').measure(q1).measure(q2).measure(q3);
+        NoiseModel noise;
+        noise.relaxation = Relaxation{50.0, 30.0};
+        noise.gate_time_ms = 0.1;
+        noise.readout_error = 0.01;
+        const uint64_t count = 400000;
+        unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+        double base = 0;
+        for (unsigned t = 1; t <= max_threads; t *= 2) {
+            TrajectoryRunner runner(t);
+            auto start = std::chrono::steady_clock::now();
+            runner.run(ghz, noise, count);
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double rate = count / s;
+            if (t == 1) base = rate;
+            std::cout << std::setw(3) << t << " threads" << std::fixed << std::setprecision(0)
+                      << std::setw(14) << rate << " trajectories/s" << std::setprecision(2)
+                      << std::setw(8) << rate / base << "x\n";
+        }
+    }
+    for (const auto& name : names) shm_unlink(name.c_str());
+}
+
+// Warm start from a snapshot of a million qubits, written directly in the
+// file format so the bench does not need a million shm segments first
+void bench_snapshot() {
+    std::cout << "\n===== BENCH 4: SNAPSHOT WARM START =====\n";
+    const std::string path = "/tmp/qubit_bench.qsnap";
+    const size_t count = 1 << 20;
+    {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) { perror("open"); return; }
+        SnapshotHeader header = {};
+        header.magic = SNAPSHOT_MAGIC;
+        header.version = SNAPSHOT_VERSION;
+        header.record_size = sizeof(SnapshotRecord);
+        header.state_size = sizeof(QubitState);
+        header.count = count;
+        header.saved_steady_ns = OpTimer::nowNs();
+        write(fd, &header, sizeof(header));
+        std::vector<SnapshotRecord> chunk(4096);
+        for (size_t base = 0; base < count; base += chunk.size()) {
+            for (size_t i = 0; i < chunk.size(); i++) {
+                SnapshotRecord& r = chunk[i];
+                std::memset(&r, 0, sizeof(r));
+                snprintf(r.name, sizeof(r.name), "bench_snap_%07zu", base + i);
+                r.state.alpha_real = r.state.beta_real = 1.0 / M_SQRT2;
+                r.state.measured = 2;
+                r.state.task_id = 1;
+            }
+            write(fd, chunk.data(), chunk.size() * sizeof(SnapshotRecord));
+        }
+        close(fd);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    QubitSnapshot snap = QubitSnapshot::restore(path);
+    auto t1 = std::chrono::steady_clock::now();
+    std::mt19937 gen(1);
+    char name[64];
+    size_t found = 0;
+    for (int i = 0; i < 10000; i++) {
+        snprintf(name, sizeof(name), "bench_snap_%07zu", size_t(gen() % count));
+        found += snap.find(name) != nullptr;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    double sum = 0;
+    for (size_t i = 0; i < snap.size(); i++) sum += snap[i].state.beta_real;
+    auto t3 = std::chrono::steady_clock::now();
+    size_t published = snap.publish("bench_snap_0000");
+    auto t4 = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    };
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "restore (map " << snap.size() << " qubits): " << ms(t1 - t0) << "ms\n";
+    std::cout << "10000 lookups by name: " << ms(t2 - t1) << "ms (" << found << " found)\n";
+    std::cout << "scan all states (faults file in): " << ms(t3 - t2) << "ms, sum " << std::setprecision(1) << sum << "\n";
+    std::cout << std::setprecision(3) << "publish " << published << " to shm: " << ms(t4 - t3) << "ms\n";
+    for (size_t i = 0; i < published; i++) shm_unlink(snap[i].name);
+    unlink(path.c_str());
+}
+
+// dTLB load misses of this thread, where the PMU is exposed (not in most VMs)
+class TlbMissCounter {
+public:
+    TlbMissCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~TlbMissCounter() { if (fd >= 0) close(fd); }
+    bool available() const { return fd >= 0; }
+    uint64_t read() const {
+        uint64_t v = 0;
+        if (fd >= 0 && ::read(fd, &v, sizeof(v)) != sizeof(v)) v = 0;
+        return v;
+    }
+private:
+    int fd;
+};
+
+static long minorFaults() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_minflt;
+}
+
+// First touch and random access over a 1M-qubit arena on each backing store
+void bench_arena_backing() {
+    std::cout << "\n===== BENCH 5: ARENA BACKING STORES =====\n";
+    const size_t n = 1 << 20;
+    const size_t touches = 2000000;
+    TlbMissCounter tlb;
+    std::cout << std::left << std::setw(18) << "backing" << std::right << std::setw(10) << "map ms"
+              << std::setw(12) << "touch ms" << std::setw(12) << "faults"
+              << std::setw(16) << "random Mops/s" << std::setw(14) << "dTLB misses" << "\n";
+
+    struct Config { const char* label; ArenaBacking backing; bool populate; };
+    const Config configs[] = {
+        {"shm", ARENA_SHM, false},
+        {"shm+populate", ARENA_SHM, true},
+        {"file", ARENA_FILE, false},
+        {"file+populate", ARENA_FILE, true},
+        {"hugetlb", ARENA_HUGETLB, false},
+        {"hugetlb+populate", ARENA_HUGETLB, true},
+    };
+    bool fell_back = false;
+    for (const Config& c : configs) {
+        ArenaOptions opts;
+        opts.backing = c.backing;
+        opts.populate = c.populate;
+        if (c.backing == ARENA_FILE) opts.path = "/tmp/bench_arena.qarena";
+
+        auto t0 = std::chrono::steady_clock::now();
+        QubitArena arena("bench_arena", 1, n, opts);
+        auto t1 = std::chrono::steady_clock::now();
+        long faults = minorFaults();
+        QubitState* s = arena.data();
+        for (size_t i = 0; i < n; i++) {
+            s[i].alpha_real = 1.0;
+            s[i].measured = 2;
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        faults = minorFaults() - faults;
+
+        std::mt19937 gen(3);
+        uint64_t misses = tlb.read();
+        auto t3 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < touches; i++) applyGateToState(s[gen() & (n - 1)], 'H');
+        auto t4 = std::chrono::steady_clock::now();
+        misses = tlb.read() - misses;
+
+        auto ms = [](std::chrono::steady_clock::duration d) {
+            return std::chrono::duration<double, std::milli>(d).count();
+        };
+        std::string label = c.label;
+        if (arena.backing() != c.backing) { label += "*"; fell_back = true; }
+        std::cout << std::left << std::setw(18) << label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << ms(t1 - t0) << std::setw(12) << ms(t2 - t1)
+                  << std::setw(12) << faults << std::setw(16) << touches / ms(t4 - t3) / 1000.0;
+        if (tlb.available()) std::cout << std::setw(14) << misses;
+        else std::cout << std::setw(14) << "n/a";
+        std::cout << "\n";
+        arena.unlink();
+    }
+    if (fell_back) std::cout << "* no huge pages reserved (vm.nr_hugepages), fell back to shm\n";
+}
+
+// Whole-arena gate sweeps by node-pinned workers under each placement.
+// Run once plain and once under numactl to compare with the OS policy.
+void bench_numa() {
+    std::cout << "\n===== BENCH 6: NUMA PLACEMENT =====\n";
+    const NumaTopology& topo = NumaTopology::get();
+    NumaWorkers workers;
+    std::cout << topo.nodeCount() << " node(s), " << workers.size() << " pinned workers\n";
+    const size_t n = 1 << 20;
+    const int sweeps = 10;
+
+    struct Config { const char* label; ArenaNuma numa; };
+    const Config configs[] = {
+        {"default (main thread)", NUMA_DEFAULT},
+        {"interleave", NUMA_INTERLEAVE},
+        {"first-touch by workers", NUMA_FIRST_TOUCH},
+    };
+    for (const Config& c : configs) {
+        ArenaOptions opts;
+        opts.numa = c.numa;
+        QubitArena arena("bench_numa", 1, n, opts);
+        if (c.numa == NUMA_FIRST_TOUCH) arena.firstTouch(workers);
+        QubitState* s = arena.data();
+        for (size_t i = 0; i < n; i++) {  // default: every page lands on this thread's node
+            s[i].alpha_real = 1.0;
+            s[i].measured = 2;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < sweeps; r++) arena.applyGateAll('H', workers);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::left << std::setw(26) << c.label << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(10) << secs * 1000 / sweeps << " ms/sweep"
+                  << std::setw(10) << double(n) * sweeps / secs / 1e6 << " Mqubits/s\n";
+        arena.unlink();
+    }
+}
+
+// Collapses per second through two bridges on loopback
+void bench_bridge() {
+    std::cout << "\n===== BENCH 7: CROSS-NODE BRIDGE =====\n";
+    std::string node_a = "bA" + std::to_string(getpid() % 100000);
+    std::string node_b = "bB" + std::to_string(getpid() % 100000);
+    int port = 20000 + getpid() % 20000;
+    BridgeOptions a_opts, b_opts;
+    a_opts.node = node_a;
+    a_opts.listen = "127.0.0.1:" + std::to_string(port);
+    a_opts.peers[node_b] = "127.0.0.1:" + std::to_string(port + 1);
+    b_opts.node = node_b;
+    b_opts.listen = a_opts.peers[node_b];
+    b_opts.peers[node_a] = a_opts.listen;
+    setenv("QUBIT_NODE", node_a.c_str(), 1);
+    pid_t bridge_a = spawnBridge(a_opts);
+    pid_t bridge_b = spawnBridge(b_opts);
+    BridgePage* page_a = waitForBridge(node_a);
+    BridgePage* page_b = waitForBridge(node_b);
+    if (!page_a || !page_b) {
+        std::cout << "bridges did not start\n";
+    } else {
+        // Targets on node B; these constructors start no decoherence thread
+        const int targets = 64;
+        std::vector<std::string> links;
+        std::vector<std::unique_ptr<Qubit>> qubits;
+        for (int i = 0; i < targets; i++) {
+            std::string name = "bench_remote" + std::to_string(i);
+            qubits.emplace_back(new Qubit(name, 1, Relaxation{0.0, 0.0}));
+            qubits.back()->setState(1.0, 0.0, 0.0, 0.0);
+            links.push_back(node_b + ":" + name);
+        }
+        const uint64_t total = 200000;
+        uint64_t full = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < total; i++) {
+            while (!RemoteLinks::post(links[i % targets].c_str(), 0)) {
+                full++;
+                std::this_thread::yield();
+            }
+        }
+        while (page_b->counters.applied.load() + page_b->counters.conflicts.load() < total)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        OpSummary lat = bridgeLatency(page_b->counters);
+        uint64_t frames = page_a->counters.frames_sent.load();
+        std::cout << std::fixed << std::setprecision(0) << total / secs << " collapses/s applied on "
+                  << node_b << ", " << std::setprecision(1) << double(total) / frames << " collapses/frame, "
+                  << page_a->counters.retransmits.load() << " retransmits, " << full << " outbox-full retries\n";
+        std::cout << "latency origin -> applied: p50 " << lat.percentile(0.5) / 1000.0 << "us, p99 "
+                  << lat.percentile(0.99) / 1000.0 << "us, max " << lat.max_ns / 1000.0 << "us\n";
+        for (int i = 0; i < targets; i++) shm_unlink(("bench_remote" + std::to_string(i)).c_str());
+    }
+    stopBridge(bridge_a);
+    stopBridge(bridge_b);
+    unsetenv("QUBIT_NODE");
+    shm_unlink(bridgeShmName(node_a).c_str());
+    shm_unlink(bridgeShmName(node_b).c_str());
+}
+
+void bench_server() {
+    std::cout << "\n===== BENCH 8: QUBIT SERVER =====\n";
+    std::cout << std::left << std::setw(28) << "operation" << std::right << std::setw(20) << "shm Qubit"
+              << std::setw(20) << "server" << std::setw(9) << "speedup\n";
+    ServerOptions opts;
+    opts.name = "bench_server_" + std::to_string(getpid());
+    pid_t server = spawnServer(opts);
+    {
+        QubitClient client(opts.name);
+        if (!client.connected()) {
+            std::cout << "server did not start\n";
+        } else {
+            const int targets = 64;
+            std::vector<uint32_t> handles;
+            for (int i = 0; i < targets; i++) handles.push_back(uint32_t(client.open("bench_srv" + std::to_string(i))));
+            std::vector<std::unique_ptr<Qubit>> qubits;
+            for (int i = 0; i < targets; i++) {
+                qubits.emplace_back(new Qubit("bench_direct" + std::to_string(i), 1, Relaxation{0.0, 0.0}));
+                qubits.back()->setState(1.0, 0.0, 0.0, 0.0);
+                client.setState(handles[i], 1.0, 0.0, 0.0, 0.0);
+            }
+
+            // Pipelined: keep the ring full, reap completions as they come
+            auto pipelined = [&](uint64_t total, std::function<ServerCommand(uint64_t)> make) {
+                uint64_t submitted = 0, completed = 0;
+                ServerCompletion done[SERVER_BATCH];
+                auto start = std::chrono::steady_clock::now();
+                while (completed < total) {
+                    while (submitted < total && client.submit(make(submitted))) submitted++;
+                    client.flush();
+                    size_t n = client.poll(done, SERVER_BATCH);
+                    completed += n;
+                    if (!n) std::this_thread::yield();
+                }
+                return total / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            };
+
+            const uint64_t total = 2000000;
+            int i = 0;
+            double direct = opsPerSec(total / 10, 1, [&] { qubits[i++ % targets]->applyGate('H'); });
+            double served = pipelined(total, [&](uint64_t k) { return QubitClient::gateCmd(handles[k % targets], 'H'); });
+            report("applyGate (pipelined)", direct, served);
+
+            i = 0;
+            direct = opsPerSec(total / 10, 1, [&] {
+                qubits[i % targets]->setState(1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+                qubits[i++ % targets]->measure();
+            });
+            served = pipelined(total, [&](uint64_t k) {
+                return k % 2 ? QubitClient::measureCmd(handles[(k / 2) % targets])
+                             : QubitClient::setStateCmd(handles[(k / 2) % targets], 1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0);
+            }) / 2;
+            report("setState+measure", direct, served);
+
+            i = 0;
+            direct = opsPerSec(20000, 1, [&] { qubits[i++ % targets]->applyGate('H'); });
+            served = opsPerSec(20000, 1, [&] { client.applyGate(handles[i++ % targets], 'H'); });
+            report("applyGate (round trip)", direct, served);
+
+            ServerPage* page = static_cast<ServerPage*>(mapShmSegment(opts.name, sizeof(ServerPage), false));
+            std::cout << std::fixed << std::setprecision(1) << "mean server batch "
+                      << double(page->commands.load()) / page->batches.load() << " commands\n";
+            munmap(page, sizeof(ServerPage));
+            for (int k = 0; k < targets; k++) shm_unlink(("bench_direct" + std::to_string(k)).c_str());
+        }
+    }
+    stopServer(server);
+    shm_unlink(opts.name.c_str());
+}
+
+// Batched arena calls against one call per qubit, over 1M qubits
+void bench_arena_batch() {
+    std::cout << "\n===== BENCH 9: BATCH ARENA OPERATIONS (1M QUBITS) =====\n";
+    std::cout << std::left << std::setw(28) << "operation" << std::right << std::setw(20) << "per call"
+              << std::setw(20) << "batched" << std::setw(9) << "speedup\n";
+    const size_t n = 1 << 20;
+    QubitArena arena("bench_batch", 1, n);
+    std::vector<uint32_t> seq(n), shuffled(n);
+    for (size_t i = 0; i < n; i++) seq[i] = shuffled[i] = uint32_t(i);
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(5));
+    std::vector<double> amps(4 * n, 0.0);
+    for (size_t i = 0; i < n; i++) amps[4 * i] = amps[4 * i + 2] = 1.0 / M_SQRT2;
+    std::vector<uint8_t> results(n);
+    arena.setStates(seq.data(), n, amps.data());  // fault everything in
+
+    struct Order { const char* label; const std::vector<uint32_t>* handles; };
+    const Order orders[] = {{"sequential", &seq}, {"shuffled", &shuffled}};
+    for (const Order& o : orders) {
+        const uint32_t* h = o.handles->data();
+        std::string suffix = std::string(" (") + o.label + ")";
+        size_t i = 0;
+        double single = opsPerSec(int(n), 1, [&] {
+            const double* a = &amps[4 * i];
+            arena.setState(h[i], a[0], a[1], a[2], a[3]);
+            i = (i + 1) % n;
+        });
+        double batched = opsPerSec(1, int(n), [&] { arena.setStates(h, n, amps.data()); });
+        report("setState" + suffix, single, batched);
+
+        single = opsPerSec(int(n), 1, [&] { arena.applyGate(h[i], 'H'); i = (i + 1) % n; });
+        batched = opsPerSec(1, int(n), [&] { arena.applyGates(h, n, 'H'); });
+        report("applyGate" + suffix, single, batched);
+
+        // Each timed run measures a fresh superposition
+        auto reset = [&] { arena.setStates(seq.data(), n, amps.data()); };
+        double best_single = 0, best_batched = 0;
+        for (int r = 0; r < 3; r++) {
+            reset();
+            auto start = std::chrono::steady_clock::now();
+            for (size_t k = 0; k < n; k++) results[k] = arena.measure(h[k]);
+            best_single = std::max(best_single, n / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            reset();
+            start = std::chrono::steady_clock::now();
+            arena.measureMany(h, n, results.data());
+            best_batched = std::max(best_batched, n / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        report("measure" + suffix, best_single, best_batched);
+    }
+    arena.unlink();
+}
+
+// H over every qubit: QubitState array vs SoA arrays, scalar and SIMD
+void bench_soa() {
+    std::cout << "\n===== BENCH 10: STRUCTURE-OF-ARRAYS GATE SWEEPS (2M QUBITS) =====\n";
+    const size_t n = 1 << 21;
+    const int sweeps = 10;
+    QubitArena aos("bench_soa_aos", 1, n);
+    QubitSoaArena soa("bench_soa", 1, n);
+    for (size_t i = 0; i < n; i++) {
+        aos[i].alpha_real = 1.0;
+        aos[i].measured = 2;
+        soa.setState(i, 1.0, 0.0, 0.0, 0.0);
+    }
+    const SoaView& v = soa.view();
+
+    struct Config { const char* label; std::function<void()> sweep; };
+    std::vector<Config> configs = {
+        {"QubitArena (AoS)", [&] { for (size_t i = 0; i < n; i++) if (aos[i].measured == 2) applyGateToState(aos[i], 'H'); }},
+        {"SoA scalar", [&] { soaGateScalar(v, 0, n, 'H'); }},
+    };
+#ifdef QUBIT_HAS_AVX512_KERNELS
+    if (soaHasAvx512()) configs.push_back({"SoA avx512", [&] { soaGateAvx512(v, 0, n, 'H'); }});
+#endif
+    double base = 0;
+    for (const Config& c : configs) {
+        c.sweep();  // warm
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < sweeps; r++) c.sweep();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rate = double(n) * sweeps / secs;
+        if (base == 0) base = rate;
+        std::cout << std::left << std::setw(20) << c.label << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << secs * 1000 / sweeps << " ms/sweep" << std::setw(10) << rate / 1e6
+                  << " Mqubits/s" << std::setw(8) << rate / base << "x\n";
+    }
+    aos.unlink();
+    soa.unlink();
+}
+
+// Collapse 4M superpositions: measure() per qubit vs the bulk kernels
+void bench_bulk_measure() {
+    std::cout << "\n===== BENCH 11: BULK MEASUREMENT (4M QUBITS) =====\n";
+    const size_t n = 1 << 22;
+    QubitSoaArena soa("bench_bulk", 1, n);
+    const SoaView& v = soa.view();
+    std::vector<uint64_t> bits(n / 64);
+    auto reset = [&] {
+        for (size_t i = 0; i < n; i++) {
+            v.alpha_re[i] = v.beta_re[i] = 1.0 / M_SQRT2;
+            v.alpha_im[i] = v.beta_im[i] = 0.0;
+            v.measured[i] = 2;
+        }
+    };
+
+    struct Config { const char* label; std::function<void()> run; };
+    std::vector<Config> configs = {
+        {"measure() per qubit", [&] { for (size_t i = 0; i < n; i++) soa.measure(i); }},
+        {"bulk scalar", [&] { soaMeasureScalar(v, 0, n, 99, bits.data()); }},
+    };
+#ifdef QUBIT_HAS_AVX512_KERNELS
+    if (soaHasAvx512()) configs.push_back({"bulk avx512", [&] { soaMeasureAvx512(v, 0, n, 99, bits.data()); }});
+#endif
+    double base = 0;
+    for (const Config& c : configs) {
+        double best = 0;
+        for (int r = 0; r < 3; r++) {
+            reset();
+            auto start = std::chrono::steady_clock::now();
+            c.run();
+            best = std::max(best, n / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        if (base == 0) base = best;
+        std::cout << std::left << std::setw(22) << c.label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << best / 1e6 << " M measurements/s" << std::setw(8) << best / base << "x\n";
+    }
+    size_t ones = 0;
+    for (uint64_t w : bits) ones += __builtin_popcountll(w);
+    std::cout << "last run: " << ones << " of " << n << " measured |1>\n";
+    soa.unlink();
+}
+
+void bench_normalize() {
+    std::cout << "\n===== BENCH 12: STATE INGEST WITH NORMALIZATION (4M QUBITS) =====\n";
+    const size_t n = 1 << 22;
+    QubitSoaArena soa("bench_normalize", 1, n);
+    const SoaView& v = soa.view();
+    std::vector<double> amps(4 * n);
+    for (size_t i = 0; i < n; i++) {  // unnormalized: every state needs rescaling
+        amps[4 * i] = 1.0 + (i % 7);
+        amps[4 * i + 3] = 1.0 + (i % 5);
+    }
+
+    NormPolicy report_only;
+    report_only.action = NORM_REPORT;
+
+    struct Config { const char* label; std::function<void()> run; };
+    std::vector<Config> configs = {
+        {"setStateNormalized()", [&] {
+            for (size_t i = 0; i < n; i++) {
+                const double* a = &amps[4 * i];
+                soa.setStateNormalized(i, a[0], a[1], a[2], a[3]);
+            }
+        }},
+        {"copy, no check", [&] {
+            for (size_t i = 0; i < n; i++) {
+                const double* a = &amps[4 * i];
+                v.alpha_re[i] = a[0]; v.alpha_im[i] = a[1];
+                v.beta_re[i] = a[2];  v.beta_im[i] = a[3];
+            }
+            std::memset(v.measured, 2, n);
+        }},
+        {"loadStates()", [&] { soa.loadStates(0, n, amps.data()); }},
+        {"normalize, scalar", [&] { soaNormalizeScalar(v, 0, n, NormPolicy()); }},
+        {"normalizeStates()", [&] { soa.normalizeStates(0, n); }},
+    };
+    for (const Config& c : configs) {
+        double best = 0;
+        for (int r = 0; r < 3; r++) {
+            soa.loadStates(0, n, amps.data(), report_only);
+            auto start = std::chrono::steady_clock::now();
+            c.run();
+            best = std::max(best, n / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::cout << std::left << std::setw(22) << c.label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << best / 1e6 << " M states/s" << std::setw(8) << best * 32 / 1e9 << " GB/s\n";
+    }
+    NormReport check = soa.normalizeStates(0, n, report_only);
+    std::cout << soaKernelName() << " kernel, " << check.out_of_tolerance << " states left out of tolerance\n";
+    soa.unlink();
+}
+
+// Standard single-qubit circuits on float and double SoA arenas: sweep
+// rate of each and how far the float states drift from the double ones
+void bench_float_precision() {
+    std::cout << "\n===== BENCH 13: FLOAT VS DOUBLE AMPLITUDES (1M QUBITS) =====\n";
+    const size_t n = 1 << 20;
+    QubitSoaArena d("bench_prec_double", 1, n);
+    FloatSoaArena f("bench_prec_float", 1, n);
+    std::cout << "bytes per qubit: double " << d.bytes() / double(n) << ", float " << f.bytes() / double(n)
+              << ", gate kernel " << soaKernelName() << "\n";
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> u(-1.0, 1.0);
+    std::vector<double> amps(4 * n);
+    for (double& a : amps) a = u(gen);
+    for (size_t i = 0; i < n; i++)  // unit states for both, so only float rounding differs
+        normalizeAmplitudes(amps[4 * i], amps[4 * i + 1], amps[4 * i + 2], amps[4 * i + 3]);
+
+    std::string clifford_t;
+    for (int i = 0; i < 64; i++) clifford_t += "HTSXZ"[gen() % 5];
+    std::string deep;
+    for (int i = 0; i < 1000; i++) deep += "HT";
+    struct Circuit { const char* label; std::string gates; };
+    std::vector<Circuit> circuits = {
+        {"H", "H"},
+        {"HTH", "HTH"},
+        {"HSHZ", "HSHZ"},
+        {"random Clifford+T 64", clifford_t},
+        {"HT x 1000", deep},
+    };
+
+    std::cout << std::left << std::setw(22) << "circuit" << std::right << std::setw(12) << "double"
+              << std::setw(12) << "float" << std::setw(9) << "speedup" << std::setw(13) << "max |damp|"
+              << std::setw(13) << "max |1 - F|" << "\n";
+    for (const Circuit& c : circuits) {
+        d.loadStates(0, n, amps.data());
+        f.loadStates(0, n, amps.data());
+        double rate[2];
+        for (int k = 0; k < 2; k++) {
+            auto start = std::chrono::steady_clock::now();
+            for (char g : c.gates) {
+                if (k == 0) d.applyGateAll(g);
+                else f.applyGateAll(g);
+            }
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            rate[k] = double(n) * c.gates.size() / secs;
+        }
+        double max_err = 0, worst = 0;
+        for (size_t i = 0; i < n; i++) {
+            QubitState a = d.readState(i), b = f.readState(i);
+            max_err = std::max({max_err, std::fabs(a.alpha_real - b.alpha_real), std::fabs(a.alpha_imag - b.alpha_imag),
+                                std::fabs(a.beta_real - b.beta_real), std::fabs(a.beta_imag - b.beta_imag)});
+            worst = std::max(worst, std::fabs(1.0 - stateFidelity(a, b)));
+        }
+        std::cout << std::left << std::setw(22) << c.label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << rate[0] / 1e6 << std::setw(12) << rate[1] / 1e6 << std::setw(8)
+                  << rate[1] / rate[0] << "x" << std::scientific << std::setprecision(2) << std::setw(13) << max_err
+                  << std::setw(13) << worst << std::defaultfloat << "\n";
+    }
+    std::cout << "(rates in M qubit-gates/s)\n";
+    d.unlink();
+    f.unlink();
+}
+
+// setState, H, T, H, measure on one qubit, best of three, in ops/s
+template <class Q>
+static double policyLoopRate(Q& q, int iters) {
+    double best = 0;
+    uint64_t ones = 0;
+    for (int r = 0; r < 3; r++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iters; i++) {
+            q.setState(1.0, 0.0, 0.0, 0.0);
+            q.applyGate('H');
+            q.applyGate('T');
+            q.applyGate('H');
+            ones += q.measure();
+        }
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, double(iters) * 5 / s);
+    }
+    if (ones == uint64_t(-1)) std::cout << "";  // keep the results live
+    return best;
+}
+
+void bench_qubit_policies() {
+    std::cout << "\n===== BENCH 14: BasicQubit POLICY VARIANTS =====\n";
+    const int iters = 200000;
+    struct Row { const char* label; double rate; };
+    std::vector<Row> rows;
+    {
+        Qubit q("bench_policy_qubit", 1);
+        rows.push_back({"Qubit (shm, mutex, thread)", policyLoopRate(q, iters)});
+    }
+    {
+        BasicQubit<ShmStorage, SpinLock, ThreadDecoherence, 4> q("bench_policy_spin", 1);
+        rows.push_back({"shm, spin lock, thread", policyLoopRate(q, iters)});
+    }
+    {
+        BasicQubit<ShmStorage, std::mutex, NoDecoherence, 4> q("bench_policy_nodecay", 1);
+        rows.push_back({"shm, mutex, no decoherence", policyLoopRate(q, iters)});
+    }
+    {
+        BasicQubit<LocalStorage, std::mutex, ThreadDecoherence, 4> q("bench_policy_local", 1);
+        rows.push_back({"local, mutex, thread", policyLoopRate(q, iters)});
+    }
+    {
+        SimQubit q("bench_policy_sim", 1);
+        rows.push_back({"SimQubit (local, none, 0)", policyLoopRate(q, iters)});
+    }
+    for (const Row& r : rows)
+        std::cout << std::left << std::setw(30) << r.label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << r.rate / 1e6 << " M ops/s" << std::setprecision(2) << std::setw(8)
+                  << r.rate / rows[0].rate << "x\n";
+    shm_unlink("bench_policy_qubit");
+    shm_unlink("bench_policy_spin");
+    shm_unlink("bench_policy_nodecay");
+}
+
+// A fixed six-gate chain as six applyGate() calls vs one compile-time Seq
+template <class Q>
+static void fusedChainRow(const char* label, Q& q, int iters) {
+    using namespace gates;
+    double stepwise = opsPerSec(iters, 1, [&] {
+        q.setState(1.0, 0.0, 0.0, 0.0);
+        for (char g : {'X', 'Z', 'H', 'T', 'S', 'H'}) q.applyGate(g);
+    });
+    double fused = opsPerSec(iters, 1, [&] {
+        q.setState(1.0, 0.0, 0.0, 0.0);
+        q.template apply<Seq<X, Z, H, T, S, H>>();
+    });
+    std::cout << std::left << std::setw(12) << label << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << stepwise / 1e6 << std::setw(12) << fused / 1e6 << std::setprecision(2)
+              << std::setw(8) << fused / stepwise << "x\n";
+}
+
+void bench_gate_fusion() {
+    std::cout << "\n===== BENCH 15: COMPILE-TIME GATE SEQUENCES =====\n";
+    std::cout << std::left << std::setw(12) << "qubit" << std::right << std::setw(12) << "6 calls" << std::setw(12)
+              << "Seq<...>" << "   (M chains/s)\n";
+    {
+        Qubit q("bench_fusion_qubit", 1);
+        fusedChainRow("Qubit", q, 200000);
+    }
+    shm_unlink("bench_fusion_qubit");
+    SimQubit sim("bench_fusion_sim", 1);
+    fusedChainRow("SimQubit", sim, 2000000);
+}
+
+// <Z> from 10000 measure() shots vs from the amplitudes, the <X>, <Y>, <Z>
+// kernels, and a 64K-qubit Hamiltonian one string at a time vs batched
+void bench_pauli_expectation() {
+    std::cout << "\n===== BENCH 16: PAULI EXPECTATION VALUES =====\n";
+    const int shots = 10000;
+    SimQubit q("bench_pauli_sim", 1);
+    double estimate = 0;
+    double sampled = opsPerSec(1, 1, [&] {
+        int ones = 0;
+        for (int k = 0; k < shots; k++) {
+            q.setState(std::cos(0.3), 0.0, std::sin(0.3), 0.0);
+            ones += q.measure();
+        }
+        estimate = 1.0 - 2.0 * ones / shots;
+    });
+    q.setState(std::cos(0.3), 0.0, std::sin(0.3), 0.0);
+    double exact = 0;
+    double analytic = opsPerSec(100000, 1, [&] { exact += q.expectation(PAULI_Z); });
+    exact = q.expectation(PAULI_Z);
+    std::cout << std::fixed << std::setprecision(1) << shots << " shots: " << 1e6 / sampled << " us, <Z> ~ "
+              << std::setprecision(4) << estimate << " (error " << std::fabs(estimate - exact) << ")\n"
+              << "expectation(): " << std::setprecision(1) << 1e9 / analytic << " ns, <Z> = "
+              << std::setprecision(4) << exact << "\n";
+
+    // The kernels block by block, as expectations() runs them
+    const size_t n = 1 << 16;
+    QubitSoaArena soa("bench_pauli", 1, n);
+    for (size_t i = 0; i < n; i++) {
+        double t = 1e-4 * i;
+        soa.setState(i, std::cos(t), 0.0, std::sin(t), 0.0);
+    }
+    const SoaView& v = soa.view();
+    double table[3 * PAULI_BLOCK];
+    auto blocks = [&](void (*kernel)(const SoaView&, size_t, size_t, double*, double*, double*)) {
+        for (size_t b = 0; b < n; b += PAULI_BLOCK)
+            kernel(v, b, b + PAULI_BLOCK, table, table + PAULI_BLOCK, table + 2 * PAULI_BLOCK);
+    };
+    std::vector<std::pair<const char*, double>> kernels;
+    kernels.push_back({"kernel scalar", opsPerSec(20, int(n), [&] { blocks(soaPauliScalar<double>); })});
+#ifdef QUBIT_HAS_AVX512_KERNELS
+    if (soaHasAvx512()) kernels.push_back({"kernel avx512", opsPerSec(20, int(n), [&] { blocks(soaPauliAvx512); })});
+#endif
+    for (size_t k = 0; k < kernels.size(); k++)
+        std::cout << std::left << std::setw(22) << kernels[k].first << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << kernels[k].second / 1e6 << " M qubits/s" << std::setprecision(2)
+                  << std::setw(8) << kernels[k].second / kernels[0].second << "x\n";
+
+    // A nearest-neighbour Hamiltonian: XX, YY, ZZ on every bond and Z on every qubit
+    std::vector<PauliString> strings;
+    size_t terms = 0;
+    for (size_t i = 0; i + 1 < n; i++) {
+        for (const char* op : {"XX", "YY", "ZZ"}) strings.push_back(PauliString(op, i));
+        strings.push_back(PauliString("Z", i));
+        terms += 7;
+    }
+    std::vector<double> out;
+    double single = opsPerSec(1, int(terms), [&] {
+        out.clear();
+        for (const PauliString& p : strings) out.push_back(soa.expectation(p));
+    }, 5);
+    double batched = opsPerSec(1, int(terms), [&] { out = soa.expectations(strings); }, 5);
+    std::cout << strings.size() << " strings, " << terms << " terms:\n"
+              << std::left << std::setw(22) << "expectation() each" << std::right << std::setprecision(1)
+              << std::setw(10) << single / 1e6 << " M terms/s\n"
+              << std::left << std::setw(22) << "expectations()" << std::right << std::setw(10) << batched / 1e6
+              << " M terms/s" << std::setprecision(2) << std::setw(8) << batched / single << "x\n";
+    soa.unlink();
+}
+
+// ns per read of each clock, and the setState/H/T/H/measure loop with that
+// clock stamping every op (no latency stats, so the stamp is what differs)
+template <class Clock>
+static void clockRow(const char* label, const char* shm) {
+    const int reads = 2000000;
+    double rate = opsPerSec(reads, 1, [] { Clock::nowNs(); });
+    double loop;
+    {
+        BasicQubit<ShmStorage, std::mutex, ThreadDecoherence, 4, NullTimer, Clock> q(shm, 1);
+        loop = policyLoopRate(q, 200000);
+    }
+    shm_unlink(shm);
+    std::cout << std::left << std::setw(14) << label << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << 1e9 / rate << " ns" << std::setw(12) << loop / 1e6 << " M ops/s\n";
+}
+
+void bench_clocks() {
+    std::cout << "\n===== BENCH 17: CLOCK SOURCES =====\n";
+    std::cout << std::left << std::setw(14) << "clock" << std::right << std::setw(11) << "read"
+              << std::setw(20) << "qubit loop" << "\n";
+    clockRow<SteadyClock>("steady", "bench_clock_steady");
+    clockRow<CoarseClock>("coarse", "bench_clock_coarse");
+    clockRow<TscClock>("tsc", "bench_clock_tsc");
+    clockRow<VirtualClock>("virtual", "bench_clock_virtual");
+}
+
+// 64 qubits with timeouts of 20-83 ms left to decohere: how late each
+// collapse was, and how often their threads woke while collapsed
+void bench_decoherence_jitter() {
+    std::cout << "\n===== BENCH 18: DECOHERENCE DEADLINE JITTER =====\n";
+    const int n = 64;
+    std::vector<std::unique_ptr<Qubit>> qubits;
+    for (int i = 0; i < n; i++) {
+        qubits.emplace_back(new Qubit("bench_jitter" + std::to_string(i), 1, 20 + i));
+        qubits.back()->initSuperposition();
+    }
+    for (int waited = 0; waited < 1000; waited++) {
+        bool all = true;
+        for (auto& q : qubits) all &= q->isMeasured();
+        if (all) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::vector<double> late;
+    uint64_t wakeups = 0;
+    for (auto& q : qubits) {
+        late.push_back(q->decoherencePolicy().late_max_ns.load() / 1e3);
+        wakeups += q->decoherencePolicy().wakeups.load();
+    }
+    std::sort(late.begin(), late.end());
+    std::cout << std::fixed << std::setprecision(1) << n << " collapses, wakeup past deadline: p50 "
+              << late[n / 2] << " us, p99 " << late[n * 99 / 100] << " us, max " << late[n - 1] << " us; "
+              << double(wakeups) / n << " wakeups per collapse\n";
+
+    uint64_t before = 0, after = 0;
+    for (auto& q : qubits) before += q->decoherencePolicy().wakeups.load();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    for (auto& q : qubits) after += q->decoherencePolicy().wakeups.load();
+    std::cout << "collapsed qubits idle for 1 s: " << after - before << " wakeups (a 100 ms poll: " << n * 10
+              << ")\n";
+    qubits.clear();
+    for (int i = 0; i < n; i++) shm_unlink(("bench_jitter" + std::to_string(i)).c_str());
+}
+
+int main() {
+    std::cout << "===== QUBIT THROUGHPUT BENCHMARKS =====\n";
+    bench_circuit();
+    bench_optimizer();
+    bench_trajectories();
+    bench_snapshot();
+    bench_arena_backing();
+    bench_numa();
+    bench_bridge();
+    bench_server();
+    bench_arena_batch();
+    bench_soa();
+    bench_bulk_measure();
+    bench_normalize();
+    bench_float_precision();
+    bench_qubit_policies();
+    bench_gate_fusion();
+    bench_pauli_expectation();
+    bench_clocks();
+    bench_decoherence_jitter();
+    return 0;
+}
@@ -0,0 +1,77 @@
+// qubit_bridge: carry collapses on "node:qubit" links between hosts.
+//
+//   g++ -std=c++11 -O2 -pthread -o qubit_bridge qubit_bridge.cpp
+//   ./qubit_bridge -n A -l 0.0.0.0:7400 -p B=10.0.0.2:7400 [-p C=...] [-i interval_ms]
+//
+// Qubits on this host reach the bridge when run with QUBIT_NODE=<node>.
+// Every interval the bridge prints its rates, retransmits and the latency
+// of collapses it applied (origin to applied; meaningful on one host or with
+// synchronized clocks).
+
+#include "qubit_bridge.h"
+
+#include <sstream>
+
+static void usage() {
+    std::cerr << "usage: qubit_bridge -n node -l host:port -p node=host:port [-p ...]\n"
+              << "                    [-i interval_ms] [-r rto_us]\n";
+}
+
+static std::string fmtUs(uint64_t ns) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1) << ns / 1e3 << "us";
+    return os.str();
+}
+
+int main(int argc, char** argv) {
+    BridgeOptions opts;
+    int interval_ms = 1000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) { usage(); return 1; }
+        std::string val = argv[++i];
+        if (arg == "-n") opts.node = val;
+        else if (arg == "-l") opts.listen = val;
+        else if (arg == "-i") interval_ms = std::atoi(val.c_str());
+        else if (arg == "-r") opts.rto_us = uint32_t(std::atoi(val.c_str()));
+        else if (arg == "-p" && val.find('=') != std::string::npos)
+            opts.peers[val.substr(0, val.find('='))] = val.substr(val.find('=') + 1);
+        else { usage(); return 1; }
+    }
+    if (opts.peers.empty() || opts.node.size() >= BRIDGE_NODE_LEN) { usage(); return 1; }
+
+    signal(SIGTERM, [](int) { bridgeStopFlag().store(true); });
+    signal(SIGINT, [](int) { bridgeStopFlag().store(true); });
+    QubitBridge bridge(opts);
+    std::cout << "bridge " << opts.node << " on " << opts.listen << ", outbox "
+              << bridgeShmName(opts.node) << std::endl;
+
+    std::thread reporter([&] {
+        BridgeCounters& c = bridge.counters();
+        uint64_t prev_sent = 0, prev_applied = 0;
+        while (!bridgeStopFlag().load()) {
+            for (int waited = 0; waited < interval_ms && !bridgeStopFlag().load(); waited += 10)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            uint64_t sent = c.sent.load(), applied = c.applied.load();
+            uint64_t frames = c.frames_sent.load();
+            static OpSummary lat;
+            lat = bridgeLatency(c);
+            double secs = interval_ms / 1000.0;
+            std::cout << "sent " << std::fixed << std::setprecision(0) << (sent - prev_sent) / secs << "/s"
+                      << "  applied " << (applied - prev_applied) / secs << "/s"
+                      << "  frames " << frames << " (" << std::setprecision(1)
+                      << (frames ? double(sent + c.retransmits.load()) / frames : 0.0) << "/frame)"
+                      << "  retransmits " << c.retransmits.load()
+                      << "  conflicts " << c.conflicts.load()
+                      << "  missing " << c.missing.load()
+                      << "  dropped " << c.dropped.load()
+                      << "  p50 " << fmtUs(lat.percentile(0.5))
+                      << "  p99 " << fmtUs(lat.percentile(0.99)) << std::endl;
+            prev_sent = sent;
+            prev_applied = applied;
+        }
+    });
+    bridge.run(bridgeStopFlag());
+    reporter.join();
+    return 0;
+}
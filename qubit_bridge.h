@@ -0,0 +1,420 @@
+#pragma once
+
+// UDP bridge that carries collapses across nodes.
+//
+// Each host runs one bridge per node name. The bridge owns the node's
+// outbox page (qubit_remote.h), drains it, and sends the queued collapses to
+// the peer bridges as DATA frames of up to BRIDGE_FRAME_ENTRIES entries;
+// whatever is queued when the bridge wakes goes out together, so frames
+// fill up under load and single collapses go out at once when idle.
+//
+// Delivery is go-back-N per peer: every collapse gets the next sequence
+// number for its destination, at most BRIDGE_WINDOW are in flight, the
+// receiver applies entries strictly in order and answers each frame with a
+// cumulative ACK, and the sender resends the window if no ACK arrives for
+// `rto_us`. Collapses wait for their ACK in the peer's queue in the bridge
+// page (BridgePeerQueue), up to BRIDGE_PEER_QUEUE per peer. When a queue is
+// full, as while a peer is down for long, the bridge stops draining and the
+// backlog stays in the outbox; once that fills too, post() fails.
+//
+// Frames carry the sender's epoch, drawn at startup, and its oldest unacked
+// seq. A receiver seeing a new epoch (the sender restarted, or the receiver
+// did and lost its state) resumes from that oldest seq, and a restarted
+// sender picks its queues up from the page, so nothing unacked is lost.
+// Only a collapse popped from the outbox in the instant before a crash,
+// not yet in its queue, can be. Applying a collapse is idempotent, so
+// entries seen twice across a restart are harmless: a target that is
+// already collapsed is left alone (a different value is counted as a
+// conflict).
+
+#include "qubit.h"
+
+#include <arpa/inet.h>
+#include <map>
+#include <netinet/in.h>
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+const uint32_t BRIDGE_FRAME_ENTRIES = 20;     // 1328-byte frames, under one MTU
+const uint32_t BRIDGE_WINDOW        = 1024;   // unacked collapses in flight per peer
+static_assert(BRIDGE_WINDOW <= BRIDGE_PEER_QUEUE, "the window fits in a peer queue");
+const uint8_t  BRIDGE_DATA = 1;
+const uint8_t  BRIDGE_ACK  = 2;
+
+struct BridgeFrameHeader {
+    uint32_t magic;
+    uint8_t  version;
+    uint8_t  type;
+    uint8_t  count;     // DATA entries that follow
+    uint8_t  reserved;
+    uint64_t epoch;     // sender's epoch; for ACK, the epoch being acked
+    uint64_t seq;       // DATA: seq of the first entry; ACK: next seq expected
+    uint64_t base;      // DATA: oldest seq the sender still holds unacked
+    char     node[BRIDGE_NODE_LEN];  // sending node
+};
+
+struct BridgeOptions {
+    std::string node = localNodeName();
+    std::string listen = "127.0.0.1:7400";
+    std::map<std::string, std::string> peers;  // node name -> host:port
+    uint32_t rto_us = 20000;   // resend unacked collapses after this long
+    uint32_t idle_us = 200;    // outbox poll interval while idle
+};
+
+inline bool parseHostPort(const std::string& s, sockaddr_in& addr) {
+    size_t colon = s.rfind(':');
+    if (colon == std::string::npos) return false;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(uint16_t(std::atoi(s.c_str() + colon + 1)));
+    return inet_pton(AF_INET, s.substr(0, colon).c_str(), &addr.sin_addr) == 1;
+}
+
+class QubitBridge {
+public:
+    explicit QubitBridge(const BridgeOptions& options) : opts(options) {
+        epoch = (OpTimer::nowNs() << 16) ^ uint64_t(getpid());
+        bool created = false;
+        std::string shm = bridgeShmName(opts.node);
+        int probe = shm_open(qubitShmName(shm).c_str(), O_RDONLY, 0);
+        if (probe >= 0) close(probe); else created = true;
+        page = static_cast<BridgePage*>(mapShmSegment(shm, sizeof(BridgePage), true));
+        if (!page) { perror("bridge page"); exit(1); }
+        // Keep an existing outbox: collapses queued while no bridge ran still go out
+        if (created || page->magic.load() != BRIDGE_MAGIC || page->version != BRIDGE_VERSION) {
+            std::memset(static_cast<void*>(page), 0, sizeof(BridgePage));
+            page->outbox.init();
+            page->version = BRIDGE_VERSION;
+            page->magic.store(BRIDGE_MAGIC, std::memory_order_release);
+        }
+        page->epoch = epoch;
+        page->bridge_pid.store(getpid());
+
+        sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        sockaddr_in addr;
+        if (sock < 0 || !parseHostPort(opts.listen, addr) ||
+            bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            perror(("bridge listen " + opts.listen).c_str());
+            exit(1);
+        }
+        int buf = 4 << 20;
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+        for (const auto& kv : opts.peers) {
+            Peer& p = peers[kv.first];
+            if (!parseHostPort(kv.second, p.addr)) {
+                std::cerr << "bad peer address " << kv.second << std::endl;
+                exit(1);
+            }
+            p.queue = peerQueue(kv.first);
+            if (!p.queue) {
+                std::cerr << "at most " << BRIDGE_MAX_PEERS << " peers per bridge" << std::endl;
+                exit(1);
+            }
+            p.sent_to = p.queue->head;  // a previous bridge's window goes out again
+        }
+    }
+
+    ~QubitBridge() {
+        for (auto& kv : targets) { munmap(kv.second.state, sizeof(QubitState)); close(kv.second.fd); }
+        page->bridge_pid.store(0);
+        munmap(page, sizeof(BridgePage));
+        close(sock);
+    }
+
+    BridgeCounters& counters() { return page->counters; }
+
+    // Serve until `stop` becomes true
+    void run(const std::atomic<bool>& stop) {
+        for (auto& kv : peers) sendMore(kv.second);
+        while (!stop.load(std::memory_order_relaxed)) {
+            bool busy = drainOutbox();
+            busy |= receive();
+            resendExpired();
+            if (!busy) {
+                pollfd pfd = {sock, POLLIN, 0};
+                timespec idle = {0, long(opts.idle_us) * 1000};
+                ppoll(&pfd, 1, &idle, nullptr);
+            }
+        }
+    }
+
+private:
+    struct Peer {
+        sockaddr_in addr;
+        BridgePeerQueue* queue = nullptr;  // in the page
+        uint64_t sent_to = 0;           // [queue->head, sent_to) is in flight
+        uint64_t last_progress_ns = 0;  // last send into an empty window, or ack
+        // Receive side
+        uint64_t rx_epoch = 0;
+        uint64_t rx_expected = 1;
+    };
+
+    BridgeOptions opts;
+    uint64_t epoch;
+    BridgePage* page = nullptr;
+    int sock = -1;
+    std::map<std::string, Peer> peers;
+
+    // Receive side: target segments stay mapped between collapses
+    struct Target {
+        int         fd;
+        QubitState* state;
+    };
+    std::map<std::string, Target> targets;
+
+    // This node's queue slot for `node`, claimed if it has none; nullptr
+    // when every slot is taken
+    BridgePeerQueue* peerQueue(const std::string& node) {
+        BridgePeerQueue* free_slot = nullptr;
+        for (BridgePeerQueue& q : page->queues) {
+            if (q.node[0] && node.compare(0, BRIDGE_NODE_LEN - 1, q.node) == 0) return &q;
+            if (!q.node[0] && !free_slot) free_slot = &q;
+        }
+        if (!free_slot) return nullptr;
+        free_slot->head = free_slot->tail = 1;
+        strncpy(free_slot->node, node.c_str(), BRIDGE_NODE_LEN - 1);
+        return free_slot;
+    }
+
+    static BridgeFrameEntry& entryAt(Peer& p, uint64_t seq) {
+        return p.queue->entries[seq % BRIDGE_PEER_QUEUE];
+    }
+
+    // Move queued collapses into per-peer queues and send what fits the window
+    bool drainOutbox() {
+        RemoteCollapse msg;
+        size_t drained = 0;
+        while (drained < 4096) {
+            if (page->held_valid) msg = page->held;
+            else if (!page->outbox.tryPop(msg)) break;
+            auto it = peers.find(msg.node);
+            if (it == peers.end()) {
+                page->counters.dropped.fetch_add(1, std::memory_order_relaxed);
+            } else if (it->second.queue->tail - it->second.queue->head >= BRIDGE_PEER_QUEUE) {
+                page->held = msg;  // wait for ACKs to make room
+                page->held_valid = 1;
+                break;
+            } else {
+                Peer& p = it->second;
+                BridgeFrameEntry& e = entryAt(p, p.queue->tail);
+                std::memset(&e, 0, sizeof(e));
+                memcpy(e.qubit, msg.qubit, BRIDGE_QUBIT_LEN);
+                e.origin_ns = msg.origin_ns;
+                e.result = msg.result;
+                p.queue->tail++;
+            }
+            page->held_valid = 0;
+            ++drained;
+        }
+        if (drained)
+            for (auto& kv : peers) sendMore(kv.second);
+        return drained > 0;
+    }
+
+    // Send queued collapses that now fit in the window
+    void sendMore(Peer& p) {
+        uint64_t end = std::min(p.queue->tail, p.queue->head + BRIDGE_WINDOW);
+        if (p.sent_to >= end) return;
+        if (p.sent_to == p.queue->head) p.last_progress_ns = OpTimer::nowNs();
+        size_t n = sendRange(p, p.sent_to, end);
+        p.sent_to = end;
+        page->counters.sent.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Go-back-N: resend the whole window once ACKs stop for rto_us
+    void resendExpired() {
+        uint64_t now = OpTimer::nowNs();
+        for (auto& kv : peers) {
+            Peer& p = kv.second;
+            if (p.sent_to == p.queue->head || now - p.last_progress_ns < uint64_t(opts.rto_us) * 1000) continue;
+            size_t n = sendRange(p, p.queue->head, p.sent_to);
+            page->counters.retransmits.fetch_add(n, std::memory_order_relaxed);
+            p.last_progress_ns = now;
+        }
+    }
+
+    // Send seqs [begin, end)
+    size_t sendRange(Peer& p, uint64_t begin, uint64_t end) {
+        char frame[sizeof(BridgeFrameHeader) + BRIDGE_FRAME_ENTRIES * sizeof(BridgeFrameEntry)];
+        size_t sent = 0;
+        while (begin < end) {
+            size_t n = std::min(end - begin, uint64_t(BRIDGE_FRAME_ENTRIES));
+            BridgeFrameHeader h;
+            fillHeader(h, BRIDGE_DATA, epoch, begin);
+            h.count = uint8_t(n);
+            h.base = p.queue->head;
+            memcpy(frame, &h, sizeof(h));
+            for (size_t i = 0; i < n; ++i)
+                memcpy(frame + sizeof(h) + i * sizeof(BridgeFrameEntry), &entryAt(p, begin + i),
+                       sizeof(BridgeFrameEntry));
+            sendto(sock, frame, sizeof(h) + n * sizeof(BridgeFrameEntry), 0,
+                   reinterpret_cast<const sockaddr*>(&p.addr), sizeof(p.addr));
+            page->counters.frames_sent.fetch_add(1, std::memory_order_relaxed);
+            begin += n;
+            sent += n;
+        }
+        return sent;
+    }
+
+    void fillHeader(BridgeFrameHeader& h, uint8_t type, uint64_t ep, uint64_t seq) const {
+        std::memset(&h, 0, sizeof(h));
+        h.magic = BRIDGE_MAGIC;
+        h.version = uint8_t(BRIDGE_VERSION);
+        h.type = type;
+        h.epoch = ep;
+        h.seq = seq;
+        strncpy(h.node, opts.node.c_str(), BRIDGE_NODE_LEN - 1);
+    }
+
+    bool receive() {
+        char frame[sizeof(BridgeFrameHeader) + BRIDGE_FRAME_ENTRIES * sizeof(BridgeFrameEntry)];
+        bool any = false;
+        for (;;) {
+            ssize_t n = recv(sock, frame, sizeof(frame), MSG_DONTWAIT);
+            if (n < ssize_t(sizeof(BridgeFrameHeader))) return any;
+            any = true;
+            BridgeFrameHeader h;
+            memcpy(&h, frame, sizeof(h));
+            h.node[BRIDGE_NODE_LEN - 1] = '\0';
+            if (h.magic != BRIDGE_MAGIC || h.version != BRIDGE_VERSION) continue;
+            auto it = peers.find(h.node);
+            if (it == peers.end()) continue;
+            Peer& p = it->second;
+            if (h.type == BRIDGE_ACK) {
+                if (h.epoch != epoch) continue;  // ack for a previous incarnation
+                uint64_t acked_to = std::min(h.seq, p.sent_to);
+                if (acked_to > p.queue->head) {
+                    p.queue->head = acked_to;
+                    p.last_progress_ns = OpTimer::nowNs();
+                    sendMore(p);
+                }
+                continue;
+            }
+            if (h.type != BRIDGE_DATA ||
+                size_t(n) < sizeof(h) + size_t(h.count) * sizeof(BridgeFrameEntry)) continue;
+            page->counters.frames_received.fetch_add(1, std::memory_order_relaxed);
+            if (h.epoch != p.rx_epoch) {  // either side restarted: resume at the sender's base
+                p.rx_epoch = h.epoch;
+                p.rx_expected = h.base;
+            }
+            for (uint32_t i = 0; i < h.count; ++i) {
+                uint64_t seq = h.seq + i;
+                if (seq < p.rx_expected) {
+                    page->counters.duplicates.fetch_add(1, std::memory_order_relaxed);
+                } else if (seq > p.rx_expected) {
+                    page->counters.out_of_order.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    BridgeFrameEntry e;
+                    memcpy(&e, frame + sizeof(h) + i * sizeof(e), sizeof(e));
+                    e.qubit[BRIDGE_QUBIT_LEN - 1] = '\0';
+                    apply(e);
+                    p.rx_expected++;
+                }
+            }
+            BridgeFrameHeader ack;
+            fillHeader(ack, BRIDGE_ACK, h.epoch, p.rx_expected);
+            sendto(sock, &ack, sizeof(ack), 0, reinterpret_cast<const sockaddr*>(&p.addr), sizeof(p.addr));
+        }
+    }
+
+    // Mapped target segment, remapped if it was unlinked since; nullptr if absent
+    QubitState* target(const char* name) {
+        auto it = targets.find(name);
+        if (it != targets.end()) {
+            struct stat st;
+            if (fstat(it->second.fd, &st) == 0 && st.st_nlink > 0) return it->second.state;
+            munmap(it->second.state, sizeof(QubitState));
+            close(it->second.fd);
+            targets.erase(it);
+        }
+        int fd = shm_open(qubitShmName(name).c_str(), O_RDWR, 0);
+        if (fd < 0) return nullptr;
+        void* p = mmap(nullptr, sizeof(QubitState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) { close(fd); return nullptr; }
+        if (targets.size() >= 4096) {  // bound the open descriptors
+            for (auto& kv : targets) { munmap(kv.second.state, sizeof(QubitState)); close(kv.second.fd); }
+            targets.clear();
+        }
+        targets[name] = Target{fd, static_cast<QubitState*>(p)};
+        return static_cast<QubitState*>(p);
+    }
+
+    // Collapse a local qubit as propagateToLinks() would
+    void apply(const BridgeFrameEntry& e) {
+        QubitState* s = target(e.qubit);
+        if (!s) {
+            page->counters.missing.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (s->measured == 2) {
+            s->measured = e.result;
+            page->counters.applied.fetch_add(1, std::memory_order_relaxed);
+        } else if (s->measured != e.result) {
+            page->counters.conflicts.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            page->counters.applied.fetch_add(1, std::memory_order_relaxed);
+        }
+        notifyCollapse();
+        recordLatency(OpTimer::nowNs() - e.origin_ns);
+    }
+
+    // The bridge is the only writer of its latency histogram
+    void recordLatency(uint64_t ns) {
+        OpHistogram& h = page->counters.latency;
+        auto bump = [](std::atomic<uint64_t>& c, uint64_t n) {
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        };
+        bump(h.count, 1);
+        bump(h.sum_ns, ns);
+        bump(h.buckets[statsBucket(ns)], 1);
+        if (ns > h.max_ns.load(std::memory_order_relaxed)) h.max_ns.store(ns, std::memory_order_relaxed);
+    }
+};
+
+// Latency summary of a bridge page, for reporting
+inline OpSummary bridgeLatency(const BridgeCounters& counters) {
+    OpSummary out;
+    const OpHistogram& h = counters.latency;
+    out.count = h.count.load(std::memory_order_relaxed);
+    out.sum_ns = h.sum_ns.load(std::memory_order_relaxed);
+    out.max_ns = h.max_ns.load(std::memory_order_relaxed);
+    for (uint32_t b = 0; b < STATS_BUCKETS; ++b) out.buckets[b] = h.buckets[b].load(std::memory_order_relaxed);
+    return out;
+}
+
+inline std::atomic<bool>& bridgeStopFlag() {
+    static std::atomic<bool> stop{false};
+    return stop;
+}
+
+// Run a bridge in a child process until it gets SIGTERM or SIGINT
+inline pid_t spawnBridge(const BridgeOptions& options) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    signal(SIGTERM, [](int) { bridgeStopFlag().store(true); });
+    signal(SIGINT, [](int) { bridgeStopFlag().store(true); });
+    {
+        QubitBridge bridge(options);
+        bridge.run(bridgeStopFlag());
+    }
+    _exit(0);
+}
+
+inline void stopBridge(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
+
+// Map a node's bridge page once its bridge has set it up; nullptr on timeout
+inline BridgePage* waitForBridge(const std::string& node, int timeout_ms = 2000) {
+    for (int waited = 0; waited < timeout_ms; ++waited) {
+        auto* p = static_cast<BridgePage*>(mapShmSegment(bridgeShmName(node), sizeof(BridgePage), false));
+        if (p && p->magic.load() == BRIDGE_MAGIC && p->bridge_pid.load() != 0) return p;
+        if (p) munmap(p, sizeof(BridgePage));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return nullptr;
+}
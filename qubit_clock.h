@@ -0,0 +1,141 @@
+#pragma once
+
+// Clocks for decoherence timestamps and T1/T2 relaxation.
+//
+// BasicQubit reads time through its Clock parameter. updateTimestamp()
+// stamps the qubit on every gate, so the clock read is on the per-gate
+// path:
+//
+//   SteadyClock   std::chrono::steady_clock; the default
+//   CoarseClock   CLOCK_MONOTONIC_COARSE: a few ns per read, resolution of
+//                 one kernel tick (1-10 ms), fine against timeouts of
+//                 hundreds of ms
+//   TscClock      the TSC scaled to steady-clock nanoseconds; calibrated
+//                 once, for 10 ms, on first use
+//   VirtualClock  time moves only when advance() is called
+//
+// The real clocks share the steady clock's epoch, so their stamps can be
+// compared with each other and with snapshots. A qubit on VirtualClock
+// starts no decoherence thread. Its check is registered with the clock, and
+// advance() runs every registered check before it returns. A test can then
+// jump past a timeout instantly and see the collapse deterministically.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Real clocks: decoherence runs on its own thread, nothing to register
+struct RealClock {
+    static const bool manual = false;
+    static uint64_t watch(const std::function<void()>&) { return 0; }
+    static void unwatch(uint64_t) {}
+};
+
+struct SteadyClock : RealClock {
+    static uint64_t nowNs() {
+        auto tp = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(tp).count();
+    }
+    static uint64_t nowMs() {
+        auto tp = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(tp).count();
+    }
+};
+
+struct CoarseClock : RealClock {
+    static uint64_t nowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+    static uint64_t nowMs() { return nowNs() / 1000000; }
+};
+
+// Without a TSC, ticks are steady-clock nanoseconds
+struct TscClock : RealClock {
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return SteadyClock::nowNs();
+#endif
+    }
+
+    static uint64_t nowNs() {
+        const Calibration& c = calibration();
+        return c.origin_ns + uint64_t(double(ticks() - c.origin_tsc) * c.ns_per_tick);
+    }
+    static uint64_t nowMs() { return nowNs() / 1000000; }
+
+private:
+    struct Calibration {
+        uint64_t origin_tsc;
+        uint64_t origin_ns;
+        double   ns_per_tick;
+    };
+
+    static const Calibration& calibration() {
+        static const Calibration c = calibrate();
+        return c;
+    }
+
+    static Calibration calibrate() {
+        uint64_t n0 = SteadyClock::nowNs();
+        uint64_t t0 = ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t n1 = SteadyClock::nowNs();
+        uint64_t t1 = ticks();
+        return Calibration{t1, n1, double(n1 - n0) / double(t1 - t0)};
+    }
+};
+
+struct VirtualClock {
+    static const bool manual = true;
+
+    static uint64_t nowNs() { return state().now_ns.load(std::memory_order_acquire); }
+    static uint64_t nowMs() { return nowNs() / 1000000; }
+
+    // Move time forward, then run every registered check in this thread
+    static void advance(uint64_t ms) { advanceNs(ms * 1000000); }
+    static void advanceNs(uint64_t ns) {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.now_ns.fetch_add(ns, std::memory_order_acq_rel);
+        for (auto& kv : s.checks) kv.second();
+    }
+
+    static uint64_t watch(const std::function<void()>& check) {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.checks[++s.next_id] = check;
+        return s.next_id;
+    }
+
+    static void unwatch(uint64_t id) {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.checks.erase(id);
+    }
+
+private:
+    struct State {
+        std::atomic<uint64_t> now_ns{1000000000};  // starts at 1 s so no stamp is 0
+        std::mutex mtx;
+        uint64_t next_id = 0;
+        std::map<uint64_t, std::function<void()>> checks;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+};
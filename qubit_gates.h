@@ -0,0 +1,115 @@
+#pragma once
+
+// Compile-time gate algebra.
+//
+// Each gate is a type with a constexpr 2x2 matrix. Seq<G1, G2, ...> applies
+// G1 first, then G2, and so on. Its matrix is the product of theirs, worked
+// out by the compiler, so a fixed chain costs a single 2x2 multiply at run
+// time:
+//
+//   using namespace gates;
+//   q.apply<Seq<X, Z, H>>();          // same state as X, then Z, then H
+//   constexpr GateMatrix u = gateMatrix<Seq<H, T, H>>();
+//
+// gateMatrix<G>() static_asserts that the product is unitary to within
+// GATE_UNITARY_TOL. Sequences nest: Seq<Seq<H, T>, X> is fine. The gate
+// types sit in namespace `gates` so their one-letter names stay out of the
+// way.
+//
+// The basic gates here round differently from applyGateToAmplitudes().
+// That function divides by sqrt(2), while these multiply by 1/sqrt(2), so
+// results agree to about 1e-16 rather than bit for bit.
+
+constexpr double GATE_UNITARY_TOL = 1e-12;
+
+struct GateComplex {
+    double re;
+    double im;
+};
+
+// [[m00, m01], [m10, m11]] acting on (alpha, beta)
+struct GateMatrix {
+    GateComplex m00, m01;
+    GateComplex m10, m11;
+};
+
+namespace gates {
+
+constexpr double INV_SQRT2 = 0.70710678118654752440;
+
+constexpr GateComplex add(GateComplex a, GateComplex b) { return GateComplex{a.re + b.re, a.im + b.im}; }
+constexpr GateComplex mul(GateComplex a, GateComplex b) {
+    return GateComplex{a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re};
+}
+constexpr GateComplex conj(GateComplex a) { return GateComplex{a.re, -a.im}; }
+
+// a * b: b acts first
+constexpr GateMatrix product(const GateMatrix& a, const GateMatrix& b) {
+    return GateMatrix{add(mul(a.m00, b.m00), mul(a.m01, b.m10)), add(mul(a.m00, b.m01), mul(a.m01, b.m11)),
+                      add(mul(a.m10, b.m00), mul(a.m11, b.m10)), add(mul(a.m10, b.m01), mul(a.m11, b.m11))};
+}
+
+constexpr GateMatrix adjoint(const GateMatrix& a) {
+    return GateMatrix{conj(a.m00), conj(a.m10), conj(a.m01), conj(a.m11)};
+}
+
+constexpr bool near(double a, double b) { return a - b < GATE_UNITARY_TOL && b - a < GATE_UNITARY_TOL; }
+constexpr bool near(GateComplex a, GateComplex b) { return near(a.re, b.re) && near(a.im, b.im); }
+
+// c * I for some |c| = 1
+constexpr bool isPhase(const GateMatrix& a) {
+    return near(a.m01, GateComplex{0, 0}) && near(a.m10, GateComplex{0, 0}) && near(a.m00, a.m11) &&
+           near(a.m00.re * a.m00.re + a.m00.im * a.m00.im, 1.0);
+}
+
+constexpr bool isUnitary(const GateMatrix& a) {
+    return isPhase(product(adjoint(a), a)) && near(product(adjoint(a), a).m00, GateComplex{1, 0});
+}
+
+// Same operator up to a global phase
+constexpr bool equalUpToPhase(const GateMatrix& a, const GateMatrix& b) { return isPhase(product(adjoint(a), b)); }
+
+// The basic gates
+struct I { static constexpr GateMatrix matrix() { return GateMatrix{{1, 0}, {0, 0}, {0, 0}, {1, 0}}; } };
+struct H {
+    static constexpr GateMatrix matrix() {
+        return GateMatrix{{INV_SQRT2, 0}, {INV_SQRT2, 0}, {INV_SQRT2, 0}, {-INV_SQRT2, 0}};
+    }
+};
+struct X { static constexpr GateMatrix matrix() { return GateMatrix{{0, 0}, {1, 0}, {1, 0}, {0, 0}}; } };
+struct Y { static constexpr GateMatrix matrix() { return GateMatrix{{0, 0}, {0, -1}, {0, 1}, {0, 0}}; } };
+struct Z { static constexpr GateMatrix matrix() { return GateMatrix{{1, 0}, {0, 0}, {0, 0}, {-1, 0}}; } };
+struct S { static constexpr GateMatrix matrix() { return GateMatrix{{1, 0}, {0, 0}, {0, 0}, {0, 1}}; } };
+struct T {
+    static constexpr GateMatrix matrix() { return GateMatrix{{1, 0}, {0, 0}, {0, 0}, {INV_SQRT2, INV_SQRT2}}; }
+};
+
+// Gates applied left to right; the product is formed right to left
+template <class... Gates> struct Seq;
+
+template <> struct Seq<> {
+    static constexpr GateMatrix matrix() { return I::matrix(); }
+};
+
+template <class First, class... Rest> struct Seq<First, Rest...> {
+    static constexpr GateMatrix matrix() { return product(Seq<Rest...>::matrix(), First::matrix()); }
+};
+
+}  // namespace gates
+
+// G's matrix, checked for unitarity when compiled
+template <class G>
+constexpr GateMatrix gateMatrix() {
+    static_assert(gates::isUnitary(G::matrix()), "gate sequence is not unitary");
+    return G::matrix();
+}
+
+// (alpha, beta) <- u (alpha, beta)
+inline void applyMatrixToAmplitudes(double& alpha_re, double& alpha_im, double& beta_re, double& beta_im,
+                                    const GateMatrix& u) {
+    GateComplex a{alpha_re, alpha_im}, b{beta_re, beta_im};
+    GateComplex na = gates::add(gates::mul(u.m00, a), gates::mul(u.m01, b));
+    GateComplex nb = gates::add(gates::mul(u.m10, a), gates::mul(u.m11, b));
+    alpha_re = na.re; alpha_im = na.im;
+    beta_re  = nb.re; beta_im  = nb.im;
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+// NUMA placement for arenas and node-pinned gate workers.
+//
+// NumaTopology reads the online nodes and their CPUs from sysfs. An arena
+// can ask for its pages to be interleaved across nodes (mbind
+// MPOL_INTERLEAVE), or left to first touch. NumaWorkers runs one thread per
+// CPU, pinned, and splits any [0, n) range into one contiguous slice per
+// node, subdivided among that node's workers. The split only depends on n,
+// so a first touch through the workers places every slice on the node whose
+// workers later process it.
+//
+// mbind is issued as a raw syscall, so libnuma is not needed. Policies only
+// take effect on shm and huge-page arenas; page-cache pages of a file arena
+// are placed by the kernel.
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+enum ArenaNuma : uint8_t {
+    NUMA_DEFAULT,     // kernel default: local to the faulting thread
+    NUMA_INTERLEAVE,  // pages round-robin over all online nodes
+    NUMA_FIRST_TOUCH  // placed by the first writer, e.g. QubitArena::firstTouch()
+};
+
+// Parse a sysfs list such as "0-3,8-11"
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> out;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        int lo, hi, used = 0;
+        if (sscanf(list.c_str() + pos, "%d%n", &lo, &used) != 1) break;
+        pos += used;
+        hi = lo;
+        if (pos < list.size() && list[pos] == '-') {
+            if (sscanf(list.c_str() + pos + 1, "%d%n", &hi, &used) != 1) break;
+            pos += used + 1;
+        }
+        for (int i = lo; i <= hi; ++i) out.push_back(i);
+        while (pos < list.size() && (list[pos] == ',' || list[pos] == '\n')) ++pos;
+    }
+    return out;
+}
+
+inline std::string readSysfs(const std::string& path) {
+    std::string out;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return out;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+    fclose(f);
+    return out;
+}
+
+struct NumaTopology {
+    std::vector<int> nodes;                 // online node ids
+    std::vector<std::vector<int>> cpus;     // allowed CPUs of each node
+
+    // Online nodes that have CPUs this process may run on; one pseudo-node
+    // with every allowed CPU if sysfs has no NUMA information
+    static const NumaTopology& get() {
+        static NumaTopology topo = probe();
+        return topo;
+    }
+
+    size_t nodeCount() const { return nodes.size(); }
+
+private:
+    static NumaTopology probe() {
+        NumaTopology t;
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        for (int node : parseCpuList(readSysfs("/sys/devices/system/node/online"))) {
+            std::vector<int> node_cpus;
+            std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+            for (int cpu : parseCpuList(readSysfs(path)))
+                if (CPU_ISSET(cpu, &allowed)) node_cpus.push_back(cpu);
+            if (node_cpus.empty()) continue;
+            t.nodes.push_back(node);
+            t.cpus.push_back(node_cpus);
+        }
+        if (t.nodes.empty()) {
+            std::vector<int> all;
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                if (CPU_ISSET(cpu, &allowed)) all.push_back(cpu);
+            t.nodes.push_back(0);
+            t.cpus.push_back(all);
+        }
+        return t;
+    }
+};
+
+// Interleave future page allocations of [addr, addr+len) over every node
+inline bool numaInterleave(void* addr, size_t len) {
+    const NumaTopology& topo = NumaTopology::get();
+    unsigned long mask[16] = {};
+    const unsigned long bits = sizeof(unsigned long) * 8;
+    for (int node : topo.nodes)
+        if (node < int(sizeof(mask) * 8)) mask[node / bits] |= 1ul << (node % bits);
+    const int MPOL_INTERLEAVE_MODE = 3;
+    if (syscall(SYS_mbind, addr, len, MPOL_INTERLEAVE_MODE, mask, sizeof(mask) * 8, 0) != 0) {
+        perror("mbind");
+        return false;
+    }
+    return true;
+}
+
+// Fault in every page of a mapping by writing it back unchanged
+inline void touchPages(void* addr, size_t len) {
+    volatile char* p = static_cast<volatile char*>(addr);
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < len; off += page) p[off] = p[off];
+}
+
+class NumaWorkers {
+public:
+    typedef std::function<void(size_t begin, size_t end)> RangeFn;
+
+    // `per_node` workers on every node (0 = one per allowed CPU), each pinned
+    // to one CPU of its node
+    explicit NumaWorkers(unsigned per_node = 0) {
+        const NumaTopology& topo = NumaTopology::get();
+        for (size_t n = 0; n < topo.nodeCount(); ++n) {
+            const std::vector<int>& cpus = topo.cpus[n];
+            unsigned count = per_node ? per_node : unsigned(cpus.size());
+            for (unsigned i = 0; i < count; ++i)
+                slots.push_back(Slot{unsigned(n), i, count, cpus[i % cpus.size()]});
+        }
+        node_count = unsigned(topo.nodeCount());
+        for (size_t i = 0; i < slots.size(); ++i)
+            threads.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~NumaWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    size_t size() const { return slots.size(); }
+    unsigned nodes() const { return node_count; }
+
+    // Run fn over [0, n) split into per-worker slices; blocks until done
+    void parallelFor(size_t n, const RangeFn& fn) {
+        std::lock_guard<std::mutex> one_job(run_mtx);
+        std::unique_lock<std::mutex> lock(mtx);
+        job = &fn;
+        job_size = n;
+        remaining = slots.size();
+        ++generation;
+        start_cv.notify_all();
+        done_cv.wait(lock, [this] { return remaining == 0; });
+        job = nullptr;
+    }
+
+    // The slice of [0, n) that worker `w` handles
+    void slice(size_t w, size_t n, size_t& begin, size_t& end) const {
+        const Slot& s = slots[w];
+        size_t node_begin = n * s.node / node_count;
+        size_t node_end = n * (s.node + 1) / node_count;
+        size_t len = node_end - node_begin;
+        begin = node_begin + len * s.index / s.per_node;
+        end = node_begin + len * (s.index + 1) / s.per_node;
+    }
+
+private:
+    struct Slot {
+        unsigned node;      // index into NumaTopology::nodes
+        unsigned index;     // worker index within the node
+        unsigned per_node;
+        int      cpu;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::thread> threads;
+    unsigned node_count = 1;
+    std::mutex run_mtx;  // one parallelFor at a time
+    std::mutex mtx;
+    std::condition_variable start_cv, done_cv;
+    const RangeFn* job = nullptr;
+    size_t job_size = 0;
+    size_t remaining = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void workerLoop(size_t w) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(slots[w].cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+        uint64_t seen = 0;
+        for (;;) {
+            const RangeFn* fn;
+            size_t n;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                start_cv.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                fn = job;
+                n = job_size;
+            }
+            size_t begin, end;
+            slice(w, n, begin, end);
+            if (begin < end) (*fn)(begin, end);
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--remaining == 0) done_cv.notify_one();
+        }
+    }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+// USDT (SystemTap SDT) probes for perf, bpftrace and gdb.
+//
+// Each probe site is a single nop plus an ELF note in .note.stapsdt that
+// describes where its arguments live, so an unattached probe costs nothing.
+// Every probe has a semaphore that tracers increment while attached; guard
+// argument work that is not already at hand with QUBIT_PROBE_ENABLED(name).
+//
+// The note layout is the one <sys/sdt.h> produces, written out here so the
+// probes do not depend on systemtap headers. Define QUBIT_NO_PROBES to
+// compile them out entirely.
+//
+//   provider entangld
+//   gate(name, id, gate, ns)          applyGate() finished
+//   collapse(name, id, result, ns)    measure() collapsed the state
+//   propagate(name, peer, result, ns) one linked peer was updated
+//   decohere(name, id, result, late_ms) timeout collapse, ms past deadline
+
+#include <cstdint>
+
+#if !defined(QUBIT_NO_PROBES) && defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__))
+
+#define QUBIT_PROBE_SEMAPHORE(name)                                            \
+    extern "C" {                                                               \
+    __attribute__((weak, used, section(".probes")))                           \
+    volatile unsigned short entangld_##name##_semaphore = 0;                  \
+    }
+
+QUBIT_PROBE_SEMAPHORE(gate)
+QUBIT_PROBE_SEMAPHORE(collapse)
+QUBIT_PROBE_SEMAPHORE(propagate)
+QUBIT_PROBE_SEMAPHORE(decohere)
+
+#define QUBIT_PROBE_ENABLED(name) __builtin_expect(entangld_##name##_semaphore != 0, 0)
+
+#define QUBIT_PROBE_NOTE(name, args)                                           \
+    "990: nop\n"                                                               \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                              \
+    ".balign 4\n"                                                              \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                         \
+    "991: .asciz \"stapsdt\"\n"                                                \
+    "992: .balign 4\n"                                                         \
+    "993: .8byte 990b\n"                                                       \
+    ".8byte _.stapsdt.base\n"                                                  \
+    ".8byte entangld_" #name "_semaphore\n"                                    \
+    ".asciz \"entangld\"\n"                                                    \
+    ".asciz \"" #name "\"\n"                                                   \
+    ".asciz \"" args "\"\n"                                                    \
+    "994: .balign 4\n"                                                         \
+    ".popsection\n"                                                            \
+    ".ifndef _.stapsdt.base\n"                                                 \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"    \
+    ".weak _.stapsdt.base\n"                                                   \
+    ".hidden _.stapsdt.base\n"                                                 \
+    "_.stapsdt.base: .space 1\n"                                               \
+    ".size _.stapsdt.base, 1\n"                                                \
+    ".popsection\n"                                                            \
+    ".endif\n"
+
+// All arguments are passed as unsigned 64-bit values in registers
+#define QUBIT_PROBE4(name, a0, a1, a2, a3)                                     \
+    __asm__ __volatile__(QUBIT_PROBE_NOTE(name, "8@%[p0] 8@%[p1] 8@%[p2] 8@%[p3]") \
+        :: [p0] "r"(uint64_t(a0)), [p1] "r"(uint64_t(a1)),                     \
+           [p2] "r"(uint64_t(a2)), [p3] "r"(uint64_t(a3)))
+
+#else
+
+#define QUBIT_PROBE_ENABLED(name) false
+#define QUBIT_PROBE4(name, a0, a1, a2, a3) do {} while (0)
+
+#endif
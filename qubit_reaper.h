@@ -0,0 +1,150 @@
+#pragma once
+
+// Bulk cleanup of qubit segments.
+//
+// A Qubit's or arena's shm segment outlives its process, so clients that
+// crash before unlinking leave tmpfs pages behind. reapSegments() scans
+// /dev/shm within the current namespace ($QUBIT_SHM_PREFIX). It picks out
+// qubit segments, which are one QubitState long and carry its magic, and
+// arenas, which carry an ArenaHeader with the AoS or SoA magic. It then
+// unlinks, in one pass, every segment that matches all of the options:
+//
+//   prefix      logical name prefix; "" = any
+//   task_id     only this task; REAP_ANY_TASK = any
+//   dead_owner  only orphans: the owner, the last process to open the
+//               segment, has exited and no process maps it. Segments with
+//               no recorded owner are kept, such as those just restored
+//               from a snapshot.
+//   min_age_ms  only segments their owner opened at least this long ago
+//   dry_run     report matches without unlinking them
+//
+//   ReapReport r = reapSegments(ReapOptions());  // whatever dead owners left
+//
+// The owner is identified by its pid and process start time, so a reused
+// pid does not keep a segment alive. Other processes that opened the
+// segment earlier are found in /proc/<pid>/maps. If some process's maps
+// cannot be read, such as another user's, a dead owner proves nothing and
+// dead_owner keeps every segment (counted in `unverified`) unless
+// min_age_ms is set. Both lookups use this process's pid namespace: on
+// hosts shared between containers, also set a prefix or min_age_ms.
+//
+// `bytes` counts the tmpfs blocks the reaped segments held. That memory is
+// freed once the last mapping goes away. A process that still has a segment
+// mapped keeps using it, but the name no longer reaches it. Stats, trace and
+// bridge pages are never reaped.
+
+#include "qubit_soa.h"
+
+#include <cctype>
+#include <cerrno>
+#include <dirent.h>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_set>
+#include <vector>
+
+const int64_t REAP_ANY_TASK = -1;
+
+struct ReapOptions {
+    std::string prefix;
+    int64_t     task_id = REAP_ANY_TASK;
+    bool        dead_owner = true;
+    uint64_t    min_age_ms = 0;
+    bool        dry_run = false;
+};
+
+struct ReapReport {
+    size_t   scanned = 0;            // qubit and arena segments looked at
+    size_t   reaped = 0;
+    uint64_t bytes = 0;              // tmpfs space the reaped segments held
+    size_t   unverified = 0;         // orphans kept: some process maps were unreadable
+    std::vector<std::string> names;  // reaped, without the namespace prefix
+};
+
+// Task and owner fields shared by both segment kinds
+struct SegmentOwner {
+    uint32_t task_id;
+    uint32_t pid;
+    uint64_t start;
+    uint64_t since_ms;
+};
+
+// Read the owner of an open segment of `size` bytes; false if it is
+// neither a qubit nor an arena
+inline bool readSegmentOwner(int fd, off_t size, SegmentOwner& out) {
+    if (size == off_t(sizeof(QubitState))) {
+        QubitState s;
+        if (pread(fd, &s, sizeof(s), 0) != ssize_t(sizeof(s))) return false;
+        if (s.magic != QUBIT_STATE_MAGIC || s.version != QUBIT_STATE_VERSION) return false;
+        out = SegmentOwner{s.task_id, s.owner_pid, s.owner_start, s.owner_since_ms};
+        return true;
+    }
+    ArenaHeader h;
+    if (size < off_t(sizeof(h)) || pread(fd, &h, sizeof(h), 0) != ssize_t(sizeof(h))) return false;
+    if ((h.magic != ARENA_MAGIC && h.magic != SOA_MAGIC) || h.version != ARENA_VERSION) return false;
+    out = SegmentOwner{h.task_id, h.owner_pid, h.owner_start, h.owner_since_ms};
+    return true;
+}
+
+// /dev/shm entries mapped by any process whose maps this one can read;
+// `complete` is false if a live process's maps could not be read
+inline std::unordered_set<std::string> mappedShmNames(bool& complete) {
+    std::unordered_set<std::string> names;
+    complete = true;
+    DIR* proc = opendir("/proc");
+    if (!proc) { complete = false; return names; }
+    std::string line;
+    while (struct dirent* e = readdir(proc)) {
+        if (!isdigit(static_cast<unsigned char>(e->d_name[0]))) continue;
+        errno = 0;
+        std::ifstream maps(std::string("/proc/") + e->d_name + "/maps");
+        if (!maps.is_open()) {
+            if (errno != ENOENT) complete = false;  // ENOENT: it just exited
+            continue;
+        }
+        while (std::getline(maps, line)) {
+            size_t at = line.find(" /dev/shm/");
+            if (at != std::string::npos) names.insert(line.substr(at + 10));
+        }
+    }
+    closedir(proc);
+    return names;
+}
+
+inline ReapReport reapSegments(const ReapOptions& opts) {
+    ReapReport report;
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) { perror("opendir /dev/shm"); return report; }
+    std::string full = qubitShmName(opts.prefix);
+    size_t ns_len = strlen(qubitShmPrefix());
+    uint64_t now_ms = SteadyClock::nowMs();
+    std::unordered_set<std::string> mapped;
+    bool all_maps = true;
+    if (opts.dead_owner) mapped = mappedShmNames(all_maps);
+    while (struct dirent* e = readdir(dir)) {
+        if (e->d_name[0] == '.' || strncmp(e->d_name, full.c_str(), full.size()) != 0) continue;
+        int fd = shm_open(e->d_name, O_RDONLY, 0);
+        if (fd < 0) continue;
+        struct stat st;
+        SegmentOwner owner;
+        bool known = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && readSegmentOwner(fd, st.st_size, owner);
+        close(fd);
+        if (!known) continue;
+        report.scanned++;
+        if (opts.task_id != REAP_ANY_TASK && owner.task_id != uint32_t(opts.task_id)) continue;
+        if (opts.dead_owner && (owner.pid == 0 || ownerAlive(owner.pid, owner.start) || mapped.count(e->d_name)))
+            continue;
+        if (opts.min_age_ms && owner.since_ms + opts.min_age_ms > now_ms) continue;
+        if (opts.dead_owner && !all_maps && !opts.min_age_ms) {
+            report.unverified++;
+            continue;
+        }
+        if (!opts.dry_run && shm_unlink(e->d_name) != 0) continue;
+        report.reaped++;
+        report.bytes += uint64_t(st.st_blocks) * 512;
+        report.names.push_back(e->d_name + ns_len);
+    }
+    closedir(dir);
+    return report;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+// Links to qubits on other nodes.
+//
+// A link named "node:qubit" refers to shm segment `qubit` on host `node`.
+// Collapses towards such links are not written directly; they are queued in
+// the outbox of this host's bridge (qubit_bridge.h), a shared-memory page
+// named "qubit_bridge_<local node>" that the bridge process creates. The
+// local node name comes from QUBIT_NODE (default "local").
+
+#include "qubit_ring.h"
+#include "qubit_stats.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+const uint32_t BRIDGE_MAGIC      = 0x51425247;  // "QBRG"
+const uint32_t BRIDGE_VERSION    = 2;
+const uint32_t BRIDGE_NODE_LEN   = 16;
+const uint32_t BRIDGE_QUBIT_LEN  = 48;
+const uint32_t BRIDGE_OUTBOX_LEN = 8192;
+const uint32_t BRIDGE_MAX_PEERS  = 8;
+const uint32_t BRIDGE_PEER_QUEUE = 2048;  // per peer, sent or not, until acked; a power of two
+
+// One collapse to deliver: result for qubit `qubit` on node `node`
+struct RemoteCollapse {
+    char     node[BRIDGE_NODE_LEN];
+    char     qubit[BRIDGE_QUBIT_LEN];
+    uint64_t origin_ns;  // steady clock when the local collapse happened
+    uint8_t  result;
+};
+
+// A collapse as it sits in a peer queue and goes over the wire
+struct BridgeFrameEntry {
+    char     qubit[BRIDGE_QUBIT_LEN];
+    uint64_t origin_ns;
+    uint8_t  result;
+    uint8_t  reserved[7];
+};
+static_assert(sizeof(BridgeFrameEntry) == 64, "frame entries are 64 bytes");
+
+// One peer's collapses, from the outbox until the peer acks them: seqs
+// [head, tail), seq s in entries[s % BRIDGE_PEER_QUEUE]. Only the bridge
+// writes it. It lives in the page, so a bridge that crashes or restarts
+// resends what it had not delivered.
+struct BridgePeerQueue {
+    char     node[BRIDGE_NODE_LEN];  // "" = free slot
+    uint64_t head;
+    uint64_t tail;
+    BridgeFrameEntry entries[BRIDGE_PEER_QUEUE];
+};
+
+struct BridgeCounters {
+    std::atomic<uint64_t> posted;         // queued by local qubits
+    std::atomic<uint64_t> dropped;        // outbox full, name too long, or unknown node
+    std::atomic<uint64_t> sent;           // collapses sent for the first time
+    std::atomic<uint64_t> frames_sent;
+    std::atomic<uint64_t> retransmits;    // collapses sent again after a timeout
+    std::atomic<uint64_t> frames_received;
+    std::atomic<uint64_t> applied;        // remote collapses written locally
+    std::atomic<uint64_t> duplicates;     // already delivered, acked again
+    std::atomic<uint64_t> out_of_order;   // beyond a gap, left for retransmit
+    std::atomic<uint64_t> conflicts;      // target already collapsed the other way
+    std::atomic<uint64_t> missing;        // no such local qubit
+    OpHistogram latency;                  // origin -> applied, same-host clocks only
+};
+
+struct BridgePage {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    std::atomic<int32_t> bridge_pid;
+    uint64_t epoch;                       // changes every time a bridge starts
+    BridgeCounters counters;
+    ShmRing<RemoteCollapse, BRIDGE_OUTBOX_LEN> outbox;
+    BridgePeerQueue queues[BRIDGE_MAX_PEERS];
+    RemoteCollapse held;                  // popped, but its peer queue was full
+    uint32_t held_valid;
+};
+
+inline const char* localNodeName() {
+    const char* env = std::getenv("QUBIT_NODE");
+    return env && *env ? env : "local";
+}
+
+inline std::string bridgeShmName(const std::string& node) { return "qubit_bridge_" + node; }
+
+// Split "node:qubit"; false for a plain local name
+inline bool splitRemoteLink(const char* link, std::string& node, std::string& qubit) {
+    const char* colon = strchr(link, ':');
+    if (!colon) return false;
+    node.assign(link, colon);
+    qubit.assign(colon + 1);
+    return true;
+}
+
+class RemoteLinks {
+public:
+    // Queue a collapse for a "node:qubit" link; false if no bridge runs here
+    // or its outbox is full
+    static bool post(const char* link, uint8_t result) {
+        BridgePage* page = outbox();
+        if (!page) {
+            static std::atomic<bool> warned{false};
+            if (!warned.exchange(true))
+                std::cerr << "No bridge for node '" << localNodeName() << "', remote link "
+                          << link << " not updated" << std::endl;
+            return false;
+        }
+        std::string node, qubit;
+        RemoteCollapse msg;
+        std::memset(&msg, 0, sizeof(msg));
+        if (!splitRemoteLink(link, node, qubit) || node.size() >= BRIDGE_NODE_LEN ||
+            qubit.size() >= BRIDGE_QUBIT_LEN) {
+            page->counters.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        memcpy(msg.node, node.data(), node.size());
+        memcpy(msg.qubit, qubit.data(), qubit.size());
+        msg.origin_ns = OpTimer::nowNs();
+        msg.result = result;
+        if (!page->outbox.tryPush(msg)) {
+            page->counters.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        page->counters.posted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Without a bridge, look for its page again at most this often
+    static const uint64_t RETRY_NS = 1000000000ull;
+
+    // This node's bridge page, mapped on first use; nullptr if none exists.
+    // A miss is remembered for RETRY_NS, so posting without a bridge does
+    // not shm_open on every collapse.
+    static BridgePage* outbox() {
+        static std::atomic<BridgePage*> cached{nullptr};
+        static std::atomic<uint64_t> retry_at{0};
+        BridgePage* p = cached.load(std::memory_order_acquire);
+        if (p) return p;
+        uint64_t now = OpTimer::nowNs();
+        if (now < retry_at.load(std::memory_order_relaxed)) return nullptr;
+        static std::mutex map_mtx;
+        std::lock_guard<std::mutex> lock(map_mtx);
+        p = cached.load(std::memory_order_relaxed);
+        if (p) return p;
+        if (now < retry_at.load(std::memory_order_relaxed)) return nullptr;
+        p = static_cast<BridgePage*>(mapShmSegment(bridgeShmName(localNodeName()), sizeof(BridgePage), false));
+        if (p && (p->magic.load(std::memory_order_acquire) != BRIDGE_MAGIC || p->version != BRIDGE_VERSION)) {
+            munmap(p, sizeof(BridgePage));
+            p = nullptr;
+        }
+        if (p) cached.store(p, std::memory_order_release);
+        else retry_at.store(now + RETRY_NS, std::memory_order_relaxed);
+        return p;
+    }
+};
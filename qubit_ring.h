@@ -0,0 +1,175 @@
+#pragma once
+
+// Bounded lock-free queues that live in shared memory.
+//
+// ShmRing is Vyukov's bounded MPMC queue: every cell carries a sequence
+// number, so producers and consumers in different processes claim cells
+// with one CAS on the head or tail and never wait on each other.
+//
+// SpscRing has exactly one producer and one consumer. Each side keeps a
+// cached copy of the other's index and only rereads it when the cache says
+// the ring is full (or empty), and both sides work on runs of cells that
+// they publish with a single store, so a batch costs one cache-line
+// transfer instead of one per element.
+//
+// N must be a power of two. The structs are placed directly in a mapping
+// and set up once with init(); they hold no pointers.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "qubit_shm.h"
+
+template <class T, uint32_t N>
+struct ShmRing {
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+
+    struct Cell {
+        std::atomic<uint64_t> seq;
+        T value;
+    };
+
+    alignas(64) std::atomic<uint64_t> head;  // next cell to fill
+    alignas(64) std::atomic<uint64_t> tail;  // next cell to drain
+    alignas(64) Cell cells[N];
+
+    void init() {
+        for (uint32_t i = 0; i < N; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_release);
+    }
+
+    // False if the ring is full
+    bool tryPush(const T& v) {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells[pos & (N - 1)];
+            uint64_t seq = c.seq.load(std::memory_order_acquire);
+            int64_t diff = int64_t(seq) - int64_t(pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.value = v;
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // False if the ring is empty
+    bool tryPop(T& out) {
+        uint64_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells[pos & (N - 1)];
+            uint64_t seq = c.seq.load(std::memory_order_acquire);
+            int64_t diff = int64_t(seq) - int64_t(pos + 1);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = c.value;
+                    c.seq.store(pos + N, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t approxSize() const {
+        return size_t(head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed));
+    }
+};
+
+template <class T, uint32_t N>
+struct SpscRing {
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+
+    alignas(64) std::atomic<uint64_t> head;  // next cell to fill; producer writes
+    uint64_t cached_tail;                    // producer's view of tail
+    alignas(64) std::atomic<uint64_t> tail;  // next cell to drain; consumer writes
+    uint64_t cached_head;                    // consumer's view of head
+    alignas(64) T cells[N];
+
+    void init() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        cached_tail = cached_head = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // Producer: cells free to fill, starting at slot(0)
+    size_t writable() {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - cached_tail == N) cached_tail = tail.load(std::memory_order_acquire);
+        return size_t(N - (h - cached_tail));
+    }
+    T& slot(size_t i) { return cells[(head.load(std::memory_order_relaxed) + i) & (N - 1)]; }
+    void publish(size_t n) { head.store(head.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+    // Consumer: cells ready to read, starting at peek(0)
+    size_t readable() {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (cached_head == t) cached_head = head.load(std::memory_order_acquire);
+        return size_t(cached_head - t);
+    }
+    const T& peek(size_t i) const { return cells[(tail.load(std::memory_order_relaxed) + i) & (N - 1)]; }
+    void consume(size_t n) { tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+    bool tryPush(const T& v) {
+        if (!writable()) return false;
+        slot(0) = v;
+        publish(1);
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        if (!readable()) return false;
+        out = peek(0);
+        consume(1);
+        return true;
+    }
+};
+
+// Sleep while *word == expected, for at most timeout_ns; works across
+// processes on a word in a MAP_SHARED mapping
+inline void shmFutexWait(std::atomic<uint32_t>* word, uint32_t expected, uint64_t timeout_ns) {
+    timespec ts = {time_t(timeout_ns / 1000000000), long(timeout_ns % 1000000000)};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void shmFutexWake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1 << 30, nullptr, nullptr, 0);
+}
+
+// Map a shared-memory segment of `bytes`, creating it if asked; nullptr if
+// it does not exist (or cannot be mapped)
+inline void* mapShmSegment(const std::string& name, size_t bytes, bool create) {
+    int fd = shm_open(qubitShmName(name).c_str(), O_RDWR | (create ? O_CREAT : 0), 0666);
+    if (fd < 0) {
+        if (create) perror(("shm_open " + qubitShmName(name)).c_str());
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t(st.st_size) < bytes && (!create || ftruncate(fd, bytes) != 0))) {
+        close(fd);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return p == MAP_FAILED ? nullptr : p;
+}
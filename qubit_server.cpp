@@ -0,0 +1,58 @@
+// qubit_server: own a set of qubits and serve them to clients.
+//
+//   g++ -std=c++11 -O2 -pthread -o qubit_server qubit_server.cpp
+//   ./qubit_server [-s name] [-c capacity] [-C cpu] [-i interval_ms]
+//
+// Clients connect with QubitClient("<name>") (qubit_server.h). Every
+// interval the server prints its command rate, mean batch and qubit count.
+
+#include "qubit_server.h"
+
+static void usage() {
+    std::cerr << "usage: qubit_server [-s name] [-c capacity] [-C cpu] [-i interval_ms]\n";
+}
+
+int main(int argc, char** argv) {
+    ServerOptions opts;
+    int interval_ms = 1000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) { usage(); return 1; }
+        std::string val = argv[++i];
+        if (arg == "-s") opts.name = val;
+        else if (arg == "-c") opts.capacity = size_t(std::atoll(val.c_str()));
+        else if (arg == "-C") opts.cpu = std::atoi(val.c_str());
+        else if (arg == "-i") interval_ms = std::atoi(val.c_str());
+        else { usage(); return 1; }
+    }
+
+    signal(SIGTERM, [](int) { serverStopFlag().store(true); });
+    signal(SIGINT, [](int) { serverStopFlag().store(true); });
+    QubitServer server(opts);
+    std::cout << "qubit server on /dev/shm/" << opts.name << ", capacity " << opts.capacity << std::endl;
+
+    std::thread reporter([&] {
+        ServerPage* page = static_cast<ServerPage*>(mapShmSegment(opts.name, sizeof(ServerPage), false));
+        if (!page) return;
+        uint64_t prev_cmds = 0, prev_batches = 0;
+        while (!serverStopFlag().load()) {
+            for (int waited = 0; waited < interval_ms && !serverStopFlag().load(); waited += 10)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            uint64_t cmds = page->commands.load(), batches = page->batches.load();
+            uint32_t clients = 0;
+            for (uint32_t i = 0; i < SERVER_MAX_CLIENTS; ++i)
+                clients += page->clients[i].state.load() == SLOT_ACTIVE;
+            std::cout << std::fixed << std::setprecision(0) << (cmds - prev_cmds) * 1000.0 / interval_ms
+                      << " ops/s  " << std::setprecision(1)
+                      << (batches > prev_batches ? double(cmds - prev_cmds) / (batches - prev_batches) : 0.0)
+                      << " ops/batch  qubits " << page->qubits.load() << "  clients " << clients << std::endl;
+            prev_cmds = cmds;
+            prev_batches = batches;
+        }
+        munmap(page, sizeof(ServerPage));
+    });
+    server.run(serverStopFlag());
+    reporter.join();
+    shm_unlink(qubitShmName(opts.name).c_str());
+    return 0;
+}
@@ -0,0 +1,512 @@
+#pragma once
+
+// Qubit server: one process owns the qubits, clients send it commands.
+//
+// With plain Qubits every process maps every segment it touches and writes
+// raw QubitStates that other processes write too. A QubitServer instead
+// keeps all of its qubits in its own memory and is the only writer. Clients
+// connect to its control page ("<server>", in /dev/shm), claim one of
+// SERVER_MAX_CLIENTS slots and exchange fixed-size records through the two
+// SpscRings of that slot: ServerCommands in, one ServerCompletion out per
+// command, in order, carrying the client's tag.
+//
+// Qubits are addressed by handle. SRV_OPEN resolves a name to its handle
+// once (creating the qubit in |0>), after which setState, applyGate, measure
+// and entangle take handles. Entangled qubits are linked by handle, so a
+// measurement propagates to its links without any shm_open.
+//
+// The server thread drains each client's ring in runs of up to SERVER_BATCH
+// commands and publishes their completions with one store. It only takes
+// commands it has room to complete, so a client that stops reading
+// completions just stalls itself. When every ring is empty the server
+// sleeps on a futex in its page; clients ring that doorbell only while it
+// sleeps.
+//
+// A server will not take over a page whose server is still running. A
+// blocking client call gives up with SRV_GONE once the server has exited,
+// or with SRV_TIMEOUT after the client's call timeout; on a client that
+// never connected it fails with SRV_NOT_CONNECTED. Clients and the server
+// are told apart from reused pids by their process start times.
+//
+// Server qubits do not run a decoherence thread or relax, and their links
+// cannot leave the server.
+
+#include "qubit.h"
+
+#include <cerrno>
+#include <csignal>
+#include <deque>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unordered_map>
+
+const uint32_t SERVER_MAGIC       = 0x51535256;  // "QSRV"
+const uint32_t SERVER_VERSION     = 3;
+const uint32_t SERVER_MAX_CLIENTS = 16;
+const uint32_t SERVER_RING_LEN    = 4096;
+const uint32_t SERVER_BATCH       = 256;
+const uint32_t SERVER_NAME_LEN    = 48;
+
+enum ServerOp : uint8_t { SRV_OPEN = 1, SRV_SET_STATE, SRV_APPLY_GATE, SRV_MEASURE, SRV_ENTANGLE };
+
+enum ServerStatus : uint8_t {
+    SRV_OK = 0,
+    SRV_BAD_HANDLE,  // no such qubit, or a bad peer handle
+    SRV_BAD_OP,      // unknown op or gate
+    SRV_FULL,        // SRV_OPEN with the server at capacity
+    SRV_GONE,        // blocking call: the server exited
+    SRV_TIMEOUT,     // blocking call: no completion within the call timeout
+    SRV_NOT_CONNECTED,  // blocking call on a client that did not connect
+};
+
+struct ServerCommand {
+    uint64_t tag;      // echoed in the completion
+    uint8_t  op;
+    uint8_t  gate;     // SRV_APPLY_GATE
+    uint8_t  count;    // SRV_ENTANGLE: peers used
+    uint8_t  reserved;
+    uint32_t handle;
+    union {
+        double   amp[4];                  // SRV_SET_STATE: ar, ai, br, bi
+        uint32_t peers[4];                // SRV_ENTANGLE
+        char     name[SERVER_NAME_LEN];   // SRV_OPEN
+    };
+};
+static_assert(sizeof(ServerCommand) == 64, "commands are one cache line");
+
+struct ServerCompletion {
+    uint64_t tag;
+    uint32_t handle;   // SRV_OPEN: the qubit's handle
+    uint8_t  status;
+    uint8_t  result;   // measured value after the op (2 = superposition)
+    uint8_t  reserved[2];
+};
+
+enum ServerSlotState : uint32_t { SLOT_FREE, SLOT_CLAIMED, SLOT_ACTIVE, SLOT_CLOSING };
+
+struct ServerClientSlot {
+    std::atomic<uint32_t> state;  // only the server moves a slot back to SLOT_FREE
+    std::atomic<int32_t>  pid;
+    uint64_t start;               // the client's processStartTime()
+    SpscRing<ServerCommand, SERVER_RING_LEN>    commands;
+    SpscRing<ServerCompletion, SERVER_RING_LEN> completions;
+};
+
+struct ServerPage {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    std::atomic<int32_t>  server_pid;
+    uint64_t server_start;            // its processStartTime()
+    std::atomic<uint32_t> sleeping;   // server is (about to be) asleep on doorbell
+    std::atomic<uint32_t> doorbell;
+    std::atomic<uint64_t> commands;   // executed, written by the server only
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> qubits;
+    ServerClientSlot clients[SERVER_MAX_CLIENTS];
+};
+
+// True while the server that set up `page` is running
+inline bool serverAlive(const ServerPage* page) {
+    int32_t pid = page->server_pid.load();
+    return pid > 0 && ownerAlive(uint32_t(pid), page->server_start);
+}
+
+struct ServerOptions {
+    std::string name = "qubit_server";
+    uint32_t task_id = 1;
+    size_t   capacity = 1 << 20;  // most qubits SRV_OPEN will create
+    int      cpu = -1;            // pin the server thread, -1 = not pinned
+    uint32_t spin = 2000;         // empty polls before sleeping
+};
+
+class QubitServer {
+public:
+    explicit QubitServer(const ServerOptions& options) : opts(options) {
+        page = static_cast<ServerPage*>(mapShmSegment(opts.name, sizeof(ServerPage), true));
+        if (!page) { perror("server page"); exit(1); }
+        if (page->magic.load() == SERVER_MAGIC && page->version == SERVER_VERSION && serverAlive(page)) {
+            std::cerr << "Qubit server '" << opts.name << "' already runs as pid "
+                      << page->server_pid.load() << std::endl;
+            exit(1);
+        }
+        std::memset(static_cast<void*>(page), 0, sizeof(ServerPage));
+        page->version = SERVER_VERSION;
+        page->server_start = processStartTime(getpid());
+        page->server_pid.store(getpid());
+        page->magic.store(SERVER_MAGIC, std::memory_order_release);
+    }
+
+    ~QubitServer() {
+        page->server_pid.store(0);
+        munmap(page, sizeof(ServerPage));
+    }
+
+    QubitServer(const QubitServer&) = delete;
+    QubitServer& operator=(const QubitServer&) = delete;
+
+    // Serve until `stop` becomes true
+    void run(const std::atomic<bool>& stop) {
+        if (opts.cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(opts.cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        uint32_t idle = 0;
+        uint64_t last_scan = OpTimer::nowNs();
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (serveAll()) { idle = 0; continue; }
+            uint64_t now = OpTimer::nowNs();
+            if (now - last_scan > 100000000ULL) {  // reclaim slots of exited clients
+                reapClients();
+                last_scan = now;
+            }
+            if (++idle < opts.spin) continue;
+            // Announce the sleep, then look once more so no doorbell is missed
+            uint32_t bell = page->doorbell.load();
+            page->sleeping.store(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!serveAll()) shmFutexWait(&page->doorbell, bell, 10000000);
+            page->sleeping.store(0);
+            idle = 0;
+        }
+    }
+
+    size_t size() const { return states.size(); }
+
+    // Server-side view of a qubit; only safe while the server is not running
+    const QubitState& state(uint32_t handle) const { return states[handle]; }
+
+private:
+    struct Links {
+        uint32_t peer[4];
+        uint32_t count;
+    };
+
+    ServerOptions opts;
+    ServerPage* page = nullptr;
+    std::vector<QubitState> states;
+    std::vector<Links> links;
+    std::unordered_map<std::string, uint32_t> handles;
+    std::mt19937 rng{std::random_device{}()};
+
+    bool serveAll() {
+        bool any = false;
+        for (uint32_t i = 0; i < SERVER_MAX_CLIENTS; ++i) {
+            ServerClientSlot& c = page->clients[i];
+            uint32_t st = c.state.load(std::memory_order_acquire);
+            if (st == SLOT_CLOSING) { c.state.store(SLOT_FREE, std::memory_order_release); continue; }
+            if (st != SLOT_ACTIVE) continue;
+            size_t n = std::min(c.commands.readable(), c.completions.writable());
+            n = std::min(n, size_t(SERVER_BATCH));
+            if (n == 0) continue;
+            for (size_t k = 0; k < n; ++k) execute(c.commands.peek(k), c.completions.slot(k));
+            c.commands.consume(n);
+            c.completions.publish(n);
+            bump(page->commands, n);
+            bump(page->batches, 1);
+            any = true;
+        }
+        return any;
+    }
+
+    // Slots whose client died without disconnecting; a reused pid does not
+    // keep a slot, since its start time differs
+    void reapClients() {
+        for (uint32_t i = 0; i < SERVER_MAX_CLIENTS; ++i) {
+            ServerClientSlot& c = page->clients[i];
+            if (c.state.load() == SLOT_ACTIVE && !ownerAlive(uint32_t(c.pid.load()), c.start))
+                c.state.store(SLOT_FREE, std::memory_order_release);
+        }
+    }
+
+    static void bump(std::atomic<uint64_t>& c, uint64_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void execute(const ServerCommand& cmd, ServerCompletion& done) {
+        done.tag = cmd.tag;
+        done.handle = cmd.handle;
+        done.status = SRV_OK;
+        if (cmd.op == SRV_OPEN) {
+            open(cmd, done);
+            return;
+        }
+        if (cmd.handle >= states.size()) {
+            done.status = SRV_BAD_HANDLE;
+            done.result = 2;
+            return;
+        }
+        QubitState& s = states[cmd.handle];
+        switch (cmd.op) {
+            case SRV_SET_STATE:
+                s.alpha_real = cmd.amp[0]; s.alpha_imag = cmd.amp[1];
+                s.beta_real  = cmd.amp[2]; s.beta_imag  = cmd.amp[3];
+                s.measured = 2;
+                break;
+            case SRV_APPLY_GATE:
+                if (s.measured == 2 && !applyGateToState(s, char(cmd.gate))) done.status = SRV_BAD_OP;
+                break;
+            case SRV_MEASURE:
+                if (s.measured == 2) {
+                    std::bernoulli_distribution dist(s.beta_real * s.beta_real + s.beta_imag * s.beta_imag);
+                    uint8_t result = dist(rng);
+                    collapseState(s, result);
+                    const Links& l = links[cmd.handle];
+                    for (uint32_t i = 0; i < l.count; ++i) states[l.peer[i]].measured = result;
+                }
+                break;
+            case SRV_ENTANGLE:
+                entangle(cmd, done);
+                break;
+            default:
+                done.status = SRV_BAD_OP;
+        }
+        done.result = s.measured;
+    }
+
+    void open(const ServerCommand& cmd, ServerCompletion& done) {
+        std::string name(cmd.name, strnlen(cmd.name, SERVER_NAME_LEN));
+        auto it = handles.find(name);
+        if (it == handles.end()) {
+            if (states.size() >= opts.capacity) {
+                done.status = SRV_FULL;
+                done.result = 2;
+                return;
+            }
+            QubitState s;
+            std::memset(&s, 0, sizeof(s));
+            s.alpha_real = 1.0;
+            s.task_id = opts.task_id;
+            states.push_back(s);
+            links.push_back(Links());
+            links.back().count = 0;
+            it = handles.emplace(name, uint32_t(states.size() - 1)).first;
+            page->qubits.store(states.size(), std::memory_order_relaxed);
+        }
+        done.handle = it->second;
+        done.result = states[it->second].measured;
+    }
+
+    void entangle(const ServerCommand& cmd, ServerCompletion& done) {
+        uint32_t n = std::min<uint32_t>(cmd.count, 4);
+        for (uint32_t i = 0; i < n; ++i) {
+            if (cmd.peers[i] >= states.size()) {
+                done.status = SRV_BAD_HANDLE;
+                return;
+            }
+        }
+        Links& l = links[cmd.handle];
+        for (uint32_t i = 0; i < n; ++i) l.peer[i] = cmd.peers[i];
+        l.count = n;
+        states[cmd.handle].link_count = n;
+    }
+};
+
+class QubitClient {
+public:
+    // Connect to a running server; connected() is false if none answered
+    // within `timeout_ms` or every slot is taken. Blocking calls give up
+    // after `call_timeout_ms`.
+    explicit QubitClient(const std::string& server, int timeout_ms = 2000, int call_timeout_ms = 10000)
+        : call_timeout_ns(uint64_t(call_timeout_ms) * 1000000) {
+        for (int waited = 0; waited <= timeout_ms && !page; ++waited) {
+            auto* p = static_cast<ServerPage*>(mapShmSegment(server, sizeof(ServerPage), false));
+            if (p && p->magic.load() == SERVER_MAGIC && p->version == SERVER_VERSION && serverAlive(p)) {
+                page = p;
+                break;
+            }
+            if (p) munmap(p, sizeof(ServerPage));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!page) return;
+        for (uint32_t i = 0; i < SERVER_MAX_CLIENTS && !slot; ++i) {
+            uint32_t expected = SLOT_FREE;
+            if (page->clients[i].state.compare_exchange_strong(expected, SLOT_CLAIMED)) slot = &page->clients[i];
+        }
+        if (!slot) {
+            std::cerr << "Qubit server '" << server << "': no free client slot" << std::endl;
+            return;
+        }
+        slot->commands.init();
+        slot->completions.init();
+        slot->start = processStartTime(getpid());
+        slot->pid.store(getpid());
+        slot->state.store(SLOT_ACTIVE, std::memory_order_release);
+    }
+
+    ~QubitClient() {
+        if (slot) slot->state.store(SLOT_CLOSING, std::memory_order_release);
+        if (page) munmap(page, sizeof(ServerPage));
+    }
+
+    QubitClient(const QubitClient&) = delete;
+    QubitClient& operator=(const QubitClient&) = delete;
+
+    bool connected() const { return slot != nullptr; }
+
+    // Queue one command; false if the ring is full or the client is not
+    // connected. The server sees queued commands after flush().
+    bool submit(const ServerCommand& cmd) {
+        if (!slot || !slot->commands.writable()) return false;
+        slot->commands.slot(0) = cmd;
+        slot->commands.publish(1);
+        return true;
+    }
+
+    // Wake the server if it is asleep
+    void flush() {
+        if (!slot) return;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (page->sleeping.load(std::memory_order_relaxed)) {
+            page->doorbell.fetch_add(1);
+            shmFutexWake(&page->doorbell);
+        }
+    }
+
+    // Up to `max` completions, oldest first; 0 if none are ready
+    size_t poll(ServerCompletion* out, size_t max) {
+        size_t n = 0;
+        while (n < max && !early.empty()) {
+            out[n++] = early.front();
+            early.pop_front();
+        }
+        if (!slot) return n;
+        size_t ready = std::min(max - n, slot->completions.readable());
+        for (size_t i = 0; i < ready; ++i) out[n + i] = slot->completions.peek(i);
+        slot->completions.consume(ready);
+        return n + ready;
+    }
+
+    static ServerCommand openCmd(const std::string& name) {
+        ServerCommand c = command(SRV_OPEN, 0);
+        strncpy(c.name, name.c_str(), SERVER_NAME_LEN - 1);
+        return c;
+    }
+    static ServerCommand setStateCmd(uint32_t h, double ar, double ai, double br, double bi) {
+        ServerCommand c = command(SRV_SET_STATE, h);
+        c.amp[0] = ar; c.amp[1] = ai; c.amp[2] = br; c.amp[3] = bi;
+        return c;
+    }
+    static ServerCommand gateCmd(uint32_t h, char gate) {
+        ServerCommand c = command(SRV_APPLY_GATE, h);
+        c.gate = uint8_t(gate);
+        return c;
+    }
+    static ServerCommand measureCmd(uint32_t h) { return command(SRV_MEASURE, h); }
+    static ServerCommand entangleCmd(uint32_t h, const std::vector<uint32_t>& peers) {
+        ServerCommand c = command(SRV_ENTANGLE, h);
+        c.count = uint8_t(std::min(peers.size(), size_t(4)));
+        for (uint32_t i = 0; i < c.count; ++i) c.peers[i] = peers[i];
+        return c;
+    }
+
+    // Blocking helpers: one round trip each; completions of commands
+    // submitted earlier are kept for poll(). They fail if the server exits
+    // or does not answer in time; a late completion then shows up in poll().
+    int64_t open(const std::string& name) {
+        ServerCompletion done = call(openCmd(name));
+        return done.status == SRV_OK ? int64_t(done.handle) : -1;
+    }
+    bool setState(uint32_t h, double ar, double ai, double br, double bi) {
+        return call(setStateCmd(h, ar, ai, br, bi)).status == SRV_OK;
+    }
+    bool applyGate(uint32_t h, char gate) { return call(gateCmd(h, gate)).status == SRV_OK; }
+    bool entangle(uint32_t h, const std::vector<uint32_t>& peers) {
+        return call(entangleCmd(h, peers)).status == SRV_OK;
+    }
+    // 0 or 1, the stored value if already collapsed; -1 on error
+    int measure(uint32_t h) {
+        ServerCompletion done = call(measureCmd(h));
+        return done.status == SRV_OK ? done.result : -1;
+    }
+
+private:
+    ServerPage* page = nullptr;
+    ServerClientSlot* slot = nullptr;
+    uint64_t call_timeout_ns;
+    uint64_t next_tag = 1ULL << 63;  // blocking calls; submit() callers own the low tags
+    std::deque<ServerCompletion> early;
+
+    static ServerCommand command(ServerOp op, uint32_t h) {
+        ServerCommand c;
+        std::memset(&c, 0, sizeof(c));
+        c.op = op;
+        c.handle = h;
+        return c;
+    }
+
+    ServerCompletion call(ServerCommand cmd) {
+        cmd.tag = next_tag++;
+        if (!slot) return failed(cmd, SRV_NOT_CONNECTED);
+        uint64_t start = OpTimer::nowNs(), checked = start;
+        uint8_t status = SRV_OK;
+        while (!submit(cmd)) {
+            flush();
+            drainToEarly();
+            if ((status = stalled(start, checked)) != SRV_OK) return failed(cmd, status);
+            std::this_thread::yield();
+        }
+        flush();
+        for (;;) {
+            while (slot->completions.readable()) {
+                ServerCompletion done = slot->completions.peek(0);
+                slot->completions.consume(1);
+                if (done.tag == cmd.tag) return done;
+                early.push_back(done);
+            }
+            if ((status = stalled(start, checked)) != SRV_OK) return failed(cmd, status);
+            std::this_thread::yield();
+        }
+    }
+
+    // SRV_OK while a call begun at `start` may keep waiting. The server's
+    // liveness is checked once a millisecond.
+    uint8_t stalled(uint64_t start, uint64_t& checked) {
+        uint64_t now = OpTimer::nowNs();
+        if (now - checked < 1000000) return SRV_OK;
+        checked = now;
+        if (!serverAlive(page)) return SRV_GONE;
+        return now - start >= call_timeout_ns ? SRV_TIMEOUT : SRV_OK;
+    }
+
+    static ServerCompletion failed(const ServerCommand& cmd, uint8_t status) {
+        ServerCompletion done;
+        std::memset(&done, 0, sizeof(done));
+        done.tag = cmd.tag;
+        done.handle = cmd.handle;
+        done.status = status;
+        done.result = 2;
+        return done;
+    }
+
+    void drainToEarly() {
+        ServerCompletion done;
+        while (slot->completions.tryPop(done)) early.push_back(done);
+    }
+};
+
+inline std::atomic<bool>& serverStopFlag() {
+    static std::atomic<bool> stop{false};
+    return stop;
+}
+
+// Run a server in a child process until it gets SIGTERM or SIGINT
+inline pid_t spawnServer(const ServerOptions& options) {
+    std::cout.flush();  // a child that exits early would flush it again
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    signal(SIGTERM, [](int) { serverStopFlag().store(true); });
+    signal(SIGINT, [](int) { serverStopFlag().store(true); });
+    {
+        QubitServer server(options);
+        server.run(serverStopFlag());
+    }
+    _exit(0);
+}
+
+inline void stopServer(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// Shared-memory namespaces.
+//
+// Every POSIX shm segment the library creates, opens or unlinks goes through
+// qubitShmName(), which prepends $QUBIT_SHM_PREFIX. Processes run with
+// different prefixes see disjoint sets of segments under the same logical
+// names, so concurrent test runs (or tenants) on one host cannot collide:
+//
+//   QUBIT_SHM_PREFIX=run7_ ./app      # Qubit("bell_qubit1") is /dev/shm/run7_bell_qubit1
+//
+// Logical names are what the API stores and returns: link targets, trace
+// ids and snapshot records carry no prefix, and snapshots taken under one
+// prefix can be published under another.
+//
+// Segments also record their owner: the pid and start time of the last
+// process to open them. processStartTime() tells whether that process still
+// exists, so a reaper (qubit_reaper.h) can find what crashed clients left
+// behind even after the pid has been reused.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+inline const char* qubitShmPrefix() {
+    const char* env = std::getenv("QUBIT_SHM_PREFIX");
+    return env ? env : "";
+}
+
+inline std::string qubitShmName(const std::string& name) { return qubitShmPrefix() + name; }
+
+// Start time of process `pid` in clock ticks since boot (field 22 of
+// /proc/<pid>/stat), 0 if there is no such process
+inline uint64_t processStartTime(pid_t pid) {
+    char path[32], buf[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", int(pid));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+    const char* p = strrchr(buf, ')');  // the command name may hold spaces
+    for (int field = 2; field < 22 && p; ++field) p = strchr(p + 1, ' ');
+    return p ? strtoull(p + 1, nullptr, 10) : 0;
+}
+
+// This process's start time; read again after a fork
+inline uint64_t selfStartTime() {
+    static thread_local pid_t pid = 0;
+    static thread_local uint64_t start = 0;
+    if (pid != getpid()) {
+        pid = getpid();
+        start = processStartTime(pid);
+    }
+    return start;
+}
+
+// False once the recorded owner has exited, including when its pid now
+// belongs to a different process
+inline bool ownerAlive(uint32_t pid, uint64_t start) {
+    return pid != 0 && processStartTime(pid_t(pid)) == start;
+}
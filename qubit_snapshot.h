@@ -0,0 +1,237 @@
+#pragma once
+
+// Checkpoint and restore of shared qubit state.
+//
+// A snapshot file is a fixed header followed by one 64-byte-aligned record
+// per qubit (segment name + raw QubitState), sorted by name. Nothing in it
+// needs decoding, so restore() just maps the file read-only: opening a
+// snapshot of millions of qubits costs one mmap and pages fault in on
+// first access, and find() reads states straight from the mapping.
+//
+// publish() is a copy, not zero-copy: every live Qubit is its own /dev/shm
+// segment, so each record is written into a segment of its own, a few
+// syscalls per qubit. A Qubit with the same name and task id then picks
+// the state up unchanged.
+//
+// Timestamps are steady-clock values, which do not survive a reboot;
+// publish() rebases them so each qubit keeps the age it had when saved.
+
+#include "qubit.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+const uint32_t SNAPSHOT_MAGIC   = 0x51534e50;  // "QSNP"
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;    // sizeof(SnapshotRecord), guards layout changes
+    uint32_t state_size;     // sizeof(QubitState)
+    uint64_t count;
+    uint64_t saved_steady_ns;
+    uint64_t saved_wall_ns;
+    uint8_t  reserved[24];
+};
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header is one cache line");
+
+struct alignas(64) SnapshotRecord {
+    char       name[64];
+    QubitState state;
+};
+
+class QubitSnapshot {
+public:
+    QubitSnapshot() {}
+    QubitSnapshot(const QubitSnapshot&) = delete;
+    QubitSnapshot& operator=(const QubitSnapshot&) = delete;
+    QubitSnapshot(QubitSnapshot&& other) { *this = std::move(other); }
+    QubitSnapshot& operator=(QubitSnapshot&& other) {
+        std::swap(base, other.base);
+        std::swap(length, other.length);
+        return *this;
+    }
+    ~QubitSnapshot() { if (base) munmap(base, length); }
+
+    // Save the named shared-memory qubits; missing segments are skipped.
+    // Each state is copied as-is without the owning Qubit's lock.
+    static bool save(const std::string& path, std::vector<std::string> names) {
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+
+        std::string tmp = path + ".tmp";
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) { perror("open snapshot"); return false; }
+
+        SnapshotHeader header = {};
+        header.magic = SNAPSHOT_MAGIC;
+        header.version = SNAPSHOT_VERSION;
+        header.record_size = sizeof(SnapshotRecord);
+        header.state_size = sizeof(QubitState);
+        header.saved_steady_ns = OpTimer::nowNs();
+        header.saved_wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+        // Records are written in chunks behind the header, which goes last
+        std::vector<SnapshotRecord> chunk;
+        chunk.reserve(1024);
+        off_t offset = sizeof(SnapshotHeader);
+        bool ok = true;
+        for (size_t i = 0; i < names.size() && ok; ++i) {
+            if (names[i].size() >= sizeof(SnapshotRecord::name)) continue;
+            SnapshotRecord rec;
+            std::memset(&rec, 0, sizeof(rec));
+            if (!readSegment(names[i], rec.state)) continue;
+            strncpy(rec.name, names[i].c_str(), sizeof(rec.name) - 1);
+            chunk.push_back(rec);
+            header.count++;
+            if (chunk.size() == chunk.capacity()) {
+                ok = writeAll(fd, chunk.data(), chunk.size() * sizeof(SnapshotRecord), offset);
+                offset += chunk.size() * sizeof(SnapshotRecord);
+                chunk.clear();
+            }
+        }
+        if (!chunk.empty()) ok = ok && writeAll(fd, chunk.data(), chunk.size() * sizeof(SnapshotRecord), offset);
+        ok = ok && writeAll(fd, &header, sizeof(header), 0) && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            perror("write snapshot");
+            unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Save every qubit segment in /dev/shm whose name starts with `prefix`
+    static bool save(const std::string& path, const char* prefix = "") {
+        return save(path, listSegments(prefix));
+    }
+
+    // Map a snapshot file; valid() is false if it is missing or incompatible
+    static QubitSnapshot restore(const std::string& path) {
+        QubitSnapshot snap;
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) { perror("open snapshot"); return snap; }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SnapshotHeader)) {
+            std::cerr << "Snapshot " << path << " is truncated" << std::endl;
+            close(fd);
+            return snap;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) { perror("mmap snapshot"); return snap; }
+        snap.base = p;
+        snap.length = st.st_size;
+
+        const SnapshotHeader* h = snap.header();
+        if (h->magic != SNAPSHOT_MAGIC || h->version != SNAPSHOT_VERSION ||
+            h->record_size != sizeof(SnapshotRecord) || h->state_size != sizeof(QubitState) ||
+            h->count > (snap.length - sizeof(SnapshotHeader)) / sizeof(SnapshotRecord)) {
+            std::cerr << "Snapshot " << path << " has an incompatible layout" << std::endl;
+            return QubitSnapshot();
+        }
+        return snap;
+    }
+
+    bool valid() const { return base != nullptr; }
+    size_t size() const { return base ? header()->count : 0; }
+    const SnapshotHeader& info() const { return *header(); }
+    const SnapshotRecord& operator[](size_t i) const { return records()[i]; }
+
+    // Binary search by segment name; nullptr if absent
+    const QubitState* find(const std::string& name) const {
+        const SnapshotRecord* first = records();
+        const SnapshotRecord* last = first + size();
+        const SnapshotRecord* it = std::lower_bound(first, last, name,
+            [](const SnapshotRecord& r, const std::string& n) { return strcmp(r.name, n.c_str()) < 0; });
+        return it != last && name == it->name ? &it->state : nullptr;
+    }
+
+    // Copy every record whose name starts with `prefix` into its
+    // shared-memory segment; returns how many were written
+    size_t publish(const char* prefix = "") const {
+        size_t prefix_len = strlen(prefix);
+        uint64_t now_ns = OpTimer::nowNs();
+        int64_t shift_ns = int64_t(now_ns) - int64_t(header()->saved_steady_ns);
+        size_t written = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            const SnapshotRecord& rec = records()[i];
+            if (strncmp(rec.name, prefix, prefix_len) != 0) continue;
+            QubitState s = rec.state;
+            s.created_at = rebase(s.created_at, shift_ns / 1000000);
+            if (s.relaxed_at_ns) s.relaxed_at_ns = rebase(s.relaxed_at_ns, shift_ns);
+            s.owner_pid = 0;  // unowned until a Qubit opens it
+            s.owner_start = s.owner_since_ms = 0;
+            if (writeSegment(rec.name, s)) written++;
+        }
+        return written;
+    }
+
+private:
+    void*  base = nullptr;
+    size_t length = 0;
+
+    const SnapshotHeader* header() const { return static_cast<const SnapshotHeader*>(base); }
+    const SnapshotRecord* records() const {
+        return reinterpret_cast<const SnapshotRecord*>(static_cast<const char*>(base) + sizeof(SnapshotHeader));
+    }
+
+    static uint64_t rebase(uint64_t t, int64_t shift) {
+        int64_t shifted = int64_t(t) + shift;
+        return shifted > 0 ? uint64_t(shifted) : 0;
+    }
+
+    static bool writeAll(int fd, const void* data, size_t len, off_t offset) {
+        const char* p = static_cast<const char*>(data);
+        while (len > 0) {
+            ssize_t n = pwrite(fd, p, len, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n; len -= n; offset += n;
+        }
+        return true;
+    }
+
+    static bool readSegment(const std::string& name, QubitState& out) {
+        int fd = shm_open(qubitShmName(name).c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        bool ok = pread(fd, &out, sizeof(QubitState), 0) == ssize_t(sizeof(QubitState));
+        close(fd);
+        return ok && out.magic == QUBIT_STATE_MAGIC && out.version == QUBIT_STATE_VERSION;
+    }
+
+    static bool writeSegment(const char* name, const QubitState& s) {
+        int fd = shm_open(qubitShmName(name).c_str(), O_RDWR | O_CREAT, 0666);
+        if (fd < 0) { perror("shm_open"); return false; }
+        bool ok = ftruncate(fd, sizeof(QubitState)) == 0 &&
+                  pwrite(fd, &s, sizeof(QubitState), 0) == ssize_t(sizeof(QubitState));
+        close(fd);
+        return ok;
+    }
+
+    // Candidate qubit segments are the /dev/shm entries exactly one
+    // QubitState long; readSegment() then checks the magic. Names come back
+    // without the namespace prefix.
+    static std::vector<std::string> listSegments(const char* prefix) {
+        std::vector<std::string> names;
+        DIR* dir = opendir("/dev/shm");
+        if (!dir) { perror("opendir /dev/shm"); return names; }
+        std::string full = qubitShmName(prefix);
+        size_t ns_len = strlen(qubitShmPrefix());
+        while (struct dirent* e = readdir(dir)) {
+            if (e->d_name[0] == '.' || strncmp(e->d_name, full.c_str(), full.size()) != 0) continue;
+            struct stat st;
+            std::string path = std::string("/dev/shm/") + e->d_name;
+            if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size == sizeof(QubitState))
+                names.push_back(e->d_name + ns_len);
+        }
+        closedir(dir);
+        return names;
+    }
+};
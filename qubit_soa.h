@@ -0,0 +1,683 @@
+#pragma once
+
+// Structure-of-arrays arena for many independent qubits.
+//
+// QubitArena stores whole QubitStates back to back, so a gate over a range
+// strides 344 bytes between amplitudes and cannot vectorize. A
+// QubitSoaArena keeps only what independent qubits need, in five arrays
+// that each start on a 64-byte boundary in one mapping (any ArenaBacking):
+//
+//   alpha_re[]  alpha_im[]  beta_re[]  beta_im[]   T (double or float)
+//   measured[]                                      uint8_t, 2 = superposition
+//
+// BasicSoaArena<T> is templated on the amplitude type. QubitSoaArena
+// (double) is the default. FloatSoaArena halves the bytes per qubit (17
+// instead of 33) and doubles the lanes per instruction, at about seven
+// significant digits; BENCH 13 reports its fidelity and speed.
+//
+// applyGateRange() runs one AVX-512 loop over 8 (double) or 16 (float)
+// qubits at a time, masked so collapsed qubits are left alone, when the
+// CPU has AVX-512 (checked at run time; no -march flag needed). Otherwise
+// it runs a scalar loop. Both round exactly like applyGateToAmplitudes<T>().
+//
+// measureRange() collapses a whole range in one pass and returns the
+// results as a packed bitset. Each qubit draws from a counter-based
+// generator: splitmix64 of a per-call key plus the qubit's index. Lanes
+// need no shared state, the scalar and AVX-512 kernels draw the same
+// numbers, and splitting a range over workers does not change the results.
+//
+// normalizeStates() checks |alpha|^2 + |beta|^2 against a NormPolicy
+// without a branch per qubit: the AVX-512 kernel reduces counts and the
+// largest deviation from lane masks and rescales with masked stores.
+// loadStates() ingests interleaved external amplitudes, normalizing them
+// chunk by chunk while they are still in cache.
+//
+// expectations() evaluates many Pauli strings together. One vector pass
+// computes <X>, <Y> and <Z> for every qubit the strings touch, and then
+// each string is a product of table lookups.
+//
+// The measurement, normalization and Pauli kernels have AVX-512 versions
+// for double only; float arenas use their scalar loops.
+//
+// Per-qubit access goes through SoaQubit handles, which offer the Qubit
+// calls that make sense without links or decoherence. One mutex guards the
+// whole arena.
+
+#include "qubit_arena.h"
+
+#include <limits>
+
+const uint32_t SOA_MAGIC = 0x514f5341;  // "QSOA"
+
+// The five arrays of an SoA arena (or of any range of one)
+template <typename T>
+struct BasicSoaView {
+    T*       alpha_re;
+    T*       alpha_im;
+    T*       beta_re;
+    T*       beta_im;
+    uint8_t* measured;
+};
+
+typedef BasicSoaView<double> SoaView;
+typedef BasicSoaView<float>  FloatSoaView;
+
+// Gate on [begin, end), one qubit at a time; false for an unknown gate
+template <typename T>
+inline bool soaGateScalar(const BasicSoaView<T>& v, size_t begin, size_t end, char gate) {
+    for (size_t i = begin; i < end; ++i) {
+        if (v.measured[i] != 2) continue;
+        if (!applyGateToAmplitudes(v.alpha_re[i], v.alpha_im[i], v.beta_re[i], v.beta_im[i], gate)) return false;
+    }
+    return true;
+}
+
+const uint64_t SOA_GOLDEN = 0x9e3779b97f4a7c15ULL;
+
+inline uint64_t soaMix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1) for qubit i of the measurement keyed `key`
+inline double soaUniform(uint64_t key, size_t i) {
+    return double(soaMix(key + (i + 1) * SOA_GOLDEN) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// P(1) of qubit i, in double whatever the storage type
+template <typename T>
+inline double soaProbabilityOne(const BasicSoaView<T>& v, size_t i) {
+    double br = v.beta_re[i], bi = v.beta_im[i];
+    return br * br + bi * bi;
+}
+
+// Collapse qubit i if unmeasured and set bit k of `bits` to its value
+template <typename T>
+inline void soaMeasureOne(const BasicSoaView<T>& v, size_t i, uint64_t key, uint64_t* bits, size_t k) {
+    uint8_t m = v.measured[i];
+    if (m == 2) {
+        m = soaUniform(key, i) < soaProbabilityOne(v, i);
+        v.measured[i] = m;
+        v.alpha_re[i] = m ? T(0) : T(1);
+        v.beta_re[i]  = m ? T(1) : T(0);
+        v.alpha_im[i] = v.beta_im[i] = T(0);
+    }
+    bits[k >> 6] |= uint64_t(m) << (k & 63);
+}
+
+// Measure [begin, end) one qubit at a time into (end - begin + 63) / 64 words
+template <typename T>
+inline void soaMeasureScalar(const BasicSoaView<T>& v, size_t begin, size_t end, uint64_t key, uint64_t* bits) {
+    std::memset(bits, 0, (end - begin + 63) / 64 * sizeof(uint64_t));
+    for (size_t i = begin; i < end; ++i) soaMeasureOne(v, i, key, bits, i - begin);
+}
+
+// Norm check of [begin, end) one qubit at a time, computed in double
+template <typename T>
+inline NormReport soaNormalizeScalar(const BasicSoaView<T>& v, size_t begin, size_t end,
+                                     const NormPolicy& policy) {
+    NormReport report;
+    for (size_t i = begin; i < end; ++i) {
+        double ar = v.alpha_re[i], ai = v.alpha_im[i], br = v.beta_re[i], bi = v.beta_im[i];
+        size_t bad = report.out_of_tolerance;
+        normalizeChecked(ar, ai, br, bi, v.measured[i], policy, report);
+        if (report.out_of_tolerance == bad || policy.action != NORM_RENORMALIZE) continue;
+        v.alpha_re[i] = T(ar); v.alpha_im[i] = T(ai);
+        v.beta_re[i]  = T(br); v.beta_im[i]  = T(bi);
+    }
+    return report;
+}
+
+const size_t PAULI_BLOCK = 256;  // expectations() tabulates this many qubits per kernel call
+
+// <X>, <Y>, <Z> of each qubit in [begin, end) into x, y, z[i - begin]
+template <typename T>
+inline void soaPauliScalar(const BasicSoaView<T>& v, size_t begin, size_t end, double* x, double* y, double* z) {
+    for (size_t i = begin; i < end; ++i)
+        pauliTriple(v.alpha_re[i], v.alpha_im[i], v.beta_re[i], v.beta_im[i], v.measured[i],
+                    x[i - begin], y[i - begin], z[i - begin]);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+#define QUBIT_HAS_AVX512_KERNELS 1
+#define QUBIT_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq")))
+
+// The AVX-512 operations the gate kernel needs, per amplitude type
+template <typename T> struct SoaSimd;
+
+template <> struct SoaSimd<double> {
+    typedef __m512d  Vec;
+    typedef __mmask8 Mask;
+    static const size_t lanes = 8;
+
+    // Lanes whose measured byte is 2
+    QUBIT_AVX512 static Mask live(const uint8_t* m) {
+        return _mm_cmpeq_epi8_mask(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(m)), _mm_set1_epi8(2));
+    }
+    QUBIT_AVX512 static Vec load(const double* p) { return _mm512_loadu_pd(p); }
+    QUBIT_AVX512 static void store(double* p, Mask k, Vec x) { _mm512_mask_storeu_pd(p, k, x); }
+    QUBIT_AVX512 static Vec set1(double x) { return _mm512_set1_pd(x); }
+    QUBIT_AVX512 static Vec add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+    QUBIT_AVX512 static Vec sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+    QUBIT_AVX512 static Vec div(Vec a, Vec b) { return _mm512_div_pd(a, b); }
+    // -x by flipping the sign bit, as scalar negation does (also for zeros)
+    QUBIT_AVX512 static Vec neg(Vec x) {
+        return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(x), _mm512_set1_epi64(INT64_MIN)));
+    }
+};
+
+template <> struct SoaSimd<float> {
+    typedef __m512    Vec;
+    typedef __mmask16 Mask;
+    static const size_t lanes = 16;
+
+    QUBIT_AVX512 static Mask live(const uint8_t* m) {
+        return _mm_cmpeq_epi8_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(m)), _mm_set1_epi8(2));
+    }
+    QUBIT_AVX512 static Vec load(const float* p) { return _mm512_loadu_ps(p); }
+    QUBIT_AVX512 static void store(float* p, Mask k, Vec x) { _mm512_mask_storeu_ps(p, k, x); }
+    QUBIT_AVX512 static Vec set1(float x) { return _mm512_set1_ps(x); }
+    QUBIT_AVX512 static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+    QUBIT_AVX512 static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+    QUBIT_AVX512 static Vec div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+    QUBIT_AVX512 static Vec neg(Vec x) {
+        return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(x), _mm512_set1_epi32(INT32_MIN)));
+    }
+};
+
+// One gate over SoaSimd<T>::lanes qubits; stores only lanes whose measured
+// byte is 2
+template <char G, typename T>
+QUBIT_AVX512 inline void soaGateStep(const BasicSoaView<T>& v, size_t i) {
+    typedef SoaSimd<T> S;
+    typename S::Mask live = S::live(v.measured + i);
+    if (!live) return;
+    typename S::Vec ar = S::load(v.alpha_re + i), ai = S::load(v.alpha_im + i);
+    typename S::Vec br = S::load(v.beta_re + i),  bi = S::load(v.beta_im + i);
+    const typename S::Vec sqrt2 = S::set1(T(M_SQRT2));
+    typename S::Vec nar = ar, nai = ai, nbr = br, nbi = bi;
+    if (G == 'H') {
+        nar = S::div(S::add(ar, br), sqrt2);
+        nai = S::div(S::add(ai, bi), sqrt2);
+        nbr = S::div(S::sub(ar, br), sqrt2);
+        nbi = S::div(S::sub(ai, bi), sqrt2);
+    } else if (G == 'X') {
+        nar = br; nai = bi; nbr = ar; nbi = ai;
+    } else if (G == 'Z') {
+        nbr = S::neg(br);
+        nbi = S::neg(bi);
+    } else if (G == 'S') {
+        nbr = S::neg(bi);
+        nbi = br;
+    } else if (G == 'T') {
+        nbr = S::div(S::sub(br, bi), sqrt2);
+        nbi = S::div(S::add(br, bi), sqrt2);
+    }
+    if (G == 'H' || G == 'X') {
+        S::store(v.alpha_re + i, live, nar);
+        S::store(v.alpha_im + i, live, nai);
+    }
+    S::store(v.beta_re + i, live, nbr);
+    S::store(v.beta_im + i, live, nbi);
+}
+
+template <char G, typename T>
+QUBIT_AVX512 void soaGateLoop(const BasicSoaView<T>& v, size_t begin, size_t end) {
+    const size_t lanes = SoaSimd<T>::lanes;
+    size_t i = begin;
+    for (; i + lanes <= end; i += lanes) soaGateStep<G>(v, i);
+    soaGateScalar(v, i, end, G);
+}
+
+// Gate on [begin, end) a vector of qubits at a time; call only when
+// soaHasAvx512(); false for an unknown gate
+template <typename T>
+QUBIT_AVX512 inline bool soaGateAvx512(const BasicSoaView<T>& v, size_t begin, size_t end, char gate) {
+    switch (gate) {
+        case 'H': soaGateLoop<'H'>(v, begin, end); return true;
+        case 'X': soaGateLoop<'X'>(v, begin, end); return true;
+        case 'Z': soaGateLoop<'Z'>(v, begin, end); return true;
+        case 'S': soaGateLoop<'S'>(v, begin, end); return true;
+        case 'T': soaGateLoop<'T'>(v, begin, end); return true;
+        default:  return false;
+    }
+}
+
+// Measure [begin, end) eight qubits at a time, one bitset byte per step;
+// call only when soaHasAvx512()
+QUBIT_AVX512 inline void soaMeasureAvx512(const SoaView& v, size_t begin, size_t end, uint64_t key,
+                                          uint64_t* bits) {
+    std::memset(bits, 0, (end - begin + 63) / 64 * sizeof(uint64_t));
+    uint8_t* out = reinterpret_cast<uint8_t*>(bits);
+    const __m512i lanes = _mm512_set_epi64(7 * SOA_GOLDEN, 6 * SOA_GOLDEN, 5 * SOA_GOLDEN, 4 * SOA_GOLDEN,
+                                           3 * SOA_GOLDEN, 2 * SOA_GOLDEN, SOA_GOLDEN, 0);
+    const __m512i m1 = _mm512_set1_epi64(0xbf58476d1ce4e5b9ULL), m2 = _mm512_set1_epi64(0x94d049bb133111ebULL);
+    const __m512d scale = _mm512_set1_pd(1.0 / 9007199254740992.0);
+    const __m512d zero = _mm512_setzero_pd(), one = _mm512_set1_pd(1.0);
+    size_t i = begin;
+    // (maskz shifts: the plain ones trip -Wmaybe-uninitialized in GCC 12 headers)
+    for (; i + 8 <= end; i += 8) {
+        __m128i m = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v.measured + i));
+        __mmask8 live = _mm_cmpeq_epi8_mask(m, _mm_set1_epi8(2));
+        __mmask8 ones = _mm_cmpeq_epi8_mask(m, _mm_set1_epi8(1));
+        __mmask8 drawn = 0;
+        if (live) {
+            __m512d br = _mm512_loadu_pd(v.beta_re + i), bi = _mm512_loadu_pd(v.beta_im + i);
+            __m512d p1 = _mm512_add_pd(_mm512_mul_pd(br, br), _mm512_mul_pd(bi, bi));
+            __m512i z = _mm512_add_epi64(_mm512_set1_epi64(key + (i + 1) * SOA_GOLDEN), lanes);
+            z = _mm512_mullo_epi64(_mm512_xor_si512(z, _mm512_maskz_srli_epi64(0xff, z, 30)), m1);
+            z = _mm512_mullo_epi64(_mm512_xor_si512(z, _mm512_maskz_srli_epi64(0xff, z, 27)), m2);
+            z = _mm512_xor_si512(z, _mm512_maskz_srli_epi64(0xff, z, 31));
+            __m512d u = _mm512_mul_pd(_mm512_cvtepu64_pd(_mm512_maskz_srli_epi64(0xff, z, 11)), scale);
+            drawn = _mm512_mask_cmp_pd_mask(live, u, p1, _CMP_LT_OQ);
+            _mm512_mask_storeu_pd(v.alpha_re + i, live, _mm512_mask_blend_pd(drawn, one, zero));
+            _mm512_mask_storeu_pd(v.beta_re + i, live, _mm512_mask_blend_pd(drawn, zero, one));
+            _mm512_mask_storeu_pd(v.alpha_im + i, live, zero);
+            _mm512_mask_storeu_pd(v.beta_im + i, live, zero);
+            _mm_mask_storeu_epi8(v.measured + i, live, _mm_maskz_mov_epi8(drawn, _mm_set1_epi8(1)));
+        }
+        out[(i - begin) >> 3] = uint8_t(drawn | ones);
+    }
+    for (; i < end; ++i) soaMeasureOne(v, i, key, bits, i - begin);
+}
+
+// Norm check of [begin, end) eight qubits at a time; same results as
+// soaNormalizeScalar()
+QUBIT_AVX512 inline NormReport soaNormalizeAvx512(const SoaView& v, size_t begin, size_t end,
+                                                  const NormPolicy& policy) {
+    const __m512d one = _mm512_set1_pd(1.0), zero = _mm512_setzero_pd();
+    const __m512d tol = _mm512_set1_pd(policy.tolerance), big = _mm512_set1_pd(DBL_MAX);
+    const bool fix = policy.action == NORM_RENORMALIZE;
+    __m512d max_dev = zero;
+    size_t checked = 0, bad_count = 0, invalid_count = 0;
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __mmask8 live = _mm_cmpeq_epi8_mask(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v.measured + i)),
+                                            _mm_set1_epi8(2));
+        __m512d ar = _mm512_loadu_pd(v.alpha_re + i), ai = _mm512_loadu_pd(v.alpha_im + i);
+        __m512d br = _mm512_loadu_pd(v.beta_re + i),  bi = _mm512_loadu_pd(v.beta_im + i);
+        // The _round form keeps GCC from fusing these into FMAs, which would
+        // round differently from amplitudeNorm()
+        const int rc = _MM_FROUND_CUR_DIRECTION;
+        __m512d n = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(_mm512_maskz_mul_round_pd(0xff, ar, ar, rc),
+                                                              _mm512_maskz_mul_round_pd(0xff, ai, ai, rc)),
+                                                _mm512_maskz_mul_round_pd(0xff, br, br, rc)),
+                                  _mm512_maskz_mul_round_pd(0xff, bi, bi, rc));
+        __m512d dev = _mm512_abs_pd(_mm512_sub_pd(n, one));
+        __mmask8 finite = _mm512_mask_cmp_pd_mask(live, n, zero, _CMP_GT_OQ) &
+                          _mm512_cmp_pd_mask(n, big, _CMP_LE_OQ);
+        __mmask8 bad = _mm512_mask_cmp_pd_mask(live, dev, tol, _CMP_NLE_UQ);  // NaN counts as bad
+        __mmask8 invalid = bad & ~finite;
+        max_dev = _mm512_mask_max_pd(max_dev, live & ~invalid, max_dev, dev);
+        checked += __builtin_popcount(live);
+        bad_count += __builtin_popcount(bad);
+        invalid_count += __builtin_popcount(invalid);
+        if (fix) {  // loop-invariant; masks do the per-qubit work
+            __mmask8 scale_it = bad & finite;
+            __m512d scale = _mm512_div_pd(one, _mm512_maskz_sqrt_pd(0xff, n));
+            _mm512_mask_storeu_pd(v.alpha_re + i, scale_it, _mm512_mul_pd(ar, scale));
+            _mm512_mask_storeu_pd(v.alpha_im + i, scale_it, _mm512_mul_pd(ai, scale));
+            _mm512_mask_storeu_pd(v.beta_re + i, scale_it, _mm512_mul_pd(br, scale));
+            _mm512_mask_storeu_pd(v.beta_im + i, scale_it, _mm512_mul_pd(bi, scale));
+            _mm512_mask_storeu_pd(v.alpha_re + i, invalid, one);
+            _mm512_mask_storeu_pd(v.alpha_im + i, invalid, zero);
+            _mm512_mask_storeu_pd(v.beta_re + i, invalid, zero);
+            _mm512_mask_storeu_pd(v.beta_im + i, invalid, zero);
+        }
+    }
+    NormReport report = soaNormalizeScalar(v, i, end, policy);
+    report.checked += checked;
+    report.out_of_tolerance += bad_count;
+    report.invalid += invalid_count;
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, max_dev);
+    for (double d : lanes) report.max_deviation = std::max(report.max_deviation, d);
+    return report;
+}
+
+// The same eight qubits at a time; same results as soaPauliScalar(). The
+// tail is a masked block rather than a scalar loop, since GCC would
+// contract that loop into FMAs under this target.
+QUBIT_AVX512 inline void soaPauliAvx512(const SoaView& v, size_t begin, size_t end, double* x, double* y,
+                                        double* z) {
+    const int rc = _MM_FROUND_CUR_DIRECTION;  // unfused products, as in soaNormalizeAvx512()
+    const __m512d two = _mm512_set1_pd(2.0), one = _mm512_set1_pd(1.0), minus_one = _mm512_set1_pd(-1.0);
+    for (size_t i = begin; i < end; i += 8) {
+        __mmask8 k = end - i >= 8 ? __mmask8(0xff) : __mmask8((1u << (end - i)) - 1);
+        __m128i m = _mm_maskz_loadu_epi8(k, v.measured + i);
+        __mmask8 live = _mm_cmpeq_epi8_mask(m, _mm_set1_epi8(2));
+        __mmask8 ones = _mm_cmpeq_epi8_mask(m, _mm_set1_epi8(1));
+        __m512d ar = _mm512_maskz_loadu_pd(k, v.alpha_re + i), ai = _mm512_maskz_loadu_pd(k, v.alpha_im + i);
+        __m512d br = _mm512_maskz_loadu_pd(k, v.beta_re + i),  bi = _mm512_maskz_loadu_pd(k, v.beta_im + i);
+        __m512d px = _mm512_mul_pd(two, _mm512_add_pd(_mm512_maskz_mul_round_pd(0xff, ar, br, rc),
+                                                      _mm512_maskz_mul_round_pd(0xff, ai, bi, rc)));
+        __m512d py = _mm512_mul_pd(two, _mm512_sub_pd(_mm512_maskz_mul_round_pd(0xff, ar, bi, rc),
+                                                      _mm512_maskz_mul_round_pd(0xff, ai, br, rc)));
+        __m512d pz = _mm512_sub_pd(_mm512_add_pd(_mm512_maskz_mul_round_pd(0xff, ar, ar, rc),
+                                                 _mm512_maskz_mul_round_pd(0xff, ai, ai, rc)),
+                                   _mm512_add_pd(_mm512_maskz_mul_round_pd(0xff, br, br, rc),
+                                                 _mm512_maskz_mul_round_pd(0xff, bi, bi, rc)));
+        size_t o = i - begin;
+        _mm512_mask_storeu_pd(x + o, k, _mm512_maskz_mov_pd(live, px));
+        _mm512_mask_storeu_pd(y + o, k, _mm512_maskz_mov_pd(live, py));
+        _mm512_mask_storeu_pd(z + o, k, _mm512_mask_blend_pd(live, _mm512_mask_blend_pd(ones, one, minus_one), pz));
+    }
+}
+#endif
+
+inline bool soaHasAvx512() {
+#ifdef QUBIT_HAS_AVX512_KERNELS
+    static const bool has = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                            __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq");
+    return has;
+#else
+    return false;
+#endif
+}
+
+inline const char* soaKernelName() { return soaHasAvx512() ? "avx512" : "scalar"; }
+
+// Fastest kernel this CPU runs
+template <typename T>
+inline bool soaGate(const BasicSoaView<T>& v, size_t begin, size_t end, char gate) {
+#ifdef QUBIT_HAS_AVX512_KERNELS
+    if (soaHasAvx512()) return soaGateAvx512(v, begin, end, gate);
+#endif
+    return soaGateScalar(v, begin, end, gate);
+}
+
+template <typename T>
+inline NormReport soaNormalize(const BasicSoaView<T>& v, size_t begin, size_t end, const NormPolicy& policy) {
+    return soaNormalizeScalar(v, begin, end, policy);
+}
+
+inline NormReport soaNormalize(const SoaView& v, size_t begin, size_t end, const NormPolicy& policy) {
+#ifdef QUBIT_HAS_AVX512_KERNELS
+    if (soaHasAvx512()) return soaNormalizeAvx512(v, begin, end, policy);
+#endif
+    return soaNormalizeScalar(v, begin, end, policy);
+}
+
+template <typename T>
+inline void soaMeasure(const BasicSoaView<T>& v, size_t begin, size_t end, uint64_t key, uint64_t* bits) {
+    soaMeasureScalar(v, begin, end, key, bits);
+}
+
+inline void soaMeasure(const SoaView& v, size_t begin, size_t end, uint64_t key, uint64_t* bits) {
+#ifdef QUBIT_HAS_AVX512_KERNELS
+    if (soaHasAvx512()) return soaMeasureAvx512(v, begin, end, key, bits);
+#endif
+    soaMeasureScalar(v, begin, end, key, bits);
+}
+
+template <typename T>
+inline void soaPauli(const BasicSoaView<T>& v, size_t begin, size_t end, double* x, double* y, double* z) {
+    soaPauliScalar(v, begin, end, x, y, z);
+}
+
+inline void soaPauli(const SoaView& v, size_t begin, size_t end, double* x, double* y, double* z) {
+#ifdef QUBIT_HAS_AVX512_KERNELS
+    if (soaHasAvx512()) return soaPauliAvx512(v, begin, end, x, y, z);
+#endif
+    soaPauliScalar(v, begin, end, x, y, z);
+}
+
+template <typename T> class BasicSoaQubit;
+
+template <typename T>
+class BasicSoaArena {
+public:
+    typedef T Scalar;
+
+    BasicSoaArena(const std::string& name, uint32_t taskId, size_t capacity,
+                  const ArenaOptions& options = ArenaOptions())
+        : count(capacity), stride((capacity + 63) / 64 * 64),
+          mapping(name, sizeof(ArenaHeader) + stride * (4 * sizeof(T) + 1), options) {
+        mapping.initHeader(SOA_MAGIC, 4 * sizeof(T) + 1, taskId, capacity);
+        char* base = mapping.data() + sizeof(ArenaHeader);
+        arrays.alpha_re = reinterpret_cast<T*>(base);
+        arrays.alpha_im = arrays.alpha_re + stride;
+        arrays.beta_re  = arrays.alpha_im + stride;
+        arrays.beta_im  = arrays.beta_re + stride;
+        arrays.measured = reinterpret_cast<uint8_t*>(arrays.beta_im + stride);
+    }
+
+    BasicSoaArena(const BasicSoaArena&) = delete;
+    BasicSoaArena& operator=(const BasicSoaArena&) = delete;
+
+    size_t size() const { return count; }
+    const std::string& name() const { return mapping.name(); }
+    ArenaBacking backing() const { return mapping.backing(); }
+    size_t bytes() const { return mapping.bytes(); }
+
+    // Raw arrays; callers running their own kernels hold lock() around access
+    const BasicSoaView<T>& view() const { return arrays; }
+    std::mutex& lock() { return mtx; }
+
+    BasicSoaQubit<T> qubit(size_t i) { return BasicSoaQubit<T>(*this, i); }
+
+    // The default NormPolicy, loosened to what T can hold
+    static NormPolicy defaultPolicy() {
+        NormPolicy policy;
+        policy.tolerance = std::max(policy.tolerance, 100.0 * std::numeric_limits<T>::epsilon());
+        return policy;
+    }
+
+    void setState(size_t i, double ar, double ai, double br, double bi) {
+        std::lock_guard<std::mutex> lock(mtx);
+        arrays.alpha_re[i] = T(ar); arrays.alpha_im[i] = T(ai);
+        arrays.beta_re[i]  = T(br); arrays.beta_im[i]  = T(bi);
+        arrays.measured[i] = 2;
+    }
+
+    // setState() scaled to unit norm; false (state unchanged) if invalid
+    bool setStateNormalized(size_t i, double ar, double ai, double br, double bi) {
+        if (!normalizeAmplitudes(ar, ai, br, bi)) return false;
+        setState(i, ar, ai, br, bi);
+        return true;
+    }
+
+    // Check (and with NORM_RENORMALIZE fix) the norm of every unmeasured
+    // qubit in [begin, end)
+    NormReport normalizeStates(size_t begin, size_t end, const NormPolicy& policy = defaultPolicy()) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return soaNormalize(arrays, begin, std::min(end, count), policy);
+    }
+
+    // Set n qubits from `amps` (ar, ai, br, bi per qubit, as external
+    // state vectors usually come) and validate them under `policy`
+    NormReport loadStates(size_t begin, size_t n, const double* amps, const NormPolicy& policy = defaultPolicy()) {
+        std::lock_guard<std::mutex> lock(mtx);
+        const size_t chunk = 512;  // 16 KB of input, checked while still in L1
+        NormReport report;
+        n = std::min(n, count - std::min(begin, count));
+        for (size_t c = begin; c < begin + n; c += chunk) {
+            size_t e = std::min(c + chunk, begin + n);
+            for (size_t i = c; i < e; ++i) {
+                const double* a = amps + 4 * (i - begin);
+                arrays.alpha_re[i] = T(a[0]); arrays.alpha_im[i] = T(a[1]);
+                arrays.beta_re[i]  = T(a[2]); arrays.beta_im[i]  = T(a[3]);
+            }
+            std::memset(arrays.measured + c, 2, e - c);
+            report.add(soaNormalize(arrays, c, e, policy));
+        }
+        return report;
+    }
+
+    void applyGate(size_t i, char gate) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!soaGateScalar(arrays, i, i + 1, gate)) std::cerr << "Unknown gate: " << gate << std::endl;
+    }
+
+    // Apply one gate to every unmeasured qubit in [begin, end)
+    void applyGateRange(size_t begin, size_t end, char gate) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!soaGate(arrays, begin, std::min(end, count), gate))
+            std::cerr << "Unknown gate: " << gate << std::endl;
+    }
+
+    void applyGateAll(char gate) { applyGateRange(0, count, gate); }
+
+    // The same, each worker taking its node's slice (see QubitArena)
+    void applyGateAll(char gate, NumaWorkers& workers) {
+        std::lock_guard<std::mutex> lock(mtx);
+        BasicSoaView<T> v = arrays;
+        workers.parallelFor(count, [v, gate](size_t begin, size_t end) { soaGate(v, begin, end, gate); });
+    }
+
+    uint8_t measure(size_t i) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (arrays.measured[i] != 2) return arrays.measured[i];
+        std::bernoulli_distribution dist(soaProbabilityOne(arrays, i));
+        uint8_t result = dist(rng);
+        arrays.measured[i] = result;
+        arrays.alpha_re[i] = result ? T(0) : T(1);
+        arrays.beta_re[i]  = result ? T(1) : T(0);
+        arrays.alpha_im[i] = arrays.beta_im[i] = T(0);
+        return result;
+    }
+
+    // Measure every unmeasured qubit in [begin, end) in one pass. Bit k of
+    // `bits`, which holds (end - begin + 63) / 64 words, is the value of
+    // qubit begin + k, whether measured now or before.
+    void measureRange(size_t begin, size_t end, uint64_t* bits) {
+        std::lock_guard<std::mutex> lock(mtx);
+        soaMeasure(arrays, begin, std::min(end, count), nextKey(), bits);
+    }
+
+    void measureAll(uint64_t* bits) { measureRange(0, count, bits); }
+
+    // The same over NumaWorkers, in slices of whole bitset words
+    void measureAll(uint64_t* bits, NumaWorkers& workers) {
+        std::lock_guard<std::mutex> lock(mtx);
+        BasicSoaView<T> v = arrays;
+        size_t n = count;
+        uint64_t key = nextKey();
+        workers.parallelFor((n + 63) / 64, [v, n, key, bits](size_t wb, size_t we) {
+            soaMeasure(v, wb * 64, std::min(we * 64, n), key, bits + wb);
+        });
+    }
+
+    uint8_t getMeasurement(size_t i) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return arrays.measured[i];
+    }
+
+    // <X>, <Y> or <Z> of qubit i from its amplitudes
+    double expectation(size_t i, Pauli p) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return expectationLocked(i, p);
+    }
+
+    // <P> of a Pauli string over the arena; terms past the end count as identity
+    double expectation(const PauliString& p) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        double e = 1.0;
+        for (const PauliString::Term& t : p.terms)
+            if (t.qubit < count) e *= expectationLocked(t.qubit, t.op);
+        return e;
+    }
+
+    // Many strings at once. When the strings cover their span densely,
+    // <X>, <Y>, <Z> of every qubit in it are tabulated by the vector kernel
+    // and each string becomes a product of lookups; sparse strings are
+    // gathered term by term. Either way results match expectation().
+    std::vector<double> expectations(const std::vector<PauliString>& strings) const {
+        std::vector<double> out(strings.size(), 1.0);
+        size_t lo = count, hi = 0, terms = 0;
+        for (const PauliString& p : strings) {
+            for (const PauliString::Term& t : p.terms) {
+                if (t.qubit >= count) continue;
+                lo = std::min(lo, t.qubit);
+                hi = std::max(hi, t.qubit);
+                terms++;
+            }
+        }
+        if (!terms) return out;
+        std::lock_guard<std::mutex> lock(mtx);
+        size_t span = hi - lo + 1;
+        if (span > 2 * terms) {
+            for (size_t k = 0; k < strings.size(); ++k)
+                for (const PauliString::Term& t : strings[k].terms)
+                    if (t.qubit < count) out[k] *= expectationLocked(t.qubit, t.op);
+            return out;
+        }
+        std::vector<double> table(3 * span);  // <X> | <Y> | <Z>
+        for (size_t b = lo; b <= hi; b += PAULI_BLOCK)
+            soaPauli(arrays, b, std::min(b + PAULI_BLOCK, hi + 1), &table[b - lo], &table[span + b - lo],
+                     &table[2 * span + b - lo]);
+        for (size_t k = 0; k < strings.size(); ++k)
+            for (const PauliString::Term& t : strings[k].terms)
+                if (t.qubit < count) out[k] *= table[(t.op - 1) * span + (t.qubit - lo)];
+        return out;
+    }
+
+    double probabilityOne(size_t i) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return arrays.measured[i] != 2 ? arrays.measured[i] : soaProbabilityOne(arrays, i);
+    }
+
+    // The qubit as a QubitState (double amplitudes, no links, no timestamps)
+    QubitState readState(size_t i) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        QubitState s;
+        std::memset(&s, 0, sizeof(s));
+        s.alpha_real = arrays.alpha_re[i]; s.alpha_imag = arrays.alpha_im[i];
+        s.beta_real  = arrays.beta_re[i];  s.beta_imag  = arrays.beta_im[i];
+        s.measured = arrays.measured[i];
+        return s;
+    }
+
+    void unlink() { mapping.unlink(); }
+
+private:
+    size_t          count;
+    size_t          stride;  // array length, rounded up to keep each array 64-byte aligned
+    ArenaMapping    mapping;
+    BasicSoaView<T> arrays;
+    mutable std::mutex mtx;
+    std::mt19937 rng{std::random_device{}()};
+
+    uint64_t nextKey() { return (uint64_t(rng()) << 32) | rng(); }
+
+    double expectationLocked(size_t i, Pauli p) const {
+        double e[4] = {1.0, 0.0, 0.0, 0.0};
+        pauliTriple(arrays.alpha_re[i], arrays.alpha_im[i], arrays.beta_re[i], arrays.beta_im[i],
+                    arrays.measured[i], e[1], e[2], e[3]);
+        return e[p];
+    }
+};
+
+typedef BasicSoaArena<double> QubitSoaArena;
+typedef BasicSoaArena<float>  FloatSoaArena;
+
+// One qubit of an SoA arena, used like a Qubit
+template <typename T>
+class BasicSoaQubit {
+public:
+    BasicSoaQubit(BasicSoaArena<T>& arena, size_t index) : owner(&arena), i(index) {}
+
+    void initSuperposition() { owner->setState(i, 1.0 / M_SQRT2, 0.0, 1.0 / M_SQRT2, 0.0); }
+    void setState(double ar, double ai, double br, double bi) { owner->setState(i, ar, ai, br, bi); }
+    bool setStateNormalized(double ar, double ai, double br, double bi) {
+        return owner->setStateNormalized(i, ar, ai, br, bi);
+    }
+    void applyGate(char gate) { owner->applyGate(i, gate); }
+    uint8_t measure() { return owner->measure(i); }
+    bool isMeasured() const { return owner->getMeasurement(i) != 2; }
+    uint8_t getMeasurement() const { return owner->getMeasurement(i); }
+    double probabilityOne() const { return owner->probabilityOne(i); }
+    double expectation(Pauli p) const { return owner->expectation(i, p); }
+    QubitState readState() const { return owner->readState(i); }
+    size_t index() const { return i; }
+
+private:
+    BasicSoaArena<T>* owner;
+    size_t            i;
+};
+
+typedef BasicSoaQubit<double> SoaQubit;
+typedef BasicSoaQubit<float>  FloatSoaQubit;
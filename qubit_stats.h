@@ -0,0 +1,260 @@
+#pragma once
+
+// Per-operation latency histograms exported through a shared-memory page.
+//
+// Every thread that records a latency claims its own slot in the page and is
+// the only writer of that slot, so recording is a couple of relaxed loads and
+// stores with no locked instructions. Readers (see qubitstat.cpp) sum the
+// slots on the fly, which never blocks or pauses the writers.
+//
+// Recording is opt-in (QUBIT_STATS=1), since the page is about 2.4 MB of
+// tmpfs that outlives every process. Remove it with `qubitstat -u`.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "qubit_shm.h"
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "stats page needs lock-free 64-bit atomics");
+
+enum QubitOp : uint32_t {
+    OP_MEASURE = 0,
+    OP_APPLY_GATE,
+    OP_PROPAGATE,
+    OP_DECOHERE,
+    OP_COUNT
+};
+
+inline const char* opName(uint32_t op) {
+    static const char* names[OP_COUNT] = {"measure", "applyGate", "propagate", "decohere"};
+    return op < OP_COUNT ? names[op] : "?";
+}
+
+// HDR-style log-linear buckets over nanoseconds. Values below 2^SUB_BITS get
+// one bucket each; every later power of two is split into 2^(SUB_BITS-1)
+// equal buckets, giving ~3% relative precision up to 2^MAX_EXP ns (~18 min).
+const uint32_t STATS_SUB_BITS    = 6;
+const uint32_t STATS_MAX_EXP     = 40;
+const uint32_t STATS_SUB_COUNT   = 1u << STATS_SUB_BITS;
+const uint32_t STATS_HALF_COUNT  = STATS_SUB_COUNT / 2;
+const uint32_t STATS_BUCKETS     = STATS_SUB_COUNT + (STATS_MAX_EXP - STATS_SUB_BITS + 1) * STATS_HALF_COUNT;
+const uint32_t STATS_SLOTS       = 64;
+const uint32_t STATS_MAGIC       = 0x51535441;  // "QSTA"
+const uint32_t STATS_VERSION     = 1;
+
+inline uint32_t statsBucket(uint64_t ns) {
+    if (ns < STATS_SUB_COUNT) return uint32_t(ns);
+    uint32_t exp = 63 - __builtin_clzll(ns);
+    if (exp > STATS_MAX_EXP) return STATS_BUCKETS - 1;
+    uint32_t shift = exp - STATS_SUB_BITS + 1;
+    return STATS_SUB_COUNT + (exp - STATS_SUB_BITS) * STATS_HALF_COUNT
+         + uint32_t(ns >> shift) - STATS_HALF_COUNT;
+}
+
+// Largest value that falls into bucket `b`
+inline uint64_t statsBucketUpper(uint32_t b) {
+    if (b < STATS_SUB_COUNT) return b;
+    uint32_t octave = (b - STATS_SUB_COUNT) / STATS_HALF_COUNT;
+    uint32_t sub    = (b - STATS_SUB_COUNT) % STATS_HALF_COUNT;
+    uint32_t shift  = octave + 1;
+    return ((uint64_t(STATS_HALF_COUNT + sub + 1)) << shift) - 1;
+}
+
+struct OpHistogram {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> buckets[STATS_BUCKETS];
+};
+
+struct StatsSlot {
+    std::atomic<uint64_t> owner;      // (pid << 32) | thread tag, 0 = free
+    OpHistogram ops[OP_COUNT];
+};
+
+struct StatsPage {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t bucket_count;
+    StatsSlot shared;                 // overflow slot once all slots are taken
+    StatsSlot slots[STATS_SLOTS];
+};
+
+inline const char* statsShmName() {
+    const char* env = std::getenv("QUBIT_STATS_SHM");
+    return env ? env : "qubit_stats";
+}
+
+class QubitStats {
+public:
+    // Record one latency sample for the calling thread
+    static void record(QubitOp op, uint64_t ns) {
+        StatsSlot* slot = localSlot();
+        if (!slot) return;
+        OpHistogram& h = slot->ops[op];
+        if (slot == &page()->shared) {
+            h.count.fetch_add(1, std::memory_order_relaxed);
+            h.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+            h.buckets[statsBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+            uint64_t m = h.max_ns.load(std::memory_order_relaxed);
+            while (ns > m && !h.max_ns.compare_exchange_weak(m, ns, std::memory_order_relaxed)) {}
+            return;
+        }
+        bump(h.count, 1);
+        bump(h.sum_ns, ns);
+        bump(h.buckets[statsBucket(ns)], 1);
+        if (ns > h.max_ns.load(std::memory_order_relaxed))
+            h.max_ns.store(ns, std::memory_order_relaxed);
+    }
+
+    // Shared stats page, or nullptr when stats are off or unavailable
+    static StatsPage* page() {
+        static StatsPage* p = mapPage();
+        return p;
+    }
+
+private:
+    // Single-writer increment: no read-modify-write instruction needed
+    static void bump(std::atomic<uint64_t>& c, uint64_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static StatsPage* mapPage() {
+        const char* env = std::getenv("QUBIT_STATS");
+        if (!env || std::strcmp(env, "0") == 0) return nullptr;
+        int fd = shm_open(qubitShmName(statsShmName()).c_str(), O_RDWR | O_CREAT, 0666);
+        if (fd < 0) { perror("shm_open stats"); return nullptr; }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) < sizeof(StatsPage))
+            ftruncate(fd, sizeof(StatsPage));
+        void* p = mmap(nullptr, sizeof(StatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) { perror("mmap stats"); return nullptr; }
+        StatsPage* page = reinterpret_cast<StatsPage*>(p);
+        // A zero-filled page is already a valid empty page; the header
+        // constants are identical for every writer, so racing here is benign.
+        if (page->magic.load(std::memory_order_acquire) == 0) {
+            page->version = STATS_VERSION;
+            page->slot_count = STATS_SLOTS;
+            page->bucket_count = STATS_BUCKETS;
+            page->magic.store(STATS_MAGIC, std::memory_order_release);
+        } else if (page->magic.load() != STATS_MAGIC || page->version != STATS_VERSION) {
+            std::fprintf(stderr, "stats page '%s' has an incompatible layout, stats disabled\n",
+                         statsShmName());
+            munmap(p, sizeof(StatsPage));
+            return nullptr;
+        }
+        return page;
+    }
+
+    struct SlotClaim {
+        StatsSlot* slot = nullptr;
+        uint64_t   token = 0;
+        ~SlotClaim() {
+            if (slot && token) slot->owner.compare_exchange_strong(token, 0);
+        }
+    };
+
+    static bool ownerAlive(uint64_t owner) {
+        pid_t pid = pid_t(owner >> 32);
+        return kill(pid, 0) == 0 || errno != ESRCH;
+    }
+
+    static StatsSlot* localSlot() {
+        static thread_local SlotClaim claim;
+        if (claim.slot) return claim.slot;
+        StatsPage* p = page();
+        if (!p) return nullptr;
+        static std::atomic<uint32_t> next_tag{1};
+        uint64_t token = (uint64_t(getpid()) << 32) | next_tag.fetch_add(1);
+        for (uint32_t i = 0; i < STATS_SLOTS; ++i) {
+            uint64_t cur = p->slots[i].owner.load();
+            // Slots of crashed processes are taken over; their counts stay.
+            if ((cur == 0 || !ownerAlive(cur)) &&
+                p->slots[i].owner.compare_exchange_strong(cur, token)) {
+                claim.slot = &p->slots[i];
+                claim.token = token;
+                return claim.slot;
+            }
+        }
+        claim.slot = &p->shared;
+        return claim.slot;
+    }
+};
+
+// Times a scope and records it into the stats page on exit
+class OpTimer {
+public:
+    explicit OpTimer(QubitOp op) : op_(op), start_(nowNs()) {}
+    ~OpTimer() { QubitStats::record(op_, elapsedNs()); }
+
+    uint64_t elapsedNs() const { return nowNs() - start_; }
+
+    static uint64_t nowNs() {
+        auto tp = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(tp).count();
+    }
+
+private:
+    QubitOp  op_;
+    uint64_t start_;
+};
+
+// OpTimer's interface without the clock reads, for code built to skip
+// latency stats
+struct NullTimer {
+    explicit NullTimer(QubitOp) {}
+    uint64_t elapsedNs() const { return 0; }
+};
+
+// Aggregated view of one operation across all slots
+struct OpSummary {
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t buckets[STATS_BUCKETS] = {};
+
+    // Value at quantile q (0..1), reported as the bucket's upper bound
+    uint64_t percentile(double q) const {
+        if (count == 0) return 0;
+        uint64_t target = uint64_t(q * double(count));
+        if (target == 0) target = 1;
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < STATS_BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen >= target) return std::min(statsBucketUpper(b), max_ns);
+        }
+        return max_ns;
+    }
+};
+
+inline void addSlot(const StatsSlot& s, OpSummary out[OP_COUNT]) {
+    for (uint32_t op = 0; op < OP_COUNT; ++op) {
+        const OpHistogram& h = s.ops[op];
+        out[op].count  += h.count.load(std::memory_order_relaxed);
+        out[op].sum_ns += h.sum_ns.load(std::memory_order_relaxed);
+        uint64_t m = h.max_ns.load(std::memory_order_relaxed);
+        if (m > out[op].max_ns) out[op].max_ns = m;
+        for (uint32_t b = 0; b < STATS_BUCKETS; ++b)
+            out[op].buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+    }
+}
+
+// Sum every slot of the page; safe to call while writers are running
+inline void aggregateStats(const StatsPage* page, OpSummary out[OP_COUNT]) {
+    for (uint32_t op = 0; op < OP_COUNT; ++op) out[op] = OpSummary();
+    addSlot(page->shared, out);
+    for (uint32_t i = 0; i < STATS_SLOTS; ++i) addSlot(page->slots[i], out);
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+// Opt-in binary event trace kept in a shared-memory ring.
+//
+// Tracing is off until QUBIT_TRACE is set in the environment (its value is
+// the ring capacity, 1 selects the default) or QubitTrace::enable() is called.
+// While off, every trace point costs one load and a branch. While on, an
+// event is a fetch_add on the ring head, a TSC read and a 32-byte store.
+// qubittrace.cpp decodes the ring as text or Chrome trace JSON.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "qubit_shm.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum TraceEventType : uint8_t {
+    EV_GATE = 1,
+    EV_SET_STATE,
+    EV_MEASURE,
+    EV_PROPAGATE,
+    EV_DECOHERE,
+    EV_ENTANGLE,
+    EV_TYPE_COUNT
+};
+
+inline const char* traceEventName(uint8_t type) {
+    static const char* names[EV_TYPE_COUNT] = {
+        "?", "gate", "setState", "measure", "propagate", "decohere", "entangle"};
+    return type < EV_TYPE_COUNT ? names[type] : "?";
+}
+
+struct TraceRecord {
+    std::atomic<uint64_t> seq;  // event index + 1 once published, 0 while written
+    uint64_t tsc;
+    uint32_t qubit_id;
+    uint32_t peer_id;           // propagate/entangle target, 0 otherwise
+    uint32_t task_id;
+    uint8_t  type;
+    uint8_t  arg;               // gate name or measured value
+    uint16_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 32, "trace records are 32 bytes");
+
+const uint32_t TRACE_MAGIC        = 0x51545243;  // "QTRC"
+const uint32_t TRACE_VERSION      = 1;
+const uint32_t TRACE_NAME_SLOTS   = 1024;
+const uint32_t TRACE_NAME_LEN     = 60;
+const uint64_t TRACE_DEFAULT_CAPACITY = 1u << 20;
+
+struct TraceName {
+    std::atomic<uint32_t> id;
+    char name[TRACE_NAME_LEN];
+};
+
+struct TraceRing {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t capacity;          // power of two
+    double   tsc_per_us;
+    uint64_t tsc_origin;        // TSC value at ring creation
+    uint64_t wall_origin_ns;    // CLOCK_REALTIME at ring creation
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) TraceName names[TRACE_NAME_SLOTS];
+    TraceRecord records[1];     // `capacity` records follow
+
+    static size_t bytesFor(uint64_t capacity) {
+        return offsetof(TraceRing, records) + capacity * sizeof(TraceRecord);
+    }
+};
+
+inline uint64_t traceTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    auto tp = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp).count();
+#endif
+}
+
+// FNV-1a; qubits are identified in events by the hash of their shm name
+inline uint32_t traceId(const char* name) {
+    uint32_t h = 2166136261u;
+    for (; *name; ++name) { h ^= uint8_t(*name); h *= 16777619u; }
+    return h ? h : 1;
+}
+
+inline const char* traceShmName() {
+    const char* env = std::getenv("QUBIT_TRACE_SHM");
+    return env ? env : "qubit_trace";
+}
+
+// Map an existing ring read-only for decoding; nullptr if absent or foreign
+inline const TraceRing* openTraceRing(const char* name, size_t* mapped) {
+    int fd = shm_open(qubitShmName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(TraceRing)) { close(fd); return nullptr; }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return nullptr;
+    const TraceRing* r = reinterpret_cast<const TraceRing*>(p);
+    if (r->magic.load() != TRACE_MAGIC || r->version != TRACE_VERSION ||
+        TraceRing::bytesFor(r->capacity) > size_t(st.st_size)) {
+        munmap(p, st.st_size);
+        return nullptr;
+    }
+    *mapped = st.st_size;
+    return r;
+}
+
+// Visit the events still held in the ring, oldest first. Records that are
+// being overwritten while we read them are skipped.
+template <class Fn>
+void readTrace(const TraceRing* r, Fn fn) {
+    uint64_t head = r->head.load(std::memory_order_acquire);
+    uint64_t first = head > r->capacity ? head - r->capacity : 0;
+    for (uint64_t i = first; i < head; ++i) {
+        const TraceRecord& src = r->records[i & (r->capacity - 1)];
+        if (src.seq.load(std::memory_order_acquire) != i + 1) continue;
+        TraceRecord copy;
+        copy.tsc = src.tsc;
+        copy.qubit_id = src.qubit_id;
+        copy.peer_id = src.peer_id;
+        copy.task_id = src.task_id;
+        copy.type = src.type;
+        copy.arg = src.arg;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (src.seq.load(std::memory_order_relaxed) != i + 1) continue;
+        copy.seq.store(i + 1, std::memory_order_relaxed);
+        fn(copy);
+    }
+}
+
+// Name registered for a qubit id, or nullptr
+inline const char* traceLookupName(const TraceRing* r, uint32_t id) {
+    for (uint32_t n = 0; n < TRACE_NAME_SLOTS; ++n) {
+        const TraceName& slot = r->names[(id + n) % TRACE_NAME_SLOTS];
+        uint32_t cur = slot.id.load(std::memory_order_acquire);
+        if (cur == id) return slot.name;
+        if (cur == 0) return nullptr;
+    }
+    return nullptr;
+}
+
+class QubitTrace {
+public:
+    static bool enabled() { return ringPtr().load(std::memory_order_relaxed) != nullptr; }
+
+    static void emit(uint8_t type, uint32_t qubit, uint32_t task, uint8_t arg = 0, uint32_t peer = 0) {
+        TraceRing* r = ringPtr().load(std::memory_order_relaxed);
+        if (!r) return;
+        uint64_t idx = r->head.fetch_add(1, std::memory_order_relaxed);
+        TraceRecord& e = r->records[idx & (r->capacity - 1)];
+        e.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        e.tsc = traceTsc();
+        e.qubit_id = qubit;
+        e.peer_id = peer;
+        e.task_id = task;
+        e.type = type;
+        e.arg = arg;
+        e.seq.store(idx + 1, std::memory_order_release);
+    }
+
+    // Record the name behind an id so the decoder can print it
+    static void registerName(uint32_t id, const std::string& name) {
+        TraceRing* r = ringPtr().load(std::memory_order_acquire);
+        if (!r) return;
+        for (uint32_t n = 0; n < TRACE_NAME_SLOTS; ++n) {
+            TraceName& slot = r->names[(id + n) % TRACE_NAME_SLOTS];
+            uint32_t cur = slot.id.load(std::memory_order_acquire);
+            if (cur == id) return;
+            if (cur != 0) continue;
+            // Claim the slot first so two writers never mix their names; a
+            // decoder racing with us may briefly see an empty name.
+            if (slot.id.compare_exchange_strong(cur, id, std::memory_order_acq_rel)) {
+                strncpy(slot.name, name.c_str(), TRACE_NAME_LEN - 1);
+                return;
+            }
+            if (cur == id) return;
+        }
+    }
+
+    // Turn tracing on, creating the ring if no other process has yet
+    static bool enable(uint64_t capacity = TRACE_DEFAULT_CAPACITY, const char* name = traceShmName()) {
+        std::lock_guard<std::mutex> lock(enableMutex());
+        if (ringPtr().load()) return true;
+        if (capacity < 2 || (capacity & (capacity - 1))) {
+            std::fprintf(stderr, "trace capacity must be a power of two\n");
+            return false;
+        }
+        int fd = shm_open(qubitShmName(name).c_str(), O_RDWR | O_CREAT, 0666);
+        if (fd < 0) { perror("shm_open trace"); return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0) { close(fd); return false; }
+        bool fresh = size_t(st.st_size) < sizeof(TraceRing);
+        size_t bytes = TraceRing::bytesFor(capacity);
+        if (fresh) ftruncate(fd, bytes);
+        else bytes = st.st_size;
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) { perror("mmap trace"); return false; }
+        TraceRing* r = reinterpret_cast<TraceRing*>(p);
+        if (fresh || r->magic.load() == 0) {
+            r->version = TRACE_VERSION;
+            r->capacity = capacity;
+            calibrate(r);
+            r->magic.store(TRACE_MAGIC, std::memory_order_release);
+        } else if (r->magic.load() != TRACE_MAGIC || r->version != TRACE_VERSION ||
+                   TraceRing::bytesFor(r->capacity) > bytes) {
+            std::fprintf(stderr, "trace ring '%s' has an incompatible layout\n", name);
+            munmap(p, bytes);
+            return false;
+        }
+        ringPtr().store(r, std::memory_order_release);
+        return true;
+    }
+
+    // Stop recording. The mapping is kept so in-flight writers stay valid.
+    static void disable() { ringPtr().store(nullptr, std::memory_order_release); }
+
+    // Enable once per process when QUBIT_TRACE is set
+    static void initFromEnv() {
+        static std::once_flag once;
+        std::call_once(once, [] {
+            const char* env = std::getenv("QUBIT_TRACE");
+            if (!env || !*env || std::strcmp(env, "0") == 0) return;
+            uint64_t cap = std::strtoull(env, nullptr, 10);
+            enable(cap > 1 ? cap : TRACE_DEFAULT_CAPACITY);
+        });
+    }
+
+    static TraceRing* ring() { return ringPtr().load(std::memory_order_acquire); }
+
+private:
+    static std::atomic<TraceRing*>& ringPtr() {
+        static std::atomic<TraceRing*> p{nullptr};
+        return p;
+    }
+
+    static std::mutex& enableMutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    static void calibrate(TraceRing* r) {
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = traceTsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto t1 = std::chrono::steady_clock::now();
+        uint64_t c1 = traceTsc();
+        double us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+        r->tsc_per_us = double(c1 - c0) / us;
+        r->tsc_origin = c1;
+        r->wall_origin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+};
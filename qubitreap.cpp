@@ -0,0 +1,68 @@
+// qubitreap: unlink qubit segments left behind by exited processes.
+//
+//   g++ -std=c++11 -O2 -pthread -o qubitreap qubitreap.cpp
+//   ./qubitreap [-p prefix] [-t task_id] [-a] [-m min_age_ms] [-n] [-i interval_s]
+//
+// By default every qubit and arena segment whose owner has exited and that
+// no process maps is unlinked. If some process's maps are unreadable, only
+// with -m. -a drops these checks and then needs -p or -t. -n only lists
+// matches. -i repeats the sweep every interval_s seconds, keeping tmpfs
+// bounded on long-lived hosts.
+
+#include "qubit_reaper.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static void usage() {
+    std::cerr << "usage: qubitreap [-p prefix] [-t task_id] [-a] [-m min_age_ms] [-n] [-i interval_s]\n"
+              << "  -a  any owner, live ones included (needs -p or -t)\n"
+              << "  -n  dry run: list what would be reaped\n"
+              << "  -i  sweep again every interval_s seconds (> 0)\n";
+}
+
+// A whole non-negative decimal number; false for anything else
+static bool parseCount(const char* s, uint64_t& out) {
+    if (!isdigit(static_cast<unsigned char>(*s))) return false;
+    char* end = nullptr;
+    errno = 0;
+    out = std::strtoull(s, &end, 10);
+    return *end == '\0' && errno == 0;
+}
+
+int main(int argc, char** argv) {
+    ReapOptions opts;
+    int interval_s = 0;  // 0 = one sweep
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        uint64_t n = 0;
+        if (arg == "-p" && i + 1 < argc) opts.prefix = argv[++i];
+        else if (arg == "-t" && i + 1 < argc && parseCount(argv[++i], n) && n <= UINT32_MAX) opts.task_id = int64_t(n);
+        else if (arg == "-a") opts.dead_owner = false;
+        else if (arg == "-m" && i + 1 < argc && parseCount(argv[++i], n)) opts.min_age_ms = n;
+        else if (arg == "-n") opts.dry_run = true;
+        else if (arg == "-i" && i + 1 < argc && parseCount(argv[++i], n) && n > 0 && n <= INT32_MAX) interval_s = int(n);
+        else { usage(); return 1; }
+    }
+    if (!opts.dead_owner && opts.prefix.empty() && opts.task_id == REAP_ANY_TASK) {
+        std::cerr << "qubitreap: -a needs -p or -t\n";
+        return 1;
+    }
+
+    for (;;) {
+        ReapReport r = reapSegments(opts);
+        for (const auto& name : r.names) std::cout << (opts.dry_run ? "would reap " : "reaped ") << name << "\n";
+        std::cout << r.reaped << " of " << r.scanned << " segments, " << r.bytes / 1024 << " KB"
+                  << (opts.dry_run ? " reclaimable" : " reclaimed") << std::endl;
+        if (r.unverified)
+            std::cout << "kept " << r.unverified << " with a dead owner: some processes' maps are unreadable"
+                      << " (run as their user, or pass -m)" << std::endl;
+        if (interval_s <= 0) return 0;
+        std::this_thread::sleep_for(std::chrono::seconds(interval_s));
+    }
+}
@@ -0,0 +1,89 @@
+// qubitstat: print live latency percentiles from the shared stats page.
+//
+//   g++ -std=c++11 -O2 -o qubitstat qubitstat.cpp
+//   ./qubitstat [-i interval_ms] [-c count]
+//   ./qubitstat -u
+//
+// The page is only read, so running this never pauses the workload. -u
+// removes the page; processes still recording keep their mapping.
+
+#include "qubit_stats.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+
+static std::string fmtNs(uint64_t ns) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1);
+    if (ns < 1000) os << ns << "ns";
+    else if (ns < 1000000) os << ns / 1e3 << "us";
+    else if (ns < 1000000000) os << ns / 1e6 << "ms";
+    else os << ns / 1e9 << "s";
+    return os.str();
+}
+
+static void usage() {
+    std::cerr << "usage: qubitstat [-i interval_ms] [-c count] | -u\n"
+              << "  reads the '" << statsShmName() << "' segment (override with QUBIT_STATS_SHM)\n"
+              << "  -u  unlink the segment\n";
+}
+
+int main(int argc, char** argv) {
+    int interval_ms = 1000;
+    int count = 0;  // 0 = run until interrupted
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-i" && i + 1 < argc) interval_ms = std::atoi(argv[++i]);
+        else if (arg == "-c" && i + 1 < argc) count = std::atoi(argv[++i]);
+        else if (arg == "-u" && argc == 2) {
+            std::string name = qubitShmName(statsShmName());
+            if (shm_unlink(name.c_str()) != 0) { perror(("shm_unlink " + name).c_str()); return 1; }
+            return 0;
+        }
+        else { usage(); return 1; }
+    }
+
+    std::string name = qubitShmName(statsShmName());
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) { perror(("shm_open " + name).c_str()); return 1; }
+    void* p = mmap(nullptr, sizeof(StatsPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) { perror("mmap"); return 1; }
+    const StatsPage* page = reinterpret_cast<const StatsPage*>(p);
+    if (page->magic.load() != STATS_MAGIC || page->version != STATS_VERSION) {
+        std::cerr << "stats page has an unknown layout\n";
+        return 1;
+    }
+
+    static OpSummary prev[OP_COUNT], cur[OP_COUNT];
+    aggregateStats(page, prev);
+    for (int n = 0; count == 0 || n < count; ++n) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        aggregateStats(page, cur);
+        std::cout << std::left << std::setw(10) << "op" << std::right
+                  << std::setw(12) << "count" << std::setw(12) << "ops/s"
+                  << std::setw(10) << "mean" << std::setw(10) << "p50"
+                  << std::setw(10) << "p90" << std::setw(10) << "p99"
+                  << std::setw(10) << "p99.9" << std::setw(10) << "max" << "\n";
+        for (uint32_t op = 0; op < OP_COUNT; ++op) {
+            const OpSummary& s = cur[op];
+            double rate = double(s.count - prev[op].count) * 1000.0 / interval_ms;
+            std::cout << std::left << std::setw(10) << opName(op) << std::right
+                      << std::setw(12) << s.count
+                      << std::setw(12) << std::fixed << std::setprecision(0) << rate
+                      << std::setw(10) << fmtNs(s.count ? s.sum_ns / s.count : 0)
+                      << std::setw(10) << fmtNs(s.percentile(0.50))
+                      << std::setw(10) << fmtNs(s.percentile(0.90))
+                      << std::setw(10) << fmtNs(s.percentile(0.99))
+                      << std::setw(10) << fmtNs(s.percentile(0.999))
+                      << std::setw(10) << fmtNs(s.max_ns) << "\n";
+            prev[op] = cur[op];
+        }
+        std::cout << std::endl;
+    }
+    munmap(p, sizeof(StatsPage));
+    return 0;
+}
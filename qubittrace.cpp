@@ -0,0 +1,100 @@
+// qubittrace: decode the shared-memory event trace ring.
+//
+//   g++ -std=c++11 -O2 -o qubittrace qubittrace.cpp
+//   ./qubittrace dump            # one line per event
+//   ./qubittrace chrome > t.json # load in chrome://tracing or Perfetto
+//
+// The ring is read in place; writers keep running while it is decoded.
+
+#include "qubit_trace.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+static std::string qubitLabel(const TraceRing* r, uint32_t id) {
+    const char* name = traceLookupName(r, id);
+    if (name && *name) return name;
+    std::ostringstream os;
+    os << "0x" << std::hex << std::setw(8) << std::setfill('0') << id;
+    return os.str();
+}
+
+static std::string argLabel(const TraceRecord& e) {
+    if (e.type == EV_GATE) return std::string(1, char(e.arg));
+    if (e.type == EV_MEASURE || e.type == EV_PROPAGATE || e.type == EV_DECOHERE)
+        return "|" + std::to_string(int(e.arg)) + ">";
+    return "";
+}
+
+static double tscToUs(const TraceRing* r, uint64_t tsc) {
+    return double(int64_t(tsc - r->tsc_origin)) / r->tsc_per_us;
+}
+
+static void dump(const TraceRing* r) {
+    uint64_t count = 0;
+    std::cout << std::fixed << std::setprecision(3);
+    readTrace(r, [&](const TraceRecord& e) {
+        std::cout << std::setw(10) << e.seq.load() - 1 << " "
+                  << std::setw(14) << tscToUs(r, e.tsc) << "us "
+                  << std::left << std::setw(10) << traceEventName(e.type) << std::right
+                  << " task " << e.task_id << " " << qubitLabel(r, e.qubit_id);
+        std::string arg = argLabel(e);
+        if (!arg.empty()) std::cout << " " << arg;
+        if (e.peer_id) std::cout << " -> " << qubitLabel(r, e.peer_id);
+        std::cout << "\n";
+        ++count;
+    });
+    std::cerr << count << " events (" << r->head.load() << " written, capacity "
+              << r->capacity << ")\n";
+}
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (uint8_t(c) >= 0x20) out += c;
+    }
+    return out;
+}
+
+// Instant events; pid = task_id and tid = qubit id so each qubit gets a lane
+static void chrome(const TraceRing* r) {
+    bool first = true;
+    std::cout << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+    readTrace(r, [&](const TraceRecord& e) {
+        if (!first) std::cout << ",\n";
+        first = false;
+        std::string name = traceEventName(e.type);
+        std::string arg = argLabel(e);
+        if (!arg.empty()) name += " " + arg;
+        std::cout << "{\"name\":\"" << jsonEscape(name) << "\",\"ph\":\"i\",\"s\":\"t\""
+                  << ",\"ts\":" << tscToUs(r, e.tsc)
+                  << ",\"pid\":" << e.task_id << ",\"tid\":" << e.qubit_id
+                  << ",\"args\":{\"qubit\":\"" << jsonEscape(qubitLabel(r, e.qubit_id)) << "\"";
+        if (e.peer_id) std::cout << ",\"peer\":\"" << jsonEscape(qubitLabel(r, e.peer_id)) << "\"";
+        std::cout << ",\"seq\":" << e.seq.load() - 1 << "}}";
+    });
+    std::cout << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"wall_origin_ns\":"
+              << r->wall_origin_ns << "}}\n";
+}
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "dump";
+    if (mode != "dump" && mode != "chrome") {
+        std::cerr << "usage: qubittrace [dump|chrome]\n"
+                  << "  reads the '" << traceShmName() << "' segment (override with QUBIT_TRACE_SHM)\n";
+        return 1;
+    }
+    size_t mapped = 0;
+    const TraceRing* r = openTraceRing(traceShmName(), &mapped);
+    if (!r) {
+        std::cerr << "no trace ring '" << traceShmName() << "' (run with QUBIT_TRACE=1)\n";
+        return 1;
+    }
+    if (mode == "dump") dump(r);
+    else chrome(r);
+    munmap(const_cast<TraceRing*>(r), mapped);
+    return 0;
+}
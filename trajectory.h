@@ -0,0 +1,313 @@
+#pragma once
+
+// Monte-Carlo quantum trajectories for noisy circuits.
+//
+// Each trajectory replays a Circuit on a private copy of its qubits' states,
+// using the same gate, collapse, propagation and T1/T2 kernels as Qubit but
+// without touching shared memory. Trajectory i draws from Philox stream i,
+// so results do not depend on the thread count or scheduling. Batches of
+// trajectories run on a work-stealing pool and are reduced per worker.
+
+#include "circuit.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+
+// Philox4x32-10 counter-based generator (Salmon et al., SC'11). Usable as a
+// UniformRandomBitGenerator; (seed, stream) selects an independent sequence.
+class Philox4x32 {
+public:
+    typedef uint32_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return 0xffffffffu; }
+
+    Philox4x32(uint64_t seed, uint64_t stream) {
+        key[0] = uint32_t(seed);
+        key[1] = uint32_t(seed >> 32);
+        ctr[0] = ctr[1] = 0;
+        ctr[2] = uint32_t(stream);
+        ctr[3] = uint32_t(stream >> 32);
+    }
+
+    result_type operator()() {
+        if (used == 4) refill();
+        return out[used++];
+    }
+
+private:
+    uint32_t key[2];
+    uint32_t ctr[4];
+    uint32_t out[4];
+    int      used = 4;
+
+    static uint32_t mulhilo(uint32_t a, uint32_t b, uint32_t& hi) {
+        uint64_t p = uint64_t(a) * b;
+        hi = uint32_t(p >> 32);
+        return uint32_t(p);
+    }
+
+    void refill() {
+        uint32_t x[4] = {ctr[0], ctr[1], ctr[2], ctr[3]};
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; ++round) {
+            uint32_t hi0, hi1;
+            uint32_t lo0 = mulhilo(0xD2511F53u, x[0], hi0);
+            uint32_t lo1 = mulhilo(0xCD9E8D57u, x[2], hi1);
+            uint32_t y0 = hi1 ^ x[1] ^ k0;
+            uint32_t y2 = hi0 ^ x[3] ^ k1;
+            x[0] = y0; x[1] = lo1; x[2] = y2; x[3] = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[0] = x[0]; out[1] = x[1]; out[2] = x[2]; out[3] = x[3];
+        used = 0;
+        if (++ctr[0] == 0) ++ctr[1];
+    }
+};
+
+// Fixed-size pool; each worker owns a deque, pops its own newest task and
+// steals the oldest task of another worker when it runs dry.
+class WorkStealingPool {
+public:
+    typedef std::function<void(unsigned worker)> Task;
+
+    explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency())
+        : queues(threads ? threads : 1) {
+        for (unsigned i = 0; i < queues.size(); ++i)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(idle_mtx);
+            stopping = true;
+        }
+        idle_cv.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    unsigned size() const { return unsigned(queues.size()); }
+
+    void submit(Task task) {
+        unsigned target = next_queue.fetch_add(1) % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(idle_mtx);
+            ++pending;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[target].mtx);
+            queues[target].tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(idle_mtx);
+            ++queued;
+        }
+        idle_cv.notify_one();
+    }
+
+    // Block until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(idle_mtx);
+        done_cv.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    struct Queue {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> next_queue{0};
+    std::mutex idle_mtx;
+    std::condition_variable idle_cv, done_cv;
+    size_t pending = 0;   // submitted and not yet finished
+    size_t queued = 0;    // sitting in some deque
+    bool stopping = false;
+
+    bool take(unsigned self, Task& task) {
+        {
+            Queue& own = queues[self];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (unsigned n = 1; n < queues.size(); ++n) {
+            Queue& victim = queues[(self + n) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned self) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(idle_mtx);
+                idle_cv.wait(lock, [this] { return stopping || queued > 0; });
+                if (queued == 0) return;
+            }
+            Task task;
+            if (!take(self, task)) continue;  // another worker got there first
+            {
+                std::lock_guard<std::mutex> lock(idle_mtx);
+                --queued;
+            }
+            task(self);
+            std::lock_guard<std::mutex> lock(idle_mtx);
+            if (--pending == 0) done_cv.notify_all();
+        }
+    }
+};
+
+struct NoiseModel {
+    Relaxation relaxation = {0.0, 0.0};  // applied to every qubit of the register
+    double gate_time_ms = 0.0;           // circuit time advanced by each op
+    double readout_error = 0.0;          // probability a measurement reads flipped
+};
+
+struct TrajectoryResult {
+    uint64_t trajectories = 0;
+    // Measurement outcomes packed as bits (bit k = k-th measure op) -> count
+    std::map<uint64_t, uint64_t> histogram;
+    // Per measure op: number of |1> outcomes, and <Z> = 1 - 2 P(|1>)
+    std::vector<uint64_t> ones;
+    std::vector<double> expectation_z;
+
+    void merge(const TrajectoryResult& other) {
+        trajectories += other.trajectories;
+        for (const auto& kv : other.histogram) histogram[kv.first] += kv.second;
+        if (ones.size() < other.ones.size()) ones.resize(other.ones.size());
+        for (size_t i = 0; i < other.ones.size(); ++i) ones[i] += other.ones[i];
+    }
+};
+
+class TrajectoryRunner {
+public:
+    explicit TrajectoryRunner(unsigned threads = std::thread::hardware_concurrency())
+        : pool(threads) {}
+
+    unsigned threads() const { return pool.size(); }
+
+    // Run `count` trajectories of `circuit` from its qubits' current states
+    TrajectoryResult run(const Circuit& circuit, const NoiseModel& noise,
+                         uint64_t count, uint64_t seed = 0x5eed) {
+        Program prog;
+        prog.circuit = &circuit;
+        prog.noise = noise;
+        for (Qubit* q : circuit.qubits()) {
+            QubitState s = q->readState();
+            s.t1_ms = noise.relaxation.t1_ms;
+            s.t2_ms = noise.relaxation.t2_ms;
+            prog.initial.push_back(s);
+            prog.names.push_back(q->name());
+        }
+        for (const Circuit::Op& op : circuit.ops()) prog.measures += op.kind == Circuit::MEASURE;
+
+        std::vector<TrajectoryResult> partial(pool.size());
+        const uint64_t batch = 256;
+        for (uint64_t begin = 0; begin < count; begin += batch) {
+            uint64_t end = std::min(count, begin + batch);
+            pool.submit([&prog, &partial, seed, begin, end](unsigned worker) {
+                TrajectoryResult& out = partial[worker];
+                if (out.ones.size() < prog.measures) out.ones.resize(prog.measures);
+                std::vector<QubitState> reg;
+                for (uint64_t t = begin; t < end; ++t) {
+                    Philox4x32 rng(seed, t);
+                    reg = prog.initial;
+                    uint64_t bits = runOne(prog, reg, rng);
+                    out.histogram[bits]++;
+                    for (size_t m = 0; m < prog.measures; ++m) out.ones[m] += (bits >> m) & 1;
+                    out.trajectories++;
+                }
+            });
+        }
+        pool.wait();
+
+        TrajectoryResult total;
+        total.ones.assign(prog.measures, 0);
+        for (const auto& p : partial) total.merge(p);
+        for (uint64_t n : total.ones)
+            total.expectation_z.push_back(total.trajectories ? 1.0 - 2.0 * double(n) / total.trajectories : 0.0);
+        return total;
+    }
+
+private:
+    struct Program {
+        const Circuit* circuit = nullptr;
+        NoiseModel noise;
+        std::vector<QubitState> initial;
+        std::vector<std::string> names;
+        size_t measures = 0;
+    };
+
+    WorkStealingPool pool;
+
+    static int indexOf(const Program& prog, const char* name) {
+        for (size_t i = 0; i < prog.names.size(); ++i)
+            if (prog.names[i] == name) return int(i);
+        return -1;
+    }
+
+    // One trajectory; returns the measurement bits in measure-op order.
+    // Peers outside the register are not touched.
+    template <class Rng>
+    static uint64_t runOne(const Program& prog, std::vector<QubitState>& reg, Rng& rng) {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<double> touched(reg.size(), 0.0);  // circuit time of last touch
+        double now = 0.0;
+        uint64_t bits = 0;
+        size_t m = 0;
+        for (const Circuit::Op& op : prog.circuit->ops()) {
+            now += prog.noise.gate_time_ms;
+            QubitState& s = reg[op.qubit];
+            relaxState(s, now - touched[op.qubit], rng);
+            touched[op.qubit] = now;
+            switch (op.kind) {
+                case Circuit::SET_STATE:
+                    s.alpha_real = op.amps[0]; s.alpha_imag = op.amps[1];
+                    s.beta_real  = op.amps[2]; s.beta_imag  = op.amps[3];
+                    s.measured = 2;
+                    break;
+                case Circuit::GATE:
+                    if (s.measured == 2) applyGateToState(s, op.gate);
+                    break;
+                case Circuit::ENTANGLE: {
+                    size_t n = std::min(op.peers.size(), size_t(4));
+                    for (size_t i = 0; i < n; ++i)
+                        strncpy(s.links[i], op.peers[i].c_str(), 63);
+                    s.link_count = uint32_t(n);
+                    break;
+                }
+                case Circuit::MEASURE: {
+                    uint8_t result = s.measured;
+                    if (result == 2) {
+                        double p1 = s.beta_real * s.beta_real + s.beta_imag * s.beta_imag;
+                        result = uniform(rng) < p1;
+                        collapseState(s, result);
+                        for (uint32_t l = 0; l < s.link_count; ++l) {
+                            int peer = indexOf(prog, s.links[l]);
+                            if (peer >= 0) reg[peer].measured = result;
+                        }
+                    }
+                    if (prog.noise.readout_error > 0 && uniform(rng) < prog.noise.readout_error)
+                        result ^= 1;
+                    if (m < 64) bits |= uint64_t(result) << m;
+                    ++m;
+                    break;
+                }
+            }
+        }
+        return bits;
+    }
+};